@@ -54,6 +54,28 @@ namespace binding_constant
     BINDING int hasBaseColorMap = 1; // bool
     BINDING int hasNormalMap = 2; // bool
     BINDING int hasMetallicRoughnessMap = 3; // bool
+
+    // vertex formats, see vertex_format
+    BINDING int positionFormat = 4; // int
+    BINDING int normalFormat = 5; // int
+    BINDING int tangentFormat = 6; // int
+    BINDING int uv0Format = 7; // int
+    BINDING int octahedralNormal = 8; // bool, normals are stored as 2 octahedral encoded components
+}
+
+// vertex component formats, for reading quantized vertex data (see VertexComponentType in mesh.h)
+// elements are aligned to 4 bytes
+namespace vertex_format
+{
+    BINDING int float32 = 0;
+    BINDING int int8 = 1;
+    BINDING int uint8 = 2;
+    BINDING int int16 = 3;
+    BINDING int uint16 = 4;
+    BINDING int int8Normalized = 5;
+    BINDING int uint8Normalized = 6;
+    BINDING int int16Normalized = 7;
+    BINDING int uint16Normalized = 8;
 }
 
 // common types
@@ -15,24 +15,99 @@ struct GltfPbrRasterizerData
     float3 worldSpaceNormal;
 };
 
+// size in bytes of a single component of the given vertex_format
+uint vertexComponentSize(int format)
+{
+    switch (format)
+    {
+        case vertex_format::int8:
+        case vertex_format::uint8:
+        case vertex_format::int8Normalized:
+        case vertex_format::uint8Normalized: return 1;
+        case vertex_format::int16:
+        case vertex_format::uint16:
+        case vertex_format::int16Normalized:
+        case vertex_format::uint16Normalized: return 2;
+        default: return 4;
+    }
+}
+
+// converts a single vertex component to float
+// normalized signed values are clamped to -1, as the minimum value can't be represented exactly (same as glTF and Metal vertex formats)
+float readVertexComponent(device uchar const* data, int format)
+{
+    switch (format)
+    {
+        case vertex_format::int8: return float(*(device char const*)data);
+        case vertex_format::uint8: return float(*data);
+        case vertex_format::int16: return float(*(device short const*)data);
+        case vertex_format::uint16: return float(*(device ushort const*)data);
+        case vertex_format::int8Normalized: return max(float(*(device char const*)data) / 127.0f, -1.0f);
+        case vertex_format::uint8Normalized: return float(*data) / 255.0f;
+        case vertex_format::int16Normalized: return max(float(*(device short const*)data) / 32767.0f, -1.0f);
+        case vertex_format::uint16Normalized: return float(*(device ushort const*)data) / 65535.0f;
+        default: return *(device float const*)data;
+    }
+}
+
+// reads a deinterleaved vertex attribute with the given format, missing components are set to (0, 0, 0, 1)
+// the format should be a function constant, so that the switch statements get optimized away
+float4 readVertexAttribute(device uchar const* data, uint vertexId, int format, uint componentCount)
+{
+    uint componentSize = vertexComponentSize(format);
+    uint stride = (componentSize * componentCount + 3) & ~3u;
+    device uchar const* element = data + vertexId * stride;
+
+    float4 out = float4(0, 0, 0, 1);
+    for (uint i = 0; i < componentCount; i++)
+    {
+        out[i] = readVertexComponent(element + i * componentSize, format);
+    }
+    return out;
+}
+
+// vertex formats of the primitive (shader variants), float32 if not set
+constant int positionFormatConstant [[function_constant(binding_constant::positionFormat)]];
+constant int normalFormatConstant [[function_constant(binding_constant::normalFormat)]];
+constant int tangentFormatConstant [[function_constant(binding_constant::tangentFormat)]];
+constant int uv0FormatConstant [[function_constant(binding_constant::uv0Format)]];
+constant int positionFormat = is_function_constant_defined(positionFormatConstant) ? positionFormatConstant : vertex_format::float32;
+constant int normalFormat = is_function_constant_defined(normalFormatConstant) ? normalFormatConstant : vertex_format::float32;
+constant int tangentFormat = is_function_constant_defined(tangentFormatConstant) ? tangentFormatConstant : vertex_format::float32;
+constant int uv0Format = is_function_constant_defined(uv0FormatConstant) ? uv0FormatConstant : vertex_format::float32;
+constant bool octahedralNormalConstant [[function_constant(binding_constant::octahedralNormal)]];
+constant bool octahedralNormal = is_function_constant_defined(octahedralNormalConstant) && octahedralNormalConstant;
+
+// inverse of encodeOctahedral in mesh.h, unfolds the lower hemisphere
+float3 decodeOctahedral(float2 encoded)
+{
+    float3 normal = float3(encoded.x, encoded.y, 1.0f - abs(encoded.x) - abs(encoded.y));
+    float t = max(-normal.z, 0.0f);
+    normal.x += normal.x >= 0.0f ? -t : t;
+    normal.y += normal.y >= 0.0f ? -t : t;
+    return normalize(normal);
+}
+
 vertex GltfPbrRasterizerData pbr_vertex(
     uint vertexId [[vertex_id]],
     uint instanceId [[instance_id]],
     device CameraData const& camera [[buffer(binding_vertex::cameraData)]],
     device PbrInstanceData const* instances [[buffer(binding_vertex::instanceData)]],
 
-    // vertex data
-    device packed_float3 const* positions [[buffer(binding_vertex::positions)]],
-    device packed_float3 const* normals [[buffer(binding_vertex::normals)]],
-    device packed_float2 const* uv0s [[buffer(binding_vertex::uv0s)]],
-    device packed_float3 const* tangents [[buffer(binding_vertex::tangents)]]
+    // vertex data (deinterleaved, format depends on the shader variant)
+    device uchar const* positions [[buffer(binding_vertex::positions)]],
+    device uchar const* normals [[buffer(binding_vertex::normals)]],
+    device uchar const* uv0s [[buffer(binding_vertex::uv0s)]],
+    device uchar const* tangents [[buffer(binding_vertex::tangents)]]
 )
 {
     // vertex data
-    device packed_float3 const& position = positions[vertexId];
-    device packed_float3 const& normal = normals[vertexId];
-    device packed_float3 const& tangent = tangents[vertexId];
-    device packed_float2 const& uv0 = uv0s[vertexId];
+    float3 position = readVertexAttribute(positions, vertexId, positionFormat, 3).xyz;
+    float3 normal = octahedralNormal
+        ? decodeOctahedral(readVertexAttribute(normals, vertexId, normalFormat, 2).xy)
+        : readVertexAttribute(normals, vertexId, normalFormat, 3).xyz;
+    float3 tangent = readVertexAttribute(tangents, vertexId, tangentFormat, 4).xyz; // w contains the handedness
+    float2 uv0 = readVertexAttribute(uv0s, vertexId, uv0Format, 2).xy;
 
     GltfPbrRasterizerData out;
     device PbrInstanceData const& instance = instances[instanceId];
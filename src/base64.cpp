@@ -0,0 +1,149 @@
+#include "base64.h"
+
+#include <array>
+#include <cassert>
+#include <cstdint>
+
+#if defined(__ARM_NEON) && defined(__aarch64__)
+#include <arm_neon.h>
+#endif
+
+constexpr uint8_t invalidSextet = 0xFF;
+
+// maps an ascii character to its 6-bit value, or invalidSextet
+constexpr std::array<uint8_t, 256> createDecodeTable()
+{
+    std::array<uint8_t, 256> table{};
+    for (uint8_t& value: table)
+    {
+        value = invalidSextet;
+    }
+    for (int i = 0; i < 26; i++)
+    {
+        table['A' + i] = (uint8_t)i;
+        table['a' + i] = (uint8_t)(26 + i);
+    }
+    for (int i = 0; i < 10; i++)
+    {
+        table['0' + i] = (uint8_t)(52 + i);
+    }
+    table['+'] = 62;
+    table['/'] = 63;
+    return table;
+}
+
+alignas(16) constexpr std::array<uint8_t, 256> decodeTable = createDecodeTable();
+
+size_t base64DecodedSizeUpperBound(size_t encodedSize)
+{
+    return (encodedSize + 3) / 4 * 3;
+}
+
+#if defined(__ARM_NEON) && defined(__aarch64__)
+// decodes blocks of 64 characters into 48 bytes
+// returns the amount of characters that were consumed, stops at the first block that contains an invalid character,
+// so that the scalar path can decode (and reject) the rest
+static size_t decodeBase64Neon(unsigned char const* data, size_t size, unsigned char* outData)
+{
+    // the table lookup instruction (tbl) supports 64 byte tables, so the lower half of the ascii range is looked up
+    // with one table, the upper half with another. out of range indices result in 0.
+    uint8x16x4_t lowTable = vld1q_u8_x4(&decodeTable[0]);
+    uint8x16x4_t highTable = vld1q_u8_x4(&decodeTable[64]);
+    uint8x16_t offset = vdupq_n_u8(64);
+
+    size_t consumed = 0;
+    while (size - consumed >= 64)
+    {
+        // deinterleave, so that each register contains one of the four characters of each group
+        uint8x16x4_t in = vld4q_u8(data + consumed);
+        uint8x16x4_t sextets;
+        uint8x16_t error = vdupq_n_u8(0);
+        for (int i = 0; i < 4; i++)
+        {
+            uint8x16_t low = vqtbl4q_u8(lowTable, in.val[i]);
+            uint8x16_t high = vqtbl4q_u8(highTable, vsubq_u8(in.val[i], offset));
+            sextets.val[i] = vorrq_u8(low, high);
+            // invalid table entries and non-ascii characters both have the high bit set
+            error = vorrq_u8(error, vorrq_u8(sextets.val[i], in.val[i]));
+        }
+        if (vmaxvq_u8(error) & 0x80)
+        {
+            break;
+        }
+
+        // pack 4 x 6 bits into 3 x 8 bits
+        uint8x16x3_t out;
+        out.val[0] = vorrq_u8(vshlq_n_u8(sextets.val[0], 2), vshrq_n_u8(sextets.val[1], 4));
+        out.val[1] = vorrq_u8(vshlq_n_u8(sextets.val[1], 4), vshrq_n_u8(sextets.val[2], 2));
+        out.val[2] = vorrq_u8(vshlq_n_u8(sextets.val[2], 6), sextets.val[3]);
+        vst3q_u8(outData + consumed / 4 * 3, out);
+
+        consumed += 64;
+    }
+    return consumed;
+}
+#endif
+
+bool decodeBase64(char const* data, size_t size, unsigned char* outData, size_t* outSize)
+{
+    assert(data != nullptr || size == 0);
+    assert(outData != nullptr || size == 0);
+
+    auto* in = reinterpret_cast<unsigned char const*>(data);
+
+    // padding is only allowed at the end
+    if (size % 4 == 0)
+    {
+        for (int i = 0; i < 2 && size > 0 && in[size - 1] == '='; i++)
+        {
+            size--;
+        }
+    }
+
+    size_t consumed = 0;
+#if defined(__ARM_NEON) && defined(__aarch64__)
+    consumed = decodeBase64Neon(in, size, outData);
+#endif
+    unsigned char* out = outData + consumed / 4 * 3;
+
+    // full groups of 4 characters
+    for (; size - consumed >= 4; consumed += 4)
+    {
+        uint8_t a = decodeTable[in[consumed]];
+        uint8_t b = decodeTable[in[consumed + 1]];
+        uint8_t c = decodeTable[in[consumed + 2]];
+        uint8_t d = decodeTable[in[consumed + 3]];
+        if ((a | b | c | d) & 0x80)
+        {
+            return false;
+        }
+        *out++ = (unsigned char)((a << 2) | (b >> 4));
+        *out++ = (unsigned char)((b << 4) | (c >> 2));
+        *out++ = (unsigned char)((c << 6) | d);
+    }
+
+    // remaining 2 or 3 characters (a single character can't encode a full byte)
+    size_t remaining = size - consumed;
+    if (remaining == 1)
+    {
+        return false;
+    }
+    if (remaining >= 2)
+    {
+        uint8_t a = decodeTable[in[consumed]];
+        uint8_t b = decodeTable[in[consumed + 1]];
+        uint8_t c = remaining == 3 ? decodeTable[in[consumed + 2]] : 0;
+        if ((a | b | c) & 0x80)
+        {
+            return false;
+        }
+        *out++ = (unsigned char)((a << 2) | (b >> 4));
+        if (remaining == 3)
+        {
+            *out++ = (unsigned char)((b << 4) | (c >> 2));
+        }
+    }
+
+    *outSize = out - outData;
+    return true;
+}
@@ -0,0 +1,15 @@
+#ifndef METAL_EXPERIMENT_BASE64_H
+#define METAL_EXPERIMENT_BASE64_H
+
+#include <cstddef>
+
+// returns the maximum amount of bytes decodeBase64 writes for the given amount of encoded characters
+[[nodiscard]] size_t base64DecodedSizeUpperBound(size_t encodedSize);
+
+// decodes standard base64 (RFC 4648, with or without '=' padding) into outData
+// outData should be at least base64DecodedSizeUpperBound(size) bytes
+// uses NEON when available, processing 64 characters per iteration
+// returns false when the input contains characters outside the base64 alphabet (including whitespace)
+[[nodiscard]] bool decodeBase64(char const* data, size_t size, unsigned char* outData, size_t* outSize);
+
+#endif //METAL_EXPERIMENT_BASE64_H
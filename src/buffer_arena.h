@@ -0,0 +1,49 @@
+#ifndef METAL_EXPERIMENT_BUFFER_ARENA_H
+#define METAL_EXPERIMENT_BUFFER_ARENA_H
+
+#import <Metal/Metal.h>
+
+#include <cstddef>
+#include <vector>
+
+// linear (bump) allocator that sub-allocates ranges from a few large shared storage MTLBuffers,
+// instead of creating one MTLBuffer per allocation.
+// blocks are never reallocated, so allocations stay valid until the arena is destroyed.
+// individual allocations can't be freed. not thread safe.
+struct BufferArena
+{
+    id <MTLDevice> device;
+    size_t blockSize = 0; // minimum size of a block, larger allocations get their own block
+    std::vector<id <MTLBuffer>> blocks;
+    size_t blockOffset = 0; // amount of bytes used in the last block
+    size_t allocatedSize = 0; // sum of all allocations, including alignment padding
+};
+
+struct BufferArenaAllocation
+{
+    id <MTLBuffer> buffer; // block that contains the allocation
+    size_t offset; // in bytes from the start of the buffer
+    unsigned char* data; // CPU pointer to the allocation
+};
+
+void createBufferArena(id <MTLDevice> device, size_t blockSize, BufferArena* outArena);
+
+// makes sure the next allocations of in total at most size bytes fit in the current block
+// e.g. when the total size is known upfront, all allocations end up in a single buffer
+void reserveBufferArena(BufferArena* arena, size_t size);
+
+// offset is a multiple of alignment (should be a power of two)
+[[nodiscard]] BufferArenaAllocation allocateFromBufferArena(BufferArena* arena, size_t size, size_t alignment);
+
+// moves the blocks of source to the end of arena, so that the allocations of both stay valid until arena is destroyed
+// e.g. when a model is extended with data that was imported separately. source is empty afterwards
+void appendBufferArena(BufferArena* arena, BufferArena* source);
+
+// frees all allocations, after which the blocks are reused (e.g. for per-frame data, once the GPU is done with the frame)
+// when the allocations didn't fit in a single block, the blocks are replaced by one block that is large enough
+void resetBufferArena(BufferArena* arena);
+
+// releases all blocks, invalidating all allocations
+void destroyBufferArena(BufferArena* arena);
+
+#endif //METAL_EXPERIMENT_BUFFER_ARENA_H
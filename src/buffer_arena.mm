@@ -0,0 +1,101 @@
+#include "buffer_arena.h"
+
+#include <algorithm>
+#include <cassert>
+
+void createBufferArena(id <MTLDevice> device, size_t blockSize, BufferArena* outArena)
+{
+    assert(outArena->blocks.empty());
+    outArena->device = device;
+    outArena->blockSize = blockSize;
+    outArena->blockOffset = 0;
+    outArena->allocatedSize = 0;
+}
+
+[[nodiscard]] static size_t alignUp(size_t value, size_t alignment)
+{
+    assert((alignment & (alignment - 1)) == 0 && "alignment should be a power of two");
+    return (value + alignment - 1) & ~(alignment - 1);
+}
+
+static void addBlock(BufferArena* arena, size_t size)
+{
+    MTLResourceOptions options = MTLResourceCPUCacheModeDefaultCache | MTLResourceStorageModeShared;
+    id <MTLBuffer> block = [arena->device newBufferWithLength:std::max(size, arena->blockSize) options:options];
+    assert(block != nil);
+    arena->blocks.emplace_back(block);
+    arena->blockOffset = 0;
+}
+
+void reserveBufferArena(BufferArena* arena, size_t size)
+{
+    if (arena->blocks.empty() || [arena->blocks.back() length] - arena->blockOffset < size)
+    {
+        addBlock(arena, size);
+    }
+}
+
+BufferArenaAllocation allocateFromBufferArena(BufferArena* arena, size_t size, size_t alignment)
+{
+    assert(arena->device != nil && "arena not created");
+    size_t offset = arena->blocks.empty() ? 0 : alignUp(arena->blockOffset, alignment);
+    if (arena->blocks.empty() || offset + size > [arena->blocks.back() length])
+    {
+        addBlock(arena, size);
+        offset = 0;
+    }
+
+    id <MTLBuffer> block = arena->blocks.back();
+    arena->allocatedSize += offset - arena->blockOffset + size;
+    arena->blockOffset = offset + size;
+    return BufferArenaAllocation{
+        .buffer = block,
+        .offset = offset,
+        .data = static_cast<unsigned char*>([block contents]) + offset
+    };
+}
+
+void appendBufferArena(BufferArena* arena, BufferArena* source)
+{
+    if (arena->device == nil)
+    {
+        arena->device = source->device;
+        arena->blockSize = source->blockSize;
+    }
+    if (source->blocks.empty())
+    {
+        return;
+    }
+
+    // the blocks are owned by arena now, so they are not released here
+    // next allocations continue after the allocations of source, in its last block
+    arena->blocks.insert(arena->blocks.end(), source->blocks.begin(), source->blocks.end());
+    arena->blockOffset = source->blockOffset;
+    arena->allocatedSize += source->allocatedSize;
+    source->blocks.clear();
+    source->blockOffset = 0;
+    source->allocatedSize = 0;
+}
+
+void destroyBufferArena(BufferArena* arena)
+{
+    for (id <MTLBuffer> block: arena->blocks)
+    {
+        [block release];
+    }
+    arena->blocks.clear();
+    arena->blockOffset = 0;
+    arena->allocatedSize = 0;
+}
+
+void resetBufferArena(BufferArena* arena)
+{
+    if (arena->blocks.size() > 1)
+    {
+        size_t size = arena->allocatedSize;
+        destroyBufferArena(arena);
+        addBlock(arena, size);
+    }
+    arena->blockOffset = 0;
+    arena->allocatedSize = 0;
+}
@@ -0,0 +1,41 @@
+#include "hash.h"
+
+#include <cstring>
+
+uint64_t hashBytes(void const* data, size_t size, uint64_t seed)
+{
+    constexpr uint64_t m = 0xc6a4a7935bd1e995ull;
+    constexpr int r = 47;
+
+    auto const* bytes = static_cast<unsigned char const*>(data);
+    uint64_t h = seed ^ (size * m);
+
+    size_t wordCount = size / 8;
+    for (size_t i = 0; i < wordCount; i++)
+    {
+        uint64_t k;
+        memcpy(&k, bytes + i * 8, sizeof(uint64_t)); // unaligned read
+        k *= m;
+        k ^= k >> r;
+        k *= m;
+        h ^= k;
+        h *= m;
+    }
+
+    // remaining 0 to 7 bytes
+    unsigned char const* tail = bytes + wordCount * 8;
+    size_t remaining = size & 7;
+    if (remaining > 0)
+    {
+        for (size_t i = remaining; i > 0; i--)
+        {
+            h ^= uint64_t(tail[i - 1]) << (8 * (i - 1));
+        }
+        h *= m;
+    }
+
+    h ^= h >> r;
+    h *= m;
+    h ^= h >> r;
+    return h;
+}
@@ -0,0 +1,17 @@
+#ifndef METAL_EXPERIMENT_HASH_H
+#define METAL_EXPERIMENT_HASH_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string_view>
+
+// 64-bit non-cryptographic hash (MurmurHash64A), processes 8 bytes at a time
+// the result is the same on all (little endian) platforms, so it can be stored on disk
+[[nodiscard]] uint64_t hashBytes(void const* data, size_t size, uint64_t seed = 0);
+
+[[nodiscard]] inline uint64_t hashString(std::string_view string, uint64_t seed = 0)
+{
+    return hashBytes(string.data(), string.size(), seed);
+}
+
+#endif //METAL_EXPERIMENT_HASH_H
@@ -1,7 +1,12 @@
 #ifndef METAL_EXPERIMENT_GLTF_H
 #define METAL_EXPERIMENT_GLTF_H
 
+#include <atomic>
 #include <filesystem>
+#include <mutex>
+#include <thread>
+#include <utility>
+#include <vector>
 
 #import <Metal/MTLDevice.h>
 #import <Metal/MTLTexture.h>
@@ -9,8 +14,90 @@
 #include "mesh.h"
 #include "constants.h"
 #include "model.h"
+#include "import_statistics.h"
+
+struct GltfImportSettings
+{
+    // amount of worker threads used for decoding images, 0 = one per hardware thread
+    // images are decoded while the meshes are being imported on the calling thread
+    size_t imageDecodeThreadCount = 0;
+
+    // memory map the gltf / glb file and its buffers instead of reading them into heap memory
+    // accessors that are tightly packed are then copied straight from the mapped file into the GPU buffers
+    bool memoryMapFiles = true;
+
+    // texture budget, 0 = no limit
+    // images are scaled down until their width and height are at most maxTextureDimension. jpeg images are decoded
+    // directly at the reduced scale, png images are downsampled after decoding, ktx2 images skip their larger mip levels
+    int maxTextureDimension = 0;
+
+    // when all textures together would take more than maxTextureBytes, all images are halved uniformly until they fit
+    // requires reading the image headers before decoding
+    size_t maxTextureBytes = 0;
+
+    // 32-bit indices are always narrowed to 16 bits when the primitive has few enough vertices
+    // when enabled, triangle lists with too many vertices for 16-bit indices are split into multiple primitives that do fit
+    bool splitLargePrimitives = false;
+
+    // reorder indices and vertices for vertex cache, overdraw and vertex fetch efficiency (see optimizePrimitive)
+    // ACMR / ATVR before and after are logged per file
+    bool optimizeMeshes = true;
+
+    // log each mesh, attribute and image
+    bool verbose = false;
+};
 
 // returns true when successful
-[[nodiscard]] bool importGltf(id <MTLDevice> device, std::filesystem::path const& path, model::Model* outModel);
+// outStatistics is optional, see ImportStatistics
+[[nodiscard]] bool importGltf(
+    id <MTLDevice> device, std::filesystem::path const& path, model::Model* outModel,
+    GltfImportSettings settings = {}, ImportStatistics* outStatistics = nullptr);
+
+// handle to a gltf import running on a background thread
+// results are applied to the model incrementally by updateGltfImport, so that a partially loaded model can be rendered
+struct GltfImport
+{
+    std::thread thread;
+    std::filesystem::path path;
+    std::atomic<bool> cancelled = false;
+    std::atomic<bool> finished = false;
+    std::atomic<bool> succeeded = false;
+    bool reportedFailure = false; // only accessed by the thread that calls updateGltfImport
+
+    // progress (meshes + images)
+    std::atomic<size_t> completedSteps = 0;
+    std::atomic<size_t> totalSteps = 0; // known after the file has been parsed
+
+    // results that have not been applied to the model yet, guarded by mutex
+    std::mutex mutex;
+    bool hasStructure = false;
+    model::Model structure; // materials, nodes and scenes, with empty meshes and textures
+    std::vector<std::pair<size_t, model::Mesh>> completedMeshes;
+    std::vector<std::pair<size_t, id <MTLTexture>>> completedTextures;
+    bool hasBuffers = false; // the vertex and index arenas are handed over after all meshes have been imported
+    BufferArena vertexArena;
+    BufferArena indexArena;
+
+    // valid after finishGltfImport
+    ImportStatistics statistics;
+};
+
+// starts importing the gltf file on a background thread
+void startGltfImport(id <MTLDevice> device, std::filesystem::path const& path, GltfImportSettings settings, GltfImport* outImport);
+
+// applies the meshes, materials and textures that have completed since the last update to the model
+// should be called from the thread that renders the model (e.g. once per frame)
+// the model is empty until the file has been parsed, meshes and textures are filled in as they complete
+// returns true when the import has finished and all results have been applied
+bool updateGltfImport(GltfImport* import, model::Model* model);
+
+// returns progress between 0 and 1
+[[nodiscard]] float getGltfImportProgress(GltfImport const* import);
+
+// requests the import to stop, does not block
+void cancelGltfImport(GltfImport* import);
+
+// blocks until the background thread has stopped, returns true when the import was successful
+bool finishGltfImport(GltfImport* import);
 
 #endif //METAL_EXPERIMENT_GLTF_H
@@ -7,11 +7,23 @@
 #define CGLTF_IMPLEMENTATION
 
 #include "cgltf.h"
-#include "turbojpeg.h"
-#include "lodepng.h"
+#include "image.h"
+#include "ktx2.h"
+#include "thread_pool.h"
+#include "mapped_file.h"
+#include "base64.h"
+#include "mesh_optimization.h"
+#include "import_statistics.h"
+#include "scratch_arena.h"
+#include "meshoptimizer.h"
 
+#include <atomic>
+#include <functional>
 #include <cassert>
+#include <fstream>
 #include <iostream>
+#include <string>
+#include <string_view>
 
 #include "glm/gtc/type_ptr.hpp"
 
@@ -34,321 +46,968 @@
     return VertexAttributeType::Position;
 }
 
-bool importGltf(id <MTLDevice> device, std::filesystem::path const& path, model::Model* outModel)
+// size of additional vertex / index buffers, when the buffers that were reserved for the file are full
+constexpr size_t arenaBlockSize = 16 * 1024 * 1024;
+
+// initial size of the scratch memory for the temporaries of a single primitive, grows to fit the largest primitive
+constexpr size_t scratchBlockSize = 1024 * 1024;
+
+// amount of encoded bytes that is read of each image to determine its size for the texture budget, enough for the png
+// IHDR chunk, the ktx2 header and the jpeg frame header (unless it is preceded by large metadata, e.g. an exif thumbnail)
+constexpr size_t imageHeaderSize = 64 * 1024;
+
+// cgltf file callbacks that memory map files instead of reading them into heap memory
+// used for both the gltf / glb file itself and external .bin buffers
+static cgltf_result mapGltfFile(
+    cgltf_memory_options const* memoryOptions, cgltf_file_options const* fileOptions,
+    char const* path, cgltf_size* size, void** data)
 {
-    assert(exists(path));
-    assert(outModel != nullptr);
+    MappedFile file{};
+    if (!mapFile(path, &file))
+    {
+        return cgltf_result_file_not_found;
+    }
+    *size = file.size;
+    *data = file.data;
+    return cgltf_result_success;
+}
 
-    // parse file
-    cgltf_options cgltfOptions = {
-        .type = cgltf_file_type_invalid, // = auto detect
-        .file = cgltf_file_options{}
+static void unmapGltfFile(
+    cgltf_memory_options const* memoryOptions, cgltf_file_options const* fileOptions,
+    void* data, cgltf_size size)
+{
+    MappedFile file{
+        .data = data,
+        .size = size
     };
-    cgltf_data* cgltfData = nullptr;
-    cgltf_result parseFileResult = cgltf_parse_file(&cgltfOptions, path.c_str(), &cgltfData);
-    if (parseFileResult != cgltf_result_success)
+    unmapFile(&file);
+}
+
+// copies the accessor elements as-is into the destination, without converting the component type
+// if the stride is equal, this is a single memcpy from the (memory mapped) buffer
+// returns false if the accessor can't be copied directly (sparse or no buffer data), it should then be unpacked
+[[nodiscard]] static bool copyAccessor(cgltf_accessor const* accessor, unsigned char* destination, size_t destinationStride)
+{
+    if (accessor->is_sparse || accessor->buffer_view == nullptr || accessor->count == 0)
     {
-        cgltf_free(cgltfData);
-        std::cout << "Failed to parse gltf file" << std::endl;
-        exit(1);
+        return false;
     }
 
-    // load buffers
-    cgltf_result loadBuffersResult = cgltf_load_buffers(&cgltfOptions, cgltfData, path.c_str());
-    if (loadBuffersResult != cgltf_result_success)
+    unsigned char const* source = cgltf_buffer_view_data(accessor->buffer_view);
+    if (source == nullptr)
     {
-        cgltf_free(cgltfData);
-        std::cout << "Failed to load buffers, this can be due to .bin files not being located next to the file" << std::endl;
-        exit(1);
+        return false;
     }
+    source += accessor->offset;
 
-    // images
-    if (1)
+    size_t elementSize = cgltf_calc_size(accessor->type, accessor->component_type);
+    assert(elementSize <= destinationStride);
+    if (accessor->stride == destinationStride)
+    {
+        // the padding of the last element is not guaranteed to be inside the buffer view
+        memcpy(destination, source, (accessor->count - 1) * accessor->stride + elementSize);
+    }
+    else
+    {
+        for (size_t i = 0; i < accessor->count; i++)
+        {
+            memcpy(destination + i * destinationStride, source + i * accessor->stride, elementSize);
+        }
+    }
+    return true;
+}
+
+// keeps the 8 and 16 bit component types (KHR_mesh_quantization) as-is, so that they don't have to be expanded to floats
+// falls back to float if the data can't be copied directly
+static void setVertexAttributeFormat(cgltf_accessor const* accessor, VertexAttribute* outAttribute)
+{
+    outAttribute->componentCount = cgltf_num_components(accessor->type);
+    outAttribute->componentType = VertexComponentType::Float32;
+    outAttribute->normalized = false;
+
+    if (!accessor->is_sparse && accessor->buffer_view != nullptr)
     {
-        for (int i = 0; i < cgltfData->images_count; i++)
+        //@formatter:off
+        switch (accessor->component_type)
         {
-            cgltf_image* image = &cgltfData->images[i];
+            case cgltf_component_type_r_8: outAttribute->componentType = VertexComponentType::Int8; break;
+            case cgltf_component_type_r_8u: outAttribute->componentType = VertexComponentType::UInt8; break;
+            case cgltf_component_type_r_16: outAttribute->componentType = VertexComponentType::Int16; break;
+            case cgltf_component_type_r_16u: outAttribute->componentType = VertexComponentType::UInt16; break;
+            default: break; // 32 bit integers are not valid for vertex attributes, and are converted to float
+        }
+        //@formatter:on
+        outAttribute->normalized = outAttribute->componentType != VertexComponentType::Float32 && accessor->normalized;
+    }
+
+    outAttribute->stride = vertexAttributeStride(outAttribute->componentType, outAttribute->componentCount);
+}
+
+// decodes an EXT_meshopt_compression buffer view into the destination, which should be count * stride bytes
+// meshoptimizer uses SIMD (SSE / NEON) for decoding when available
+[[nodiscard]] static bool decodeMeshoptCompression(cgltf_meshopt_compression const* compression, void* destination)
+{
+    if (compression->buffer == nullptr || compression->buffer->data == nullptr)
+    {
+        return false;
+    }
+    auto const* source = (unsigned char const*)compression->buffer->data + compression->offset;
+
+    int result = -1;
+    //@formatter:off
+    switch (compression->mode)
+    {
+        case cgltf_meshopt_compression_mode_attributes: result = meshopt_decodeVertexBuffer(destination, compression->count, compression->stride, source, compression->size); break;
+        case cgltf_meshopt_compression_mode_triangles: result = meshopt_decodeIndexBuffer(destination, compression->count, compression->stride, source, compression->size); break;
+        case cgltf_meshopt_compression_mode_indices: result = meshopt_decodeIndexSequence(destination, compression->count, compression->stride, source, compression->size); break;
+        default: break;
+    }
+    //@formatter:on
+    if (result != 0)
+    {
+        return false;
+    }
+
+    // filters are applied in place on the decoded data
+    //@formatter:off
+    switch (compression->filter)
+    {
+        case cgltf_meshopt_compression_filter_none: break;
+        case cgltf_meshopt_compression_filter_octahedral: meshopt_decodeFilterOct(destination, compression->count, compression->stride); break;
+        case cgltf_meshopt_compression_filter_quaternion: meshopt_decodeFilterQuat(destination, compression->count, compression->stride); break;
+        case cgltf_meshopt_compression_filter_exponential: meshopt_decodeFilterExp(destination, compression->count, compression->stride); break;
+        default: return false;
+    }
+    //@formatter:on
+    return true;
+}
 
-            if (image->uri != nullptr)
+// 32-bit indices are narrowed to 16 bits when the vertex count allows it
+// 8-bit indices are not supported by Metal, so are widened to 16 bits
+[[nodiscard]] static size_t getIndexComponentSize(cgltf_accessor const* indices, size_t vertexCount)
+{
+    size_t componentSize = cgltf_component_size(indices->component_type);
+    assert((componentSize == 1 || componentSize == 2 || componentSize == 4) && "invalid index component type");
+    if (componentSize == 1 || (componentSize == 4 && vertexCount <= maxUInt16IndexedVertexCount))
+    {
+        return 2;
+    }
+    return componentSize;
+}
+
+// returns whether the accessor covers the entire compressed buffer view with the same layout as the destination,
+// in which case the buffer view can be decoded straight into the vertex or index buffer
+[[nodiscard]] static bool canDecodeMeshoptDirectly(cgltf_accessor const* accessor, size_t destinationStride)
+{
+    cgltf_buffer_view const* view = accessor->buffer_view;
+    if (accessor->is_sparse || view == nullptr || !view->has_meshopt_compression)
+    {
+        return false;
+    }
+    cgltf_meshopt_compression const* compression = &view->meshopt_compression;
+    return accessor->offset == 0 &&
+           accessor->count == compression->count &&
+           accessor->stride == compression->stride &&
+           compression->stride == destinationStride;
+}
+
+// determines for each EXT_meshopt_compression buffer view whether it can be decoded straight into the vertex and index
+// buffers of the primitives that use it. all other compressed buffer views (e.g. used by animations, or with a different
+// layout) are decoded into buffer_view->data, which cgltf_buffer_view_data returns and cgltf_free frees.
+[[nodiscard]] static bool decodeMeshoptBufferViews(cgltf_data* data, std::vector<bool>* outDecodeDirectly)
+{
+    outDecodeDirectly->assign(data->buffer_views_count, false);
+
+    bool anyCompressed = false;
+    for (size_t i = 0; i < data->buffer_views_count; i++)
+    {
+        (*outDecodeDirectly)[i] = data->buffer_views[i].has_meshopt_compression;
+        anyCompressed |= data->buffer_views[i].has_meshopt_compression;
+    }
+    if (!anyCompressed)
+    {
+        return true;
+    }
+
+    // only buffer views that are exclusively used as vertex attributes or indices with a matching layout
+    std::vector<bool> usedByMesh(data->accessors_count, false);
+    for (size_t i = 0; i < data->meshes_count; i++)
+    {
+        cgltf_mesh* mesh = &data->meshes[i];
+        for (size_t j = 0; j < mesh->primitives_count; j++)
+        {
+            cgltf_primitive* primitive = &mesh->primitives[j];
+            for (size_t k = 0; k < primitive->attributes_count; k++)
+            {
+                cgltf_accessor* accessor = primitive->attributes[k].data;
+                VertexAttribute attribute{};
+                setVertexAttributeFormat(accessor, &attribute);
+                usedByMesh[cgltf_accessor_index(data, accessor)] = true;
+                if (accessor->buffer_view && !canDecodeMeshoptDirectly(accessor, attribute.stride))
+                {
+                    (*outDecodeDirectly)[cgltf_buffer_view_index(data, accessor->buffer_view)] = false;
+                }
+            }
+
+            if (primitive->indices != nullptr)
             {
-                if (strlen(image->uri) >= 5 && strncmp(image->uri, "data:", 5) == 0)
+                cgltf_accessor* accessor = primitive->indices;
+                usedByMesh[cgltf_accessor_index(data, accessor)] = true;
+                if (accessor->buffer_view && !canDecodeMeshoptDirectly(accessor, cgltf_component_size(accessor->component_type)))
                 {
-                    // data URI (string starts with data:content/type;base64,)
-                    // todo
-                    assert(false && "unimplemented");
+                    (*outDecodeDirectly)[cgltf_buffer_view_index(data, accessor->buffer_view)] = false;
                 }
-                else
+
+                // only the index codecs can decode to a different index size, indices that are compressed as attributes
+                // are decoded to their original size and then narrowed or widened while copying
+                size_t vertexCount = primitive->attributes_count > 0 ? primitive->attributes[0].data->count : 0;
+                if (accessor->buffer_view && accessor->buffer_view->has_meshopt_compression &&
+                    getIndexComponentSize(accessor, vertexCount) != cgltf_component_size(accessor->component_type) &&
+                    accessor->buffer_view->meshopt_compression.mode != cgltf_meshopt_compression_mode_triangles &&
+                    accessor->buffer_view->meshopt_compression.mode != cgltf_meshopt_compression_mode_indices)
                 {
-                    // load from disk
-                    std::filesystem::path imagePath = image->uri;
-                    // todo
-                    assert(false && "unimplemented");
+                    (*outDecodeDirectly)[cgltf_buffer_view_index(data, accessor->buffer_view)] = false;
                 }
             }
-            else
+        }
+    }
+
+    for (size_t i = 0; i < data->accessors_count; i++)
+    {
+        cgltf_accessor* accessor = &data->accessors[i];
+        if (!usedByMesh[i] && accessor->buffer_view != nullptr)
+        {
+            (*outDecodeDirectly)[cgltf_buffer_view_index(data, accessor->buffer_view)] = false;
+        }
+    }
+
+    for (size_t i = 0; i < data->images_count; i++)
+    {
+        if (data->images[i].buffer_view != nullptr)
+        {
+            (*outDecodeDirectly)[cgltf_buffer_view_index(data, data->images[i].buffer_view)] = false;
+        }
+    }
+
+    // decode the remaining compressed buffer views
+    for (size_t i = 0; i < data->buffer_views_count; i++)
+    {
+        cgltf_buffer_view* view = &data->buffer_views[i];
+        if (!view->has_meshopt_compression || (*outDecodeDirectly)[i] || view->data != nullptr)
+        {
+            continue;
+        }
+
+        cgltf_meshopt_compression* compression = &view->meshopt_compression;
+        view->data = malloc(compression->count * compression->stride);
+        if (!decodeMeshoptCompression(compression, view->data))
+        {
+            std::cout << "Failed to decode EXT_meshopt_compression buffer view " << i << std::endl;
+            return false;
+        }
+    }
+    return true;
+}
+
+// decodes the base64 payload of a data uri (data:[<mime type>][;base64],<data>)
+// the payload is decoded directly into outData, which is the input of the image decoder
+// only the start of the payload is decoded when it would decode to more than maxDecodedSize bytes, outComplete is optional
+[[nodiscard]] static bool decodeDataUri(
+    char const* uri, size_t maxDecodedSize, ImageFormat* outFormat, std::vector<unsigned char>* outData, bool* outComplete = nullptr)
+{
+    char const* comma = strchr(uri, ',');
+    if (comma == nullptr)
+    {
+        std::cerr << "invalid data uri" << std::endl;
+        return false;
+    }
+
+    // header (between "data:" and ",")
+    std::string_view header(uri + 5, comma - (uri + 5));
+    if (!header.ends_with(";base64"))
+    {
+        std::cerr << "only base64 encoded data uris are supported" << std::endl;
+        return false;
+    }
+    if (*outFormat == ImageFormat::Unknown)
+    {
+        std::string mimeType(header.substr(0, header.find(';')));
+        *outFormat = imageFormatFromMimeType(mimeType.c_str());
+    }
+
+    // 4 characters decode to 3 bytes, the payload is not scanned beyond the characters that are decoded
+    char const* payload = comma + 1;
+    size_t payloadSize;
+    bool complete = true;
+    if (maxDecodedSize == std::numeric_limits<size_t>::max())
+    {
+        payloadSize = strlen(payload);
+    }
+    else
+    {
+        size_t maxPayloadSize = maxDecodedSize / 3 * 4;
+        payloadSize = strnlen(payload, maxPayloadSize + 1);
+        complete = payloadSize <= maxPayloadSize;
+        payloadSize = std::min(payloadSize, maxPayloadSize);
+    }
+    if (outComplete)
+    {
+        *outComplete = complete;
+    }
+    outData->resize(base64DecodedSizeUpperBound(payloadSize));
+    size_t decodedSize = 0;
+    if (!decodeBase64(payload, payloadSize, outData->data(), &decodedSize))
+    {
+        std::cerr << "invalid base64 data in data uri" << std::endl;
+        return false;
+    }
+    outData->resize(decodedSize);
+    return true;
+}
+
+// reads an image file that is referenced by a relative uri
+[[nodiscard]] static bool readImageFile(std::filesystem::path const& path, bool memoryMapFiles, MappedFile* outMappedFile, std::vector<unsigned char>* outData)
+{
+    if (memoryMapFiles)
+    {
+        return mapFile(path, outMappedFile);
+    }
+
+    std::ifstream file(path, std::ios::binary | std::ios::ate);
+    if (!file)
+    {
+        return false;
+    }
+    outData->resize((size_t)file.tellg());
+    file.seekg(0);
+    return (bool)file.read(reinterpret_cast<char*>(outData->data()), (std::streamsize)outData->size());
+}
+
+// reads at most maxSize bytes from the start of an image file, outComplete is set to whether that is the entire file
+[[nodiscard]] static bool readImageFileHeader(std::filesystem::path const& path, size_t maxSize, std::vector<unsigned char>* outData, bool* outComplete)
+{
+    std::ifstream file(path, std::ios::binary | std::ios::ate);
+    if (!file)
+    {
+        return false;
+    }
+    auto fileSize = (size_t)file.tellg();
+    *outComplete = fileSize <= maxSize;
+    outData->resize(std::min(fileSize, maxSize));
+    file.seekg(0);
+    return (bool)file.read(reinterpret_cast<char*>(outData->data()), (std::streamsize)outData->size());
+}
+
+// statistics of the image decode jobs, shared between the worker threads
+struct GltfImageStatistics
+{
+    std::atomic<size_t> bytesRead = 0;
+    std::atomic<size_t> bytesDecoded = 0;
+    std::atomic<size_t> textureBytes = 0;
+    std::atomic<size_t> textureCount = 0;
+    std::atomic<int64_t> decodeNanoseconds = 0;
+    std::atomic<int64_t> uploadNanoseconds = 0;
+    ScratchMemoryTracker* scratch = nullptr;
+};
+
+[[nodiscard]] static int64_t nanosecondsSince(ImportClock::time_point start)
+{
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(ImportClock::now() - start).count();
+}
+
+// encoded image data, points into a buffer view, a memory mapped file or storage
+struct GltfImageData
+{
+    ImageFormat format = ImageFormat::Unknown;
+    unsigned char const* data = nullptr;
+    size_t size = 0;
+    std::vector<unsigned char> storage; // decoded data uri, or file that was read into memory
+    MappedFile mappedFile{};
+};
+
+// loads the encoded data of the image from a data uri, an external file or a buffer view
+// directory is the directory of the gltf file, used to resolve relative uris
+// statistics is optional
+[[nodiscard]] static bool loadGltfImageData(
+    cgltf_image* image, std::filesystem::path const& directory, GltfImportSettings const& settings,
+    GltfImageStatistics* statistics, GltfImageData* outData)
+{
+    // mime_type is guaranteed to be set for buffer views, but optional for uris
+    outData->format = imageFormatFromMimeType(image->mime_type);
+
+    if (image->uri != nullptr)
+    {
+        if (strncmp(image->uri, "data:", 5) == 0)
+        {
+            // data URI (string starts with data:content/type;base64,)
+            if (!decodeDataUri(image->uri, std::numeric_limits<size_t>::max(), &outData->format, &outData->storage))
+            {
+                return false;
+            }
+            outData->data = outData->storage.data();
+            outData->size = outData->storage.size();
+            if (statistics)
             {
-                // load from buffer view
+                statistics->bytesDecoded += outData->size;
+            }
+        }
+        else
+        {
+            // load from disk, uris are percent encoded
+            std::string uri = image->uri;
+            uri.resize(cgltf_decode_uri(uri.data()));
+            std::filesystem::path imagePath = directory / uri;
 
-                // buffer view type is invalid, but it is simply not set, which is the case for image buffers
-                cgltf_buffer_view* bufferView = image->buffer_view;
-                unsigned char const* imageBuffer = cgltf_buffer_view_data(bufferView);
-                assert(imageBuffer != nullptr);
-                size_t bufferSize = bufferView->size;
+            if (!readImageFile(imagePath, settings.memoryMapFiles, &outData->mappedFile, &outData->storage))
+            {
+                std::cerr << "failed to read image " << imagePath << std::endl;
+                return false;
+            }
+            if (outData->format == ImageFormat::Unknown)
+            {
+                outData->format = imageFormatFromPath(imagePath);
+            }
+            bool mapped = outData->mappedFile.data != nullptr;
+            outData->data = mapped ? static_cast<unsigned char const*>(outData->mappedFile.data) : outData->storage.data();
+            outData->size = mapped ? outData->mappedFile.size : outData->storage.size();
+            if (statistics)
+            {
+                statistics->bytesRead += outData->size;
+            }
+        }
+    }
+    else
+    {
+        // load from buffer view
 
-                int width, height;
-                std::vector<unsigned char> decompressedImage;
+        // buffer view type is invalid, but it is simply not set, which is the case for image buffers
+        cgltf_buffer_view* bufferView = image->buffer_view;
+        outData->data = cgltf_buffer_view_data(bufferView);
+        assert(outData->data != nullptr);
+        outData->size = bufferView->size;
+    }
+    return true;
+}
 
-                // mime_type is guaranteed to be set
-                if (strcmp(image->mime_type, "image/jpeg") == 0)
-                {
-                    // decompress jpeg
-                    {
-                        tjhandle tjInstance = tjInitDecompress();
-                        assert(tjInstance != nullptr);
-                        int jpegSubsampling, jpegColorspace;
-                        if (tjDecompressHeader3(tjInstance, imageBuffer, bufferSize, &width, &height, &jpegSubsampling, &jpegColorspace) < 0)
-                        {
-                            // error
-                            tj3Destroy(tjInstance);
-                            std::cerr << "Error decompressing JPEG: " << tjGetErrorStr() << std::endl;
-                            exit(1);
-                        }
-                        assert(jpegColorspace == 1);
-
-                        //int pixelSize = tjPixelSize[jpegColorspace]; // pixel size in samples
-                        decompressedImage.resize(width * height * 4); // rgba
-
-                        if (tjDecompress2(
-                            tjInstance,
-                            imageBuffer,
-                            bufferSize,
-                            decompressedImage.data(),
-                            width,
-                            0 /* pitch */,
-                            height,
-                            TJPF_RGBA,
-                            TJFLAG_FASTDCT) < 0)
-                        {
-                            std::cerr << "Error decompressing JPEG: " << tjGetErrorStr() << std::endl;
-                            exit(1);
-                        }
-                        tj3Destroy(tjInstance);
-                    }
-                }
-                else if (strcmp(image->mime_type, "image/png") == 0)
-                {
-                    // decode png
-                    {
-                        lodepng::State state;
-                        state.info_raw.bitdepth = 8;
-                        state.info_raw.colortype = LodePNGColorType::LCT_RGBA;
-                        unsigned w, h;
-                        unsigned error = lodepng::decode(decompressedImage, w, h, state, imageBuffer, bufferSize);
-                        width = (int)w;
-                        height = (int)h;
-
-                        if (error != 0)
-                        {
-                            std::cout << lodepng_error_text(error) << std::endl;
-                            exit(1);
-                        }
-                    }
-                }
-                else
-                {
-                    assert(false && "only jpeg and png are supported");
-                }
+static void releaseGltfImageData(GltfImageData* data)
+{
+    if (data->mappedFile.data)
+    {
+        unmapFile(&data->mappedFile);
+    }
+    data->storage = {};
+    data->data = nullptr;
+    data->size = 0;
+}
 
-                // upload to gpu
-                {
-                    MTLTextureDescriptor* descriptor = [[MTLTextureDescriptor alloc] init];
-                    descriptor.width = width;
-                    descriptor.height = height;
-                    descriptor.pixelFormat = MTLPixelFormatRGBA8Unorm;
-                    descriptor.arrayLength = 1;
-                    descriptor.textureType = MTLTextureType2D;
-                    descriptor.usage = MTLTextureUsageShaderRead;
-                    id <MTLTexture> texture = [device newTextureWithDescriptor:descriptor];
-
-                    size_t strideInBytes = 4; // for each component 1 byte = 8 bits
-
-                    MTLRegion region = MTLRegionMake2D(0, 0, width, height);
-                    [texture
-                        replaceRegion:region
-                        mipmapLevel:0
-                        slice:0
-                        withBytes:decompressedImage.data()
-                        bytesPerRow:width * strideInBytes
-                        bytesPerImage:0]; // only single image
-
-                    outModel->textures.emplace_back(texture);
-                }
+// loads the start of the encoded data of the image, enough to read its size for most images (see imageHeaderSize),
+// without decoding a whole data uri or reading a whole file. buffer views are already in memory, so are loaded in full.
+// outComplete is set to whether outData contains the entire image
+[[nodiscard]] static bool loadGltfImageHeader(
+    cgltf_image* image, std::filesystem::path const& directory, GltfImageData* outData, bool* outComplete)
+{
+    outData->format = imageFormatFromMimeType(image->mime_type);
+    *outComplete = true;
+
+    if (image->uri == nullptr)
+    {
+        outData->data = cgltf_buffer_view_data(image->buffer_view);
+        assert(outData->data != nullptr);
+        outData->size = image->buffer_view->size;
+        return true;
+    }
+
+    if (strncmp(image->uri, "data:", 5) == 0)
+    {
+        if (!decodeDataUri(image->uri, imageHeaderSize, &outData->format, &outData->storage, outComplete))
+        {
+            return false;
+        }
+    }
+    else
+    {
+        std::string uri = image->uri;
+        uri.resize(cgltf_decode_uri(uri.data()));
+        std::filesystem::path imagePath = directory / uri;
+        if (!readImageFileHeader(imagePath, imageHeaderSize, &outData->storage, outComplete))
+        {
+            std::cerr << "failed to read image " << imagePath << std::endl;
+            return false;
+        }
+        if (outData->format == ImageFormat::Unknown)
+        {
+            outData->format = imageFormatFromPath(imagePath);
+        }
+    }
+    outData->data = outData->storage.data();
+    outData->size = outData->storage.size();
+    return true;
+}
+
+// returns the maximum dimension for each image (0 = full resolution), based on the texture budget in the settings
+// when maxTextureBytes is set, the image headers are read to determine the total size, and all images are halved
+// uniformly until the total fits
+static void getGltfTextureMaxDimensions(
+    cgltf_data* data, std::filesystem::path const& directory, GltfImportSettings const& settings, std::vector<int>* outMaxDimensions)
+{
+    outMaxDimensions->assign(data->images_count, settings.maxTextureDimension);
+    if (settings.maxTextureBytes == 0 || data->images_count == 0)
+    {
+        return;
+    }
+
+    struct ImageSize
+    {
+        ImageFormat format;
+        int width;
+        int height;
+    };
+    std::vector<ImageSize> sizes(data->images_count, ImageSize{ImageFormat::Unknown, 0, 0});
+    for (size_t i = 0; i < data->images_count; i++)
+    {
+        GltfImageData imageData{};
+        bool complete = false;
+        bool hasSize = false;
+        ImageSize* size = &sizes[i];
+        if (loadGltfImageHeader(&data->images[i], directory, &imageData, &complete))
+        {
+            size->format = imageData.format;
+            hasSize = readImageSize(imageData.data, imageData.size, imageData.format, &size->width, &size->height);
+
+            // the jpeg frame header can be preceded by more metadata than fits in the header size
+            if (!hasSize && !complete)
+            {
+                releaseGltfImageData(&imageData);
+                hasSize = loadGltfImageData(&data->images[i], directory, settings, nullptr, &imageData) &&
+                          readImageSize(imageData.data, imageData.size, imageData.format, &size->width, &size->height);
+            }
+        }
+        if (!hasSize)
+        {
+            size->width = 0;
+            size->height = 0;
+        }
+        releaseGltfImageData(&imageData);
+    }
 
-                std::cout << "imported image: name: " << (bufferView->name ? bufferView->name : "") << ", width: " << width << ", height: " << height
-                          << std::endl;
+    // halve all images until the total fits in the budget (or the images can't get any smaller)
+    for (int halvings = 0; halvings < 16; halvings++)
+    {
+        size_t totalBytes = 0;
+        for (size_t i = 0; i < data->images_count; i++)
+        {
+            ImageSize size = sizes[i];
+            if (size.width == 0)
+            {
+                continue;
+            }
+            int maxDimension = std::max(std::max(size.width, size.height) >> halvings, 1);
+            if (settings.maxTextureDimension > 0)
+            {
+                maxDimension = std::min(maxDimension, settings.maxTextureDimension);
             }
+            (*outMaxDimensions)[i] = maxDimension;
 
-            //std::cout << imagePath << std::endl;
+            // ktx2 images are transcoded to a block compressed format of 1 byte per pixel, and use their mip levels
+            // instead of being downsampled, which halves the dimensions in the same way
+            int width, height;
+            getDecodedImageSize(size.width, size.height, size.format, maxDimension, &width, &height);
+            totalBytes += (size_t)width * height * (size.format == ImageFormat::Ktx2 ? 1 : 4);
+        }
+        if (totalBytes <= settings.maxTextureBytes)
+        {
+            return;
         }
     }
+}
 
-    // meshes / primitives
+// returns the block compressed format that ktx2 images are transcoded to, based on what the GPU supports
+[[nodiscard]] static CompressedTextureFormat getCompressedTextureFormat(id <MTLDevice> device)
+{
+    if ([device supportsBCTextureCompression])
     {
-        static_assert(std::is_same_v<cgltf_float, float>);
-        static_assert(std::is_same_v<cgltf_size, size_t>);
+        return CompressedTextureFormat::BC7;
+    }
+    if ([device supportsFamily:MTLGPUFamilyApple2])
+    {
+        return CompressedTextureFormat::Astc4x4;
+    }
+    return CompressedTextureFormat::Etc2;
+}
 
-        for (int i = 0; i < cgltfData->meshes_count; i++)
+[[nodiscard]] static MTLPixelFormat convertCompressedTextureFormat(CompressedTextureFormat format)
+{
+    switch (format)
+    {
+        //@formatter:off
+        case CompressedTextureFormat::BC7: return MTLPixelFormatBC7_RGBAUnorm;
+        case CompressedTextureFormat::Astc4x4: return MTLPixelFormatASTC_4x4_LDR;
+        case CompressedTextureFormat::Etc2: return MTLPixelFormatEAC_RGBA8;
+        //@formatter:on
+    }
+    assert(false);
+    return MTLPixelFormatInvalid;
+}
+
+// transcodes a ktx2 image to a block compressed format and uploads all of its mip levels to the GPU
+// the blocks are uploaded as is, so no rgba8 pixels are created at any point
+[[nodiscard]] static bool importGltfKtx2Image(
+    id <MTLDevice> device, GltfImageData* imageData, int maxDimension, GltfImageStatistics* statistics, id <MTLTexture>* outTexture)
+{
+    ImportClock::time_point decodeStart = ImportClock::now();
+
+    TranscodedImage transcodedImage;
+    bool transcoded = transcodeKtx2(imageData->data, imageData->size, getCompressedTextureFormat(device), &transcodedImage, maxDimension);
+    if (!transcoded)
+    {
+        return false;
+    }
+
+    size_t transcodedSize = 0;
+    for (TranscodedImageLevel const& level: transcodedImage.levels)
+    {
+        transcodedSize += level.blocks.size();
+    }
+    addScratchMemory(statistics->scratch, transcodedSize);
+    statistics->bytesDecoded += transcodedSize;
+    statistics->decodeNanoseconds += nanosecondsSince(decodeStart);
+    ImportClock::time_point uploadStart = ImportClock::now();
+
+    // upload to gpu
+    {
+        TranscodedImageLevel const& baseLevel = transcodedImage.levels[0];
+        MTLTextureDescriptor* descriptor = [[MTLTextureDescriptor alloc] init];
+        descriptor.width = baseLevel.width;
+        descriptor.height = baseLevel.height;
+        descriptor.pixelFormat = convertCompressedTextureFormat(transcodedImage.format);
+        descriptor.mipmapLevelCount = transcodedImage.levels.size();
+        descriptor.arrayLength = 1;
+        descriptor.textureType = MTLTextureType2D;
+        descriptor.usage = MTLTextureUsageShaderRead;
+        id <MTLTexture> texture = [device newTextureWithDescriptor:descriptor];
+        [descriptor release];
+
+        for (size_t i = 0; i < transcodedImage.levels.size(); i++)
         {
-            model::Mesh* outMesh = &outModel->meshes.emplace_back();
+            TranscodedImageLevel const& level = transcodedImage.levels[i];
+            MTLRegion region = MTLRegionMake2D(0, 0, level.width, level.height);
+            [texture
+                replaceRegion:region
+                mipmapLevel:i
+                slice:0
+                withBytes:level.blocks.data()
+                bytesPerRow:level.blockCountX * compressedBlockSize // one row of blocks
+                bytesPerImage:0];
+        }
 
-            cgltf_mesh* mesh = &cgltfData->meshes[i];
-            std::cout << "mesh name: " << (mesh->name ? mesh->name : "") << std::endl;
+        *outTexture = texture;
+    }
+
+    statistics->uploadNanoseconds += nanosecondsSince(uploadStart);
+    statistics->textureBytes += transcodedSize;
+    statistics->textureCount++;
+    transcodedImage.levels = {};
+    removeScratchMemory(statistics->scratch, transcodedSize);
+    return true;
+}
+
+// decodes the image and uploads it to the GPU
+// called from the image decode worker threads, MTLDevice is thread safe
+// maxDimension of 0 decodes the image at full resolution
+[[nodiscard]] static bool importGltfImage(
+    id <MTLDevice> device, cgltf_image* image, std::filesystem::path const& directory, GltfImportSettings const& settings,
+    int maxDimension, GltfImageStatistics* statistics, id <MTLTexture>* outTexture)
+{
+    ImportClock::time_point decodeStart = ImportClock::now();
 
-            for (int j = 0; j < mesh->primitives_count; j++)
+    GltfImageData imageData{};
+    if (!loadGltfImageData(image, directory, settings, statistics, &imageData))
+    {
+        return false;
+    }
+
+    size_t encodedScratchBytes = imageData.storage.size();
+    addScratchMemory(statistics->scratch, encodedScratchBytes);
+
+    if (imageData.format == ImageFormat::Ktx2)
+    {
+        bool imported = importGltfKtx2Image(device, &imageData, maxDimension, statistics, outTexture);
+        releaseGltfImageData(&imageData);
+        removeScratchMemory(statistics->scratch, encodedScratchBytes);
+        if (imported && settings.verbose)
+        {
+            std::cout << "imported ktx2 image: name: " << (image->name ? image->name : "") << ", width: " << [*outTexture width]
+                      << ", height: " << [*outTexture height] << ", mip levels: " << [*outTexture mipmapLevelCount] << std::endl;
+        }
+        return imported;
+    }
+
+    DecodedImage decodedImage;
+    bool decoded = decodeImage(imageData.data, imageData.size, imageData.format, &decodedImage, maxDimension);
+    releaseGltfImageData(&imageData);
+    removeScratchMemory(statistics->scratch, encodedScratchBytes);
+    if (!decoded)
+    {
+        return false;
+    }
+
+    size_t decodedSize = decodedImage.pixels.size();
+    addScratchMemory(statistics->scratch, decodedSize);
+    statistics->bytesDecoded += decodedSize;
+    statistics->decodeNanoseconds += nanosecondsSince(decodeStart);
+    ImportClock::time_point uploadStart = ImportClock::now();
+
+    // upload to gpu
+    {
+        MTLTextureDescriptor* descriptor = [[MTLTextureDescriptor alloc] init];
+        descriptor.width = decodedImage.width;
+        descriptor.height = decodedImage.height;
+        descriptor.pixelFormat = MTLPixelFormatRGBA8Unorm;
+        descriptor.arrayLength = 1;
+        descriptor.textureType = MTLTextureType2D;
+        descriptor.usage = MTLTextureUsageShaderRead;
+        id <MTLTexture> texture = [device newTextureWithDescriptor:descriptor];
+
+        size_t strideInBytes = 4; // for each component 1 byte = 8 bits
+
+        MTLRegion region = MTLRegionMake2D(0, 0, decodedImage.width, decodedImage.height);
+        [texture
+            replaceRegion:region
+            mipmapLevel:0
+            slice:0
+            withBytes:decodedImage.pixels.data()
+            bytesPerRow:decodedImage.width * strideInBytes
+            bytesPerImage:0]; // only single image
+
+        *outTexture = texture;
+    }
+
+    statistics->uploadNanoseconds += nanosecondsSince(uploadStart);
+    statistics->textureBytes += decodedSize;
+    statistics->textureCount++;
+    decodedImage.pixels = {};
+    removeScratchMemory(statistics->scratch, decodedSize);
+
+    if (settings.verbose)
+    {
+        std::cout << "imported image: name: " << (image->name ? image->name : "") << ", width: " << decodedImage.width << ", height: " << decodedImage.height
+                  << std::endl;
+    }
+    return true;
+}
+
+// returns the vertex and index buffer sizes of all primitives, including alignment padding,
+// so that all primitives of the file fit in a single vertex buffer and a single index buffer
+static void getGltfBufferSizes(cgltf_data* data, size_t* outVertexBufferSize, size_t* outIndexBufferSize)
+{
+    *outVertexBufferSize = 0;
+    *outIndexBufferSize = 0;
+    for (size_t i = 0; i < data->meshes_count; i++)
+    {
+        cgltf_mesh* mesh = &data->meshes[i];
+        for (size_t j = 0; j < mesh->primitives_count; j++)
+        {
+            cgltf_primitive* primitive = &mesh->primitives[j];
+            size_t vertexCount = 0;
+            size_t vertexDataSize = 0;
+            for (size_t k = 0; k < primitive->attributes_count; k++)
             {
-                model::Primitive* outPrimitive = &outMesh->primitives.emplace_back();
-                cgltf_primitive* primitive = &mesh->primitives[j];
+                VertexAttribute attribute{};
+                setVertexAttributeFormat(primitive->attributes[k].data, &attribute);
+                vertexCount = primitive->attributes[k].data->count;
+                vertexDataSize += attribute.stride * vertexCount;
+            }
+            *outVertexBufferSize += (vertexDataSize + vertexDataAlignment - 1) / vertexDataAlignment * vertexDataAlignment;
 
-                // set primitive type
-                {
-                    MTLPrimitiveType t;
-                    //@formatter:off
-                    switch (primitive->type)
-                    {
-                        case cgltf_primitive_type_invalid:assert(false); break;
-                        case cgltf_primitive_type_points:t = MTLPrimitiveTypePoint; break;
-                        case cgltf_primitive_type_lines:t = MTLPrimitiveTypeLine; break;
-                        case cgltf_primitive_type_line_loop:assert(false); break;
-                        case cgltf_primitive_type_line_strip:t = MTLPrimitiveTypeLineStrip; break;
-                        case cgltf_primitive_type_triangles:t = MTLPrimitiveTypeTriangle; break;
-                        case cgltf_primitive_type_triangle_strip:t = MTLPrimitiveTypeTriangleStrip; break;
-                        case cgltf_primitive_type_triangle_fan:assert(false); break;
-                        case cgltf_primitive_type_max_enum:assert(false); break;
-                    }
-                    //@formatter:on
-                    outPrimitive->primitive.primitiveType = t;
-                }
+            if (primitive->indices != nullptr)
+            {
+                size_t indexDataSize = getIndexComponentSize(primitive->indices, vertexCount) * primitive->indices->count;
+                *outIndexBufferSize += (indexDataSize + indexDataAlignment - 1) / indexDataAlignment * indexDataAlignment;
+            }
+        }
+    }
+}
 
-                // get data for each attribute
-                outPrimitive->primitive.vertexCount = std::numeric_limits<size_t>::max();
-                size_t totalVertexBufferSize = 0;
-                for (int k = 0; k < primitive->attributes_count; k++)
-                {
-                    VertexAttribute* outAttribute = &outPrimitive->primitive.attributes.emplace_back();
-                    cgltf_attribute* attribute = &primitive->attributes[k];
-                    outAttribute->type = convertGltfAttributeType(attribute->type);
-                    std::cout << "attribute: " << (attribute->name ? attribute->name : "") << std::endl;
-
-                    assert(outPrimitive->primitive.vertexCount == std::numeric_limits<size_t>::max() || outPrimitive->primitive.vertexCount == attribute->data->count);
-                    outPrimitive->primitive.vertexCount = attribute->data->count;
-                    assert(attribute->data->component_type == cgltf_component_type_r_32f && "only float component type is implemented");
-
-                    outAttribute->componentCount = cgltf_num_components(attribute->data->type);
-                    outAttribute->size = outAttribute->componentCount * sizeof(float) * outPrimitive->primitive.vertexCount;
-                    totalVertexBufferSize += outAttribute->size;
-                }
+// imports the primitive's vertex and index data into the GPU buffers of the arenas
+// returns false when EXT_meshopt_compression data could not be decoded
+[[nodiscard]] static bool importGltfPrimitive(
+    id <MTLDevice> device, cgltf_data* data, cgltf_primitive* primitive,
+    std::vector<bool> const& decodeMeshoptDirectly, BufferArena* vertexArena, BufferArena* indexArena, bool verbose,
+    PrimitiveDeinterleaved* outPrimitive)
+{
+    // set primitive type
+    {
+        MTLPrimitiveType t;
+        //@formatter:off
+        switch (primitive->type)
+        {
+            case cgltf_primitive_type_invalid:assert(false); break;
+            case cgltf_primitive_type_points:t = MTLPrimitiveTypePoint; break;
+            case cgltf_primitive_type_lines:t = MTLPrimitiveTypeLine; break;
+            case cgltf_primitive_type_line_loop:assert(false); break;
+            case cgltf_primitive_type_line_strip:t = MTLPrimitiveTypeLineStrip; break;
+            case cgltf_primitive_type_triangles:t = MTLPrimitiveTypeTriangle; break;
+            case cgltf_primitive_type_triangle_strip:t = MTLPrimitiveTypeTriangleStrip; break;
+            case cgltf_primitive_type_triangle_fan:assert(false); break;
+            case cgltf_primitive_type_max_enum:assert(false); break;
+        }
+        //@formatter:on
+        outPrimitive->primitiveType = t;
+    }
 
-                // populate vertex buffer
-                std::vector<unsigned char> values(totalVertexBufferSize);
-                size_t offset = 0;
-                for (int k = 0; k < primitive->attributes_count; k++)
-                {
-                    VertexAttribute* outAttribute = &outPrimitive->primitive.attributes[k];
-                    cgltf_attribute* attribute = &primitive->attributes[k];
+    // get data for each attribute
+    outPrimitive->vertexCount = std::numeric_limits<size_t>::max();
+    size_t totalVertexBufferSize = 0;
+    for (int k = 0; k < primitive->attributes_count; k++)
+    {
+        VertexAttribute* outAttribute = &outPrimitive->attributes.emplace_back();
+        cgltf_attribute* attribute = &primitive->attributes[k];
+        outAttribute->type = convertGltfAttributeType(attribute->type);
+        if (verbose)
+        {
+            std::cout << "attribute: " << (attribute->name ? attribute->name : "") << std::endl;
+        }
 
-                    auto* begin = (float*)&values[offset];
-                    size_t floatCount = outAttribute->componentCount * outPrimitive->primitive.vertexCount;
-                    size_t floatsUnpacked = cgltf_accessor_unpack_floats(attribute->data, begin, floatCount);
-                    assert(floatsUnpacked == floatCount);
+        assert(outPrimitive->vertexCount == std::numeric_limits<size_t>::max() || outPrimitive->vertexCount == attribute->data->count);
+        outPrimitive->vertexCount = attribute->data->count;
 
-                    offset += outAttribute->size;
-                }
+        setVertexAttributeFormat(attribute->data, outAttribute);
+        outAttribute->size = outAttribute->stride * outPrimitive->vertexCount;
+        totalVertexBufferSize += outAttribute->size;
+    }
+
+    // populate vertex buffer, written directly into the GPU buffer without intermediate copies
+    {
+        BufferArenaAllocation allocation = allocatePrimitiveData(device, vertexArena, totalVertexBufferSize, vertexDataAlignment);
+        outPrimitive->vertexBuffer = allocation.buffer;
+        outPrimitive->vertexBufferOffset = allocation.offset;
+        unsigned char* values = allocation.data;
+
+        size_t offset = 0;
+        for (int k = 0; k < primitive->attributes_count; k++)
+        {
+            VertexAttribute* outAttribute = &outPrimitive->attributes[k];
+            cgltf_attribute* attribute = &primitive->attributes[k];
 
-                // upload vertex buffer to GPU
+            unsigned char* begin = &values[offset];
+            cgltf_buffer_view* view = attribute->data->buffer_view;
+            if (view && decodeMeshoptDirectly[cgltf_buffer_view_index(data, view)])
+            {
+                if (!decodeMeshoptCompression(&view->meshopt_compression, begin))
                 {
-                    MTLResourceOptions options = MTLResourceCPUCacheModeDefaultCache | MTLResourceStorageModeShared;
-                    outPrimitive->primitive.vertexBuffer = [device newBufferWithBytes:values.data() length:values.size() * sizeof(unsigned char) options:options];
+                    std::cout << "Failed to decode EXT_meshopt_compression buffer view " << cgltf_buffer_view_index(data, view) << std::endl;
+                    return false;
                 }
+            }
+            else if (!copyAccessor(attribute->data, begin, outAttribute->stride))
+            {
+                assert(outAttribute->componentType == VertexComponentType::Float32);
+                size_t floatCount = outAttribute->componentCount * outPrimitive->vertexCount;
+                size_t floatsUnpacked = cgltf_accessor_unpack_floats(attribute->data, (float*)begin, floatCount);
+                assert(floatsUnpacked == floatCount);
+            }
 
-                // populate index buffer and upload to GPU
-                {
-                    outPrimitive->primitive.indexCount = primitive->indices->count;
-                    outPrimitive->primitive.indexed = true;
-                    size_t componentSize = cgltf_component_size(primitive->indices->component_type);
-                    if (componentSize == 4) // 32 bits
-                    {
-                        outPrimitive->primitive.indexType = MTLIndexTypeUInt32;
-                    }
-                    else if (componentSize == 2) // 16 bits
-                    {
-                        outPrimitive->primitive.indexType = MTLIndexTypeUInt16;
-                    }
-                    else
-                    {
-                        assert(false && "invalid index component type");
-                    }
+            offset += outAttribute->size;
+        }
+    }
 
-                    std::vector<unsigned char> indexBuffer(componentSize * outPrimitive->primitive.indexCount);
-                    size_t unpackedIndices = cgltf_accessor_unpack_indices(primitive->indices, indexBuffer.data(), componentSize, outPrimitive->primitive.indexCount);
-                    assert(unpackedIndices == outPrimitive->primitive.indexCount);
+    // populate index buffer, written directly into the GPU buffer without intermediate copies
+    {
+        outPrimitive->indexCount = primitive->indices->count;
+        outPrimitive->indexed = true;
+        size_t componentSize = cgltf_component_size(primitive->indices->component_type);
+        size_t outComponentSize = getIndexComponentSize(primitive->indices, outPrimitive->vertexCount);
+        outPrimitive->indexType = outComponentSize == 4 ? MTLIndexTypeUInt32 : MTLIndexTypeUInt16;
 
-                    MTLResourceOptions options = MTLResourceCPUCacheModeDefaultCache | MTLResourceStorageModeShared;
-                    outPrimitive->primitive.indexBuffer = [device
-                        newBufferWithBytes:indexBuffer.data()
-                        length:indexBuffer.size() * sizeof(unsigned char) options:options];
-                }
+        size_t indexBufferSize = outComponentSize * outPrimitive->indexCount;
+        BufferArenaAllocation allocation = allocatePrimitiveData(device, indexArena, indexBufferSize, indexDataAlignment);
+        outPrimitive->indexBuffer = allocation.buffer;
+        outPrimitive->indexBufferOffset = allocation.offset;
+        unsigned char* indices = allocation.data;
 
-                // material
-                {
-                    if (primitive->material != nullptr)
-                    {
-                        outPrimitive->materialIndex = cgltf_material_index(cgltfData, primitive->material);
-                    }
-                }
+        cgltf_buffer_view* view = primitive->indices->buffer_view;
+        if (view && decodeMeshoptDirectly[cgltf_buffer_view_index(data, view)])
+        {
+            // the meshopt index codecs don't depend on the index size, so can decode to 16 bits directly
+            // (see decodeMeshoptBufferViews, indices compressed as attributes are only decoded directly without narrowing)
+            cgltf_meshopt_compression compression = view->meshopt_compression;
+            assert(outComponentSize == componentSize ||
+                   compression.mode == cgltf_meshopt_compression_mode_triangles ||
+                   compression.mode == cgltf_meshopt_compression_mode_indices);
+            compression.stride = outComponentSize;
+            if (!decodeMeshoptCompression(&compression, indices))
+            {
+                std::cout << "Failed to decode EXT_meshopt_compression buffer view " << cgltf_buffer_view_index(data, view) << std::endl;
+                return false;
             }
         }
+        else if (outComponentSize != componentSize || !copyAccessor(primitive->indices, indices, componentSize))
+        {
+            size_t unpackedIndices = cgltf_accessor_unpack_indices(primitive->indices, indices, outComponentSize, outPrimitive->indexCount);
+            assert(unpackedIndices == outPrimitive->indexCount);
+        }
+    }
+    return true;
+}
+
+// KHR_texture_basisu: the ktx2 image is preferred, the regular image (if any) is a fallback for importers without ktx2 support
+[[nodiscard]] static size_t getGltfTextureImageIndex(cgltf_data* data, cgltf_texture const* texture)
+{
+    if (texture->has_basisu && texture->basisu_image != nullptr)
+    {
+        return cgltf_image_index(data, texture->basisu_image);
     }
+    assert(texture->image != nullptr);
+    return cgltf_image_index(data, texture->image);
+}
+
+// imports materials, nodes and scenes, which are cheap compared to meshes and textures.
+// meshes and textures are added as empty placeholders, so that all indices are valid before they are imported
+static void importGltfStructure(cgltf_data* data, model::Model* outModel)
+{
+    outModel->meshes.resize(data->meshes_count);
+    outModel->textures.resize(data->images_count, nullptr);
 
     // materials
     {
-        for (int i = 0; i < cgltfData->materials_count; i++)
+        for (int i = 0; i < data->materials_count; i++)
         {
             model::Material* outMaterial = &outModel->materials.emplace_back();
-            cgltf_material* material = &cgltfData->materials[i];
+            cgltf_material* material = &data->materials[i];
             assert(material->has_pbr_metallic_roughness);
             cgltf_pbr_metallic_roughness mat = material->pbr_metallic_roughness;
 
             cgltf_texture* normal = material->normal_texture.texture;
             if (normal != nullptr)
             {
-                outMaterial->normalMap = cgltf_image_index(cgltfData, normal->image);
+                outMaterial->normalMap = getGltfTextureImageIndex(data, normal);
             }
 
             cgltf_texture* baseColor = mat.base_color_texture.texture;
             if (baseColor != nullptr)
             {
-                outMaterial->baseColorMap = cgltf_image_index(cgltfData, baseColor->image);
+                outMaterial->baseColorMap = getGltfTextureImageIndex(data, baseColor);
             }
 
             cgltf_texture* metallicRoughness = mat.metallic_roughness_texture.texture;
             if (metallicRoughness != nullptr)
             {
-                outMaterial->metallicRoughnessMap = cgltf_image_index(cgltfData, metallicRoughness->image);
+                outMaterial->metallicRoughnessMap = getGltfTextureImageIndex(data, metallicRoughness);
             }
 
             cgltf_texture* emissive = material->emissive_texture.texture;
             if (emissive != nullptr)
             {
-                outMaterial->emissionMap = cgltf_image_index(cgltfData, emissive->image);
+                outMaterial->emissionMap = getGltfTextureImageIndex(data, emissive);
             }
         }
     }
 
     // nodes
     {
-        for (int i = 0; i < cgltfData->nodes_count; i++)
+        for (int i = 0; i < data->nodes_count; i++)
         {
-            cgltf_node* node = &cgltfData->nodes[i];
+            cgltf_node* node = &data->nodes[i];
             model::Node* outNode = &outModel->nodes.emplace_back();
 
             float* a = glm::value_ptr(outNode->localTransform);
@@ -356,21 +1015,21 @@ bool importGltf(id <MTLDevice> device, std::filesystem::path const& path, model:
 
             if (node->mesh != nullptr)
             {
-                outNode->meshIndex = cgltf_mesh_index(cgltfData, node->mesh);
+                outNode->meshIndex = cgltf_mesh_index(data, node->mesh);
             }
 
             for (int j = 0; j < node->children_count; j++)
             {
-                outNode->childNodes.emplace_back(cgltf_node_index(cgltfData, node->children[j]));
+                outNode->childNodes.emplace_back(cgltf_node_index(data, node->children[j]));
             }
         }
     }
 
     // scenes
     {
-        for (int i = 0; i < cgltfData->scenes_count; i++)
+        for (int i = 0; i < data->scenes_count; i++)
         {
-            cgltf_scene* scene = &cgltfData->scenes[i];
+            cgltf_scene* scene = &data->scenes[i];
             model::Scene* outScene = &outModel->scenes.emplace_back();
 
             // create root node that contains scene root nodes as children
@@ -382,11 +1041,416 @@ bool importGltf(id <MTLDevice> device, std::filesystem::path const& path, model:
             for (int j = 0; j < scene->nodes_count; j++)
             {
                 cgltf_node* node = scene->nodes[j];
-                rootNode->childNodes.emplace_back(cgltf_node_index(cgltfData, node));
+                rootNode->childNodes.emplace_back(cgltf_node_index(data, node));
+            }
+        }
+    }
+}
+
+// receives the results of an import as they complete, so that the same import code is used
+// for both the blocking importGltf and the asynchronous startGltfImport
+struct GltfImportSink
+{
+    // materials, nodes and scenes, with placeholders for meshes and textures. called once, before onMesh and onTexture
+    std::function<void(model::Model&& structure, size_t totalSteps)> onStructure;
+    std::function<void(size_t meshIndex, model::Mesh&& mesh)> onMesh;
+    std::function<void(size_t textureIndex, id <MTLTexture> texture)> onTexture; // called from the image decode threads
+    std::function<void(BufferArena&& vertexArena, BufferArena&& indexArena)> onBuffers; // called once, after all meshes
+    std::atomic<bool> const* cancelled = nullptr;
+};
+
+// imports the gltf file and reports the results to the sink as they complete
+// texture indices are equal to the gltf image indices, so that the material texture indices resolve
+static bool importGltfWithSink(
+    id <MTLDevice> device, std::filesystem::path const& path, GltfImportSettings settings, GltfImportSink* sink,
+    ImportStatistics* outStatistics)
+{
+    assert(exists(path));
+
+    ImportStatistics statistics{};
+    ScratchMemoryTracker scratch{};
+    ImportClock::time_point importStart = ImportClock::now();
+
+    // parse file
+    cgltf_options cgltfOptions = {
+        .type = cgltf_file_type_invalid, // = auto detect
+        .file = cgltf_file_options{}
+    };
+    if (settings.memoryMapFiles)
+    {
+        cgltfOptions.file.read = mapGltfFile;
+        cgltfOptions.file.release = unmapGltfFile;
+    }
+    cgltf_data* cgltfData = nullptr;
+    ImportClock::time_point phaseStart = ImportClock::now();
+    cgltf_result parseFileResult = cgltf_parse_file(&cgltfOptions, path.c_str(), &cgltfData);
+    if (parseFileResult != cgltf_result_success)
+    {
+        cgltf_free(cgltfData);
+        std::cout << "Failed to parse gltf file" << std::endl;
+        return false;
+    }
+    addImportPhaseTime(&statistics, "parse", phaseStart);
+    statistics.bytesRead += file_size(path);
+
+    // load buffers
+    phaseStart = ImportClock::now();
+    cgltf_result loadBuffersResult = cgltf_load_buffers(&cgltfOptions, cgltfData, path.c_str());
+    if (loadBuffersResult != cgltf_result_success)
+    {
+        cgltf_free(cgltfData);
+        std::cout << "Failed to load buffers, this can be due to .bin files not being located next to the file" << std::endl;
+        return false;
+    }
+    addImportPhaseTime(&statistics, "load_buffers", phaseStart);
+    for (size_t i = 0; i < cgltfData->buffers_count; i++)
+    {
+        // the binary chunk of a glb file is part of the file itself
+        char const* uri = cgltfData->buffers[i].uri;
+        if (uri != nullptr && strncmp(uri, "data:", 5) != 0)
+        {
+            statistics.bytesRead += cgltfData->buffers[i].size;
+        }
+    }
+
+    // EXT_meshopt_compression
+    phaseStart = ImportClock::now();
+    std::vector<bool> decodeMeshoptDirectly;
+    if (!decodeMeshoptBufferViews(cgltfData, &decodeMeshoptDirectly))
+    {
+        cgltf_free(cgltfData);
+        return false;
+    }
+    addImportPhaseTime(&statistics, "meshopt_decode", phaseStart);
+
+    // buffer views that are not decoded directly into the vertex and index buffers stay in memory until cgltf_free
+    size_t meshoptScratchBytes = 0;
+    for (size_t i = 0; i < cgltfData->buffer_views_count; i++)
+    {
+        cgltf_buffer_view* view = &cgltfData->buffer_views[i];
+        if (view->has_meshopt_compression)
+        {
+            size_t decodedSize = view->meshopt_compression.count * view->meshopt_compression.stride;
+            statistics.bytesDecoded += decodedSize;
+            meshoptScratchBytes += decodeMeshoptDirectly[i] ? 0 : decodedSize;
+        }
+    }
+    addScratchMemory(&scratch, meshoptScratchBytes);
+
+    // materials, nodes and scenes
+    phaseStart = ImportClock::now();
+    {
+        model::Model structure{};
+        importGltfStructure(cgltfData, &structure);
+        sink->onStructure(std::move(structure), cgltfData->meshes_count + cgltfData->images_count);
+    }
+    addImportPhaseTime(&statistics, "structure", phaseStart);
+
+    // images
+    // relative uris are resolved against the directory of the gltf file
+    std::filesystem::path directory = path.parent_path();
+
+    // texture budget
+    phaseStart = ImportClock::now();
+    std::vector<int> maxDimensions;
+    getGltfTextureMaxDimensions(cgltfData, directory, settings, &maxDimensions);
+    addImportPhaseTime(&statistics, "texture_budget", phaseStart);
+
+    // decoding is fanned out over a pool of worker threads, while meshes are imported on this thread.
+    std::atomic<bool> imagesSucceeded = true;
+    GltfImageStatistics imageStatistics{};
+    imageStatistics.scratch = &scratch;
+    ThreadPool imageDecodePool;
+    if (cgltfData->images_count > 0)
+    {
+        startThreadPool(&imageDecodePool, std::min(
+            settings.imageDecodeThreadCount == 0 ? defaultThreadCount() : settings.imageDecodeThreadCount,
+            cgltfData->images_count));
+
+        for (size_t i = 0; i < cgltfData->images_count; i++)
+        {
+            submitJob(&imageDecodePool, [device, cgltfData, sink, &imagesSucceeded, &directory, &settings, &maxDimensions, &imageStatistics, i]() {
+                if (sink->cancelled && *sink->cancelled)
+                {
+                    return;
+                }
+                @autoreleasepool
+                {
+                    id <MTLTexture> texture = nullptr;
+                    if (importGltfImage(device, &cgltfData->images[i], directory, settings, maxDimensions[i], &imageStatistics, &texture))
+                    {
+                        sink->onTexture(i, texture);
+                    }
+                    else
+                    {
+                        imagesSucceeded = false;
+                    }
+                }
+            });
+        }
+    }
+
+    // meshes / primitives
+    // all vertex and index data is sub-allocated from one vertex buffer and one index buffer,
+    // only primitives that are split (see splitLargePrimitives) can overflow into a second block
+    BufferArena vertexArena{};
+    BufferArena indexArena{};
+    {
+        size_t vertexBufferSize;
+        size_t indexBufferSize;
+        getGltfBufferSizes(cgltfData, &vertexBufferSize, &indexBufferSize);
+        createBufferArena(device, arenaBlockSize, &vertexArena);
+        createBufferArena(device, arenaBlockSize, &indexArena);
+        if (vertexBufferSize > 0)
+        {
+            reserveBufferArena(&vertexArena, vertexBufferSize);
+        }
+        if (indexBufferSize > 0)
+        {
+            reserveBufferArena(&indexArena, indexBufferSize);
+        }
+    }
+
+    MeshOptimizationStatistics optimizationStatistics{};
+    ScratchArena scratchArena{};
+    createScratchArena(scratchBlockSize, &scratchArena);
+    std::vector<PrimitiveDeinterleaved> chunks; // reused for each primitive
+    bool meshesSucceeded = true;
+    {
+        static_assert(std::is_same_v<cgltf_float, float>);
+        static_assert(std::is_same_v<cgltf_size, size_t>);
+
+        for (size_t i = 0; i < cgltfData->meshes_count; i++)
+        {
+            if (sink->cancelled && *sink->cancelled)
+            {
+                break;
+            }
+
+            model::Mesh outMesh{};
+            cgltf_mesh* mesh = &cgltfData->meshes[i];
+            if (settings.verbose)
+            {
+                std::cout << "mesh name: " << (mesh->name ? mesh->name : "") << std::endl;
+            }
+
+            for (size_t j = 0; j < mesh->primitives_count; j++)
+            {
+                cgltf_primitive* primitive = &mesh->primitives[j];
+
+                // unpacked straight into the GPU buffers, so this includes the upload
+                phaseStart = ImportClock::now();
+                PrimitiveDeinterleaved outPrimitive{};
+                if (!importGltfPrimitive(device, cgltfData, primitive, decodeMeshoptDirectly, &vertexArena, &indexArena, settings.verbose, &outPrimitive))
+                {
+                    meshesSucceeded = false;
+                    break;
+                }
+                addImportPhaseTime(&statistics, "unpack", phaseStart);
+
+                // material
+                size_t materialIndex = invalidIndex;
+                if (primitive->material != nullptr)
+                {
+                    materialIndex = cgltf_material_index(cgltfData, primitive->material);
+                }
+
+                // the arena space of the original primitive is not reclaimed when it is split
+                phaseStart = ImportClock::now();
+                chunks.clear();
+                if (!settings.splitLargePrimitives || !splitPrimitiveForUInt16Indices(device, &vertexArena, &indexArena, &outPrimitive, &chunks))
+                {
+                    chunks.emplace_back(outPrimitive);
+                }
+                addImportPhaseTime(&statistics, "split", phaseStart);
+
+                for (PrimitiveDeinterleaved& chunk: chunks)
+                {
+                    if (settings.optimizeMeshes)
+                    {
+                        phaseStart = ImportClock::now();
+                        optimizePrimitive(&chunk, &scratchArena, &optimizationStatistics);
+                        addImportPhaseTime(&statistics, "optimize", phaseStart);
+                    }
+                    for (VertexAttribute const& attribute: chunk.attributes)
+                    {
+                        statistics.vertexBytes += attribute.size;
+                    }
+                    statistics.indexBytes += chunk.indexCount * (chunk.indexType == MTLIndexTypeUInt16 ? 2 : 4);
+                    statistics.primitiveCount++;
+                    outMesh.primitives.emplace_back(model::Primitive{
+                        .primitive = chunk,
+                        .materialIndex = materialIndex
+                    });
+                }
+                addScratchArenaUsage(&scratch, &scratchArena);
+                resetScratchArena(&scratchArena);
             }
+
+            if (!meshesSucceeded)
+            {
+                break;
+            }
+            sink->onMesh(i, std::move(outMesh));
+            statistics.meshCount++;
         }
     }
+    addScratchArenaStatistics(&statistics, &scratchArena);
+    destroyScratchArena(&scratchArena);
+    sink->onBuffers(std::move(vertexArena), std::move(indexArena));
+
+    // wait for image decoding to complete, as the jobs reference cgltfData
+    phaseStart = ImportClock::now();
+    if (!imageDecodePool.threads.empty())
+    {
+        stopThreadPool(&imageDecodePool);
+    }
+    addImportPhaseTime(&statistics, "wait_for_images", phaseStart);
+    addImportPhaseSeconds(&statistics, "image_decode", (double)imageStatistics.decodeNanoseconds * 1e-9);
+    addImportPhaseSeconds(&statistics, "texture_upload", (double)imageStatistics.uploadNanoseconds * 1e-9);
+    statistics.bytesRead += imageStatistics.bytesRead;
+    statistics.bytesDecoded += imageStatistics.bytesDecoded;
+    statistics.textureBytes += imageStatistics.textureBytes;
+    statistics.textureCount += imageStatistics.textureCount;
+
+    if (settings.optimizeMeshes)
+    {
+        std::cout << "gltf: optimized meshes of " << path.filename() << ": " << meshOptimizationStatisticsToString(&optimizationStatistics) << std::endl;
+    }
 
     cgltf_free(cgltfData);
-    return true;
-}
\ No newline at end of file
+    removeScratchMemory(&scratch, meshoptScratchBytes);
+
+    statistics.totalSeconds = secondsSince(importStart);
+    statistics.peakScratchBytes = scratch.peak;
+    if (outStatistics != nullptr)
+    {
+        *outStatistics = std::move(statistics);
+    }
+    return imagesSucceeded && meshesSucceeded && !(sink->cancelled && *sink->cancelled);
+}
+
+bool importGltf(id <MTLDevice> device, std::filesystem::path const& path, model::Model* outModel, GltfImportSettings settings, ImportStatistics* outStatistics)
+{
+    assert(outModel != nullptr);
+    assert(outModel->meshes.empty() && outModel->nodes.empty() && "gltf should be imported into an empty model");
+
+    // results are written directly into the model, each texture job writes to its own index,
+    // and the textures vector is not resized while the jobs are running
+    GltfImportSink sink{
+        .onStructure = [outModel](model::Model&& structure, size_t) { *outModel = std::move(structure); },
+        .onMesh = [outModel](size_t index, model::Mesh&& mesh) { outModel->meshes[index] = std::move(mesh); },
+        .onTexture = [outModel](size_t index, id <MTLTexture> texture) { outModel->textures[index] = texture; },
+        .onBuffers = [outModel](BufferArena&& vertexArena, BufferArena&& indexArena) {
+            outModel->vertexArena = std::move(vertexArena);
+            outModel->indexArena = std::move(indexArena);
+        }
+    };
+    return importGltfWithSink(device, path, settings, &sink, outStatistics);
+}
+
+void startGltfImport(id <MTLDevice> device, std::filesystem::path const& path, GltfImportSettings settings, GltfImport* outImport)
+{
+    assert(outImport != nullptr);
+    assert(!outImport->thread.joinable() && "import already started");
+
+    outImport->path = path;
+    outImport->cancelled = false;
+    outImport->finished = false;
+    outImport->succeeded = false;
+    outImport->reportedFailure = false;
+    outImport->completedSteps = 0;
+    outImport->totalSteps = 0;
+
+    outImport->thread = std::thread([device, path, settings, outImport]() {
+        @autoreleasepool
+        {
+            GltfImportSink sink{
+                .onStructure = [outImport](model::Model&& structure, size_t totalSteps) {
+                    std::unique_lock<std::mutex> lock(outImport->mutex);
+                    outImport->structure = std::move(structure);
+                    outImport->hasStructure = true;
+                    outImport->totalSteps = totalSteps;
+                },
+                .onMesh = [outImport](size_t index, model::Mesh&& mesh) {
+                    std::unique_lock<std::mutex> lock(outImport->mutex);
+                    outImport->completedMeshes.emplace_back(index, std::move(mesh));
+                    outImport->completedSteps++;
+                },
+                .onTexture = [outImport](size_t index, id <MTLTexture> texture) {
+                    std::unique_lock<std::mutex> lock(outImport->mutex);
+                    outImport->completedTextures.emplace_back(index, texture);
+                    outImport->completedSteps++;
+                },
+                .onBuffers = [outImport](BufferArena&& vertexArena, BufferArena&& indexArena) {
+                    std::unique_lock<std::mutex> lock(outImport->mutex);
+                    outImport->vertexArena = std::move(vertexArena);
+                    outImport->indexArena = std::move(indexArena);
+                    outImport->hasBuffers = true;
+                },
+                .cancelled = &outImport->cancelled
+            };
+            outImport->succeeded = importGltfWithSink(device, path, settings, &sink, &outImport->statistics);
+            outImport->finished = true;
+        }
+    });
+}
+
+bool updateGltfImport(GltfImport* import, model::Model* model)
+{
+    assert(import != nullptr);
+    assert(model != nullptr);
+
+    // read before applying, so that results that complete after this point are applied in the next update
+    bool finished = import->finished;
+
+    std::unique_lock<std::mutex> lock(import->mutex);
+    if (import->hasStructure)
+    {
+        *model = std::move(import->structure);
+        import->structure = {};
+        import->hasStructure = false;
+    }
+    for (auto& [index, mesh]: import->completedMeshes)
+    {
+        model->meshes[index] = std::move(mesh);
+    }
+    import->completedMeshes.clear();
+    for (auto& [index, texture]: import->completedTextures)
+    {
+        model->textures[index] = texture;
+    }
+    import->completedTextures.clear();
+    if (import->hasBuffers)
+    {
+        model->vertexArena = std::move(import->vertexArena);
+        model->indexArena = std::move(import->indexArena);
+        import->hasBuffers = false;
+    }
+
+    return finished;
+}
+
+float getGltfImportProgress(GltfImport const* import)
+{
+    if (import->finished)
+    {
+        return 1.0f;
+    }
+    size_t totalSteps = import->totalSteps;
+    return totalSteps == 0 ? 0.0f : (float)import->completedSteps / (float)totalSteps;
+}
+
+void cancelGltfImport(GltfImport* import)
+{
+    import->cancelled = true;
+}
+
+bool finishGltfImport(GltfImport* import)
+{
+    if (import->thread.joinable())
+    {
+        import->thread.join();
+    }
+    return import->succeeded;
+}
@@ -5,7 +5,10 @@
 #ifndef METAL_EXPERIMENT_IFC_H
 #define METAL_EXPERIMENT_IFC_H
 
+#include <atomic>
 #include <filesystem>
+#include <string>
+#include <thread>
 #include <vector>
 #include <unordered_map>
 
@@ -16,14 +19,144 @@
 
 #include "../model.h"
 #include "../mesh.h"
+#include "../mesh_optimization.h"
+#include "../occluder.h"
 #include "../constants.h"
+#include "../spsc_queue.h"
+#include "../vertex_welding.h"
+#include "ifc_filter.h"
+#include "ifc_index.h"
+#include "import_statistics.h"
 
 struct IfcImportSettings
 {
     bool flipYAndZAxes;
+
+    // which elements are imported, e.g. a single storey or only the structural elements. default = all elements
+    IfcImportFilter filter{};
+
+    // amount of threads IfcOpenShell uses for tessellating elements, 0 = one per hardware thread
+    // meshes and nodes are sorted on element id, so the model is the same regardless of the thread count
+    size_t tessellationThreadCount = 0;
+
+    // amount of threads that weld, convert and simplify the tessellated elements, 0 = half of the tessellation threads
+    // (at least 1). these run next to the tessellation threads and the calling thread, which uploads the elements while
+    // the next elements are processed, so the import uses tessellation + process threads + 1 threads in total
+    size_t processThreadCount = 0;
+
+    // elements that use the same representation (e.g. repeated windows, doors or columns) share a single mesh, with a node
+    // per element for its transform. the renderer draws all nodes of a mesh with one instanced draw call
+    bool instanceSharedRepresentations = true;
+
+    // indices are stored as 16 bits when an element has few enough vertices
+    // when enabled, elements with too many vertices for 16-bit indices are split into multiple primitives that do fit
+    bool splitLargePrimitives = false;
+
+    // reorder indices and vertices for vertex cache, overdraw and vertex fetch efficiency (see optimizePrimitive)
+    // the tessellated output is in an arbitrary order, ACMR / ATVR before and after are logged per file
+    bool optimizeMeshes = true;
+
+    // merge the vertices of an element that have the same position and normal (within the tolerance), as the tessellator
+    // outputs separate vertices for each triangle. vertices on both sides of a hard edge have different normals and stay
+    // separate. the vertex count before and after is logged per file
+    bool weldVertices = true;
+    VertexWeldTolerance weldTolerance{};
+
+    // levels of detail of each mesh, simplified with the quadric error metric (see generateLods). the renderer selects a
+    // level per node based on its distance to the camera. a levelCount of 1 disables simplification
+    LodSettings lodSettings{};
+
+    // store positions as 16-bit integers relative to the bounds of each mesh, and normals octahedral encoded in 2 16-bit
+    // integers (12 instead of 24 bytes per vertex). the dequantization scale and offset are added to the node transforms
+    bool quantizeVertices = false;
+
+    // occluders for walls, slabs and roofs (including their subtypes): a few boxes inside the element that the renderer
+    // rasterizes instead of its full geometry, to skip the elements behind it (see generateBoxOccluders)
+    bool generateOccluders = false;
+    OccluderSettings occluderSettings{};
+
+    // directory of the tessellation cache, empty = disabled. the result of an import is stored per file contents and
+    // the settings above, so importing the same file again only memory maps the cache file (see ifc_cache.h)
+    std::filesystem::path cacheDirectory;
+
+    // log each element
+    bool verbose = false;
 };
 
 // returns true when successful
-[[nodiscard]] bool importIfc(id <MTLDevice> device, std::filesystem::path const& path, model::Model* outModel, IfcImportSettings settings);
+// outStatistics is optional, see ImportStatistics. peak scratch memory does not include the memory used by IfcOpenShell
+// outIndex is optional, and receives the GlobalId, type and name of each node of the model (see IfcElementIndex)
+[[nodiscard]] bool importIfc(
+    id <MTLDevice> device, std::filesystem::path const& path, model::Model* outModel,
+    IfcImportSettings settings, ImportStatistics* outStatistics = nullptr, IfcElementIndex* outIndex = nullptr);
+
+// imports the elements of the file that pass settings.filter and adds them to a model that was imported with importIfc
+// (e.g. with a filter for another storey), as children of its root node. the vertex and index buffers of the subset are
+// added to the model's buffer arenas. elements that are already in the model are imported again, so the filters
+// should not overlap
+// index is optional, the index of the model that the metadata of the added nodes is added to
+// returns true when successful
+[[nodiscard]] bool importIfcSubset(
+    id <MTLDevice> device, std::filesystem::path const& path, model::Model* model,
+    IfcImportSettings settings, ImportStatistics* outStatistics = nullptr, IfcElementIndex* index = nullptr);
+
+// element that has been tessellated and uploaded on the import thread, see IfcImport
+struct IfcImportedElement
+{
+    int id = 0; // entity instance id of the element, 0 when read from the cache
+    std::string globalId;
+    std::string type;
+    std::string name;
+    size_t geometryIndex = invalidIndex; // index of the mesh in the model, meshes are added in the order they are created
+    bool hasMesh = false; // whether this is the first element that uses the geometry, mesh is then added to the model
+    model::Mesh mesh;
+    std::vector<model::Material> materials; // materials that are first referenced by mesh, appended to the model
+    glm::mat4 transform;
+};
+
+// handle to an ifc import running on a background thread
+// the import thread pushes each element to a bounded lock free queue as soon as it has been tessellated, and
+// updateIfcImport adds a limited amount of elements per call to the model, so the building assembles while rendering
+// without stalling a frame. the import thread waits when the queue is full.
+// unlike importIfc, nodes, meshes and materials are added in the order the elements complete
+struct IfcImport
+{
+    std::thread thread;
+    std::filesystem::path path;
+    std::atomic<bool> cancelled = false;
+    std::atomic<bool> finished = false; // set after all elements have been pushed
+    std::atomic<bool> succeeded = false;
+
+    SpscQueue<IfcImportedElement> queue;
+
+    // owned by the import thread until finished, then moved to the model by updateIfcImport
+    // the primitives in the queue already reference the buffers of these arenas
+    BufferArena vertexArena;
+    BufferArena indexArena;
+
+    // only accessed by the thread that calls updateIfcImport
+    bool appliedBuffers = false;
+    size_t appliedElementCount = 0;
+    bool reportedFailure = false;
+    IfcElementIndex elementIndex; // metadata of the nodes that have been added to the model
+
+    // valid after finished
+    ImportStatistics statistics;
+};
+
+// starts importing the ifc file on a background thread
+// uses the cache in the same way as importIfc, a cache hit is streamed to the model in the same way
+void startIfcImport(id <MTLDevice> device, std::filesystem::path const& path, IfcImportSettings settings, IfcImport* outImport);
+
+// adds at most maxElementCount of the elements that have completed since the last update to the model
+// should be called from the thread that renders the model (e.g. once per frame), the model should be empty before the first call
+// returns true when the import has finished and all elements have been added
+bool updateIfcImport(IfcImport* import, model::Model* model, size_t maxElementCount);
+
+// requests the import to stop, does not block
+void cancelIfcImport(IfcImport* import);
+
+// blocks until the background thread has stopped, returns true when the import was successful
+bool finishIfcImport(IfcImport* import);
 
 #endif //METAL_EXPERIMENT_IFC_H
@@ -5,44 +5,536 @@
 #include "ifc.h"
 
 #include <ifcgeom/Iterator.h>
+#include <ifcgeom/IfcGeomFilter.h>
 #include <ifcgeom/ConversionSettings.h>
 #include <ifcparse/IfcFile.h>
 
-#include <unordered_set>
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <functional>
+#include <limits>
+#include <numeric>
+#include <span>
+#include <string>
+#include <thread>
+#include <unordered_map>
+
+#include "ifc_cache.h"
+#include "../mesh_optimization.h"
+#include "../occluder.h"
+#include "../scratch_arena.h"
+#include "../thread_pool.h"
+#include "../vertex_welding.h"
 
 #include "glm/gtc/type_ptr.hpp"
+#include "glm/gtc/matrix_transform.hpp"
+#include "fmt/format.h"
+
+// size of the vertex and index buffers that the elements are sub-allocated from
+constexpr size_t arenaBlockSize = 16 * 1024 * 1024;
+
+// initial size of the scratch memory for the temporaries of a single element, grows to fit the largest element
+constexpr size_t scratchBlockSize = 1024 * 1024;
+
+// amount of elements that can be waiting to be added to the model by updateIfcImport before the import thread waits
+constexpr size_t ifcImportQueueCapacity = 1024;
+
+// amount of elements that are taken from the iterator and processed on the worker threads together
+constexpr size_t ifcElementBatchSize = 64;
+
+// smallest dequantization scale of an axis relative to the largest axis, so that the dequantization of flat elements
+// (e.g. a plate) can be inverted for the normal matrix
+constexpr double ifcMinQuantizationExtent = 1.0 / 1024.0;
+
+// ifc styles only define colors, so all materials use the same pbr parameters
+constexpr float ifcMaterialMetalness = 0.0f;
+constexpr float ifcMaterialRoughness = 0.8f;
+
+// walls, slabs and roofs are large closed solids that hide most of a building from any viewpoint
+[[nodiscard]] static bool isIfcOccluderElement(IfcGeom::Element const* element)
+{
+    IfcUtil::IfcBaseEntity const* product = element->product();
+    return product && (product->declaration().is("IfcWall") ||
+                       product->declaration().is("IfcSlab") ||
+                       product->declaration().is("IfcRoof"));
+}
+
+// returns the index of the material for the given style in outMaterials, the material is added if it doesn't exist yet
+// styles are compared on name and color, as each element can have its own copy of the same style
+[[nodiscard]] static size_t getIfcMaterial(
+    ifcopenshell::geometry::taxonomy::style::ptr const& style,
+    std::vector<model::Material>* outMaterials,
+    std::unordered_map<std::string, size_t>* outMaterialIndices)
+{
+    ifcopenshell::geometry::taxonomy::colour const& color = style->get_color();
+    simd_float3 baseColor = color ? simd_float3{(float)color.r(), (float)color.g(), (float)color.b()} : simd_float3{1, 1, 1};
+    std::string key = fmt::format("{}|{:.4f}|{:.4f}|{:.4f}", style->name, baseColor.x, baseColor.y, baseColor.z);
+
+    auto [it, inserted] = outMaterialIndices->try_emplace(key, outMaterials->size());
+    if (inserted)
+    {
+        outMaterials->emplace_back(model::Material{
+            .baseColor = baseColor,
+            .metalness = ifcMaterialMetalness,
+            .roughness = ifcMaterialRoughness
+        });
+    }
+    return it->second;
+}
+
+// geometry index and transform of a single element, collected while iterating and added to the model in a deterministic order
+struct IfcElementInstance
+{
+    int id; // entity instance id of the element, unique within the file
+    size_t geometryIndex; // elements with the same representation share a geometry
+    glm::mat4 transform;
+    std::string globalId;
+    std::string type;
+    std::string name;
+};
+
+// receives the elements of an import as they complete, so that the same import code is used
+// for both the blocking importIfc and the streaming startIfcImport
+struct IfcImportSink
+{
+    std::function<void(IfcImportedElement&& element)> onElement; // called on the importing thread
+    std::atomic<bool> const* cancelled = nullptr;
+};
+
+// position of a vertex in the output of the tessellator, in double precision so that large (e.g. georeferenced)
+// coordinates don't lose precision before they are made relative to the bounds of the mesh
+[[nodiscard]] static glm::dvec3 getIfcVertexPosition(std::vector<double> const& vertices, size_t index, bool flipYAndZAxes)
+{
+    return glm::dvec3{
+        vertices[index * 3],
+        vertices[index * 3 + (flipYAndZAxes ? 2 : 1)],
+        vertices[index * 3 + (flipYAndZAxes ? 1 : 2)]
+    };
+}
 
-[[nodiscard]] bool grouped(std::vector<size_t>* indices)
+[[nodiscard]] static float3 getIfcVertexNormal(std::vector<double> const& normals, size_t index, bool flipYAndZAxes)
 {
-    assert(!indices->empty());
-    size_t currentIndex = indices->at(0);
+    return float3{
+        static_cast<float>(normals[index * 3]),
+        static_cast<float>(normals[index * 3 + (flipYAndZAxes ? 2 : 1)]),
+        static_cast<float>(normals[index * 3 + (flipYAndZAxes ? 1 : 2)])
+    };
+}
 
-    std::unordered_set<size_t> foundIndices;
+[[nodiscard]] static glm::mat4 getIfcElementTransform(IfcGeom::TriangulationElement const* element, bool flipYAndZAxes)
+{
+    ifcopenshell::geometry::taxonomy::matrix4::ptr const& transform = element->transformation().data();
+    Eigen::Matrix<double, 4, 4>& m = transform->components();
+    glm::mat4 outMatrix;
+    for (int i = 0; i < 4 * 4; i++)
+    {
+        auto a = static_cast<float>(m(i));
+        outMatrix[i / 4][i % 4] = a;
+    }
 
-    for (auto& index: *indices)
+    if (flipYAndZAxes)
     {
-        if (index != currentIndex)
+        glm::mat4 flipMatrix = glm::mat4{
+            1, 0, 0, 0,
+            0, 0, 1, 0,
+            0, 1, 0, 0,
+            0, 0, 0, 1
+        };
+        outMatrix = flipMatrix * outMatrix * flipMatrix;
+    }
+    return outMatrix;
+}
+
+// vertices and indices of a single mesh, created on a worker thread by processIfcMesh
+// the arrays are allocated from the scratch arena of the worker, and stay valid until the batch is reset
+struct IfcMeshData
+{
+    size_t inputVertexCount = 0;
+    size_t vertexCount = 0; // after welding
+    std::span<uint32_t> sourceVertices; // input vertex of each vertex, empty when not welded
+
+    glm::dvec3 center{};
+    glm::dvec3 extent{}; // scale of the quantized positions
+    glm::vec3 boundsMin{};
+    glm::vec3 boundsMax{};
+    glm::mat4 dequantization{1}; // identity if not quantized
+
+    // either the float or the quantized attributes are set
+    std::span<float3> positions;
+    std::span<float3> normals;
+    std::span<short4> quantizedPositions;
+    std::span<short2> octahedralNormals;
+
+    std::span<uint32_t> indices; // sorted on material, so that the triangles of each material are a contiguous range
+    std::span<IndexRange> ranges;
+    std::span<size_t> rangeMaterials; // index into the materials of the triangulation, invalidIndex = no material
+
+    // levels of detail, the indices of all levels are stored after each other (see generateLods)
+    // without simplification, lodIndices and lodRanges are the same as indices and ranges
+    std::span<uint32_t> lodIndices;
+    std::span<IndexRange> lodRanges; // level-major
+    std::span<float> lodErrors;
+    size_t lodCount = 1;
+
+    // occluders in the same space as the vertex positions (see model::Mesh), empty if the element is not an occluder
+    std::vector<glm::vec3> occluderPositions;
+    std::vector<uint32_t> occluderIndices;
+
+    // time spent on the worker thread
+    double weldSeconds = 0.0;
+    double convertSeconds = 0.0;
+    double simplifySeconds = 0.0;
+    double occluderSeconds = 0.0;
+};
+
+[[nodiscard]] static size_t getIfcSourceVertex(IfcMeshData const* mesh, size_t i)
+{
+    return mesh->sourceVertices.empty() ? i : (size_t)mesh->sourceVertices[i];
+}
+
+// welds the vertices of the triangulation, converts them to the vertex format of the renderer, sorts the indices on material
+// and generates the levels of detail and the occluders (if isOccluder)
+// only reads the triangulation and writes to outMesh and scratchArena, so that the meshes of multiple elements can be
+// processed on multiple threads
+static void processIfcMesh(
+    IfcGeom::Representation::Triangulation const& triangulation, IfcImportSettings const& settings, bool isOccluder,
+    ScratchArena* scratchArena, IfcMeshData* outMesh)
+{
+    ImportClock::time_point phaseStart = ImportClock::now();
+
+    // vertices
+    std::vector<double> const& verticesIn = triangulation.verts();
+    std::vector<double> const& normalsIn = triangulation.normals();
+    assert(!verticesIn.empty());
+    assert(verticesIn.size() % 3 == 0);
+    assert(normalsIn.size() == verticesIn.size());
+    size_t vertexCount = verticesIn.size() / 3;
+    outMesh->inputVertexCount = vertexCount;
+
+    // weld duplicate vertices, the tessellator outputs separate vertices for each triangle
+    // remap is the welded index of each input vertex, sourceVertices the input vertex of each welded vertex
+    std::span<uint32_t> remap;
+    if (settings.weldVertices)
+    {
+        remap = allocateScratchArray<uint32_t>(scratchArena, vertexCount);
+        outMesh->sourceVertices = allocateScratchArray<uint32_t>(scratchArena, vertexCount);
+        vertexCount = weldVertices(verticesIn, normalsIn, settings.weldTolerance, scratchArena, remap, outMesh->sourceVertices);
+        outMesh->sourceVertices = outMesh->sourceVertices.first(vertexCount);
+        outMesh->weldSeconds = secondsSince(phaseStart);
+        phaseStart = ImportClock::now();
+    }
+    outMesh->vertexCount = vertexCount;
+    auto getIndex = [&](int index) { return remap.empty() ? static_cast<uint32_t>(index) : remap[index]; };
+    auto getPosition = [&](size_t i) { return getIfcVertexPosition(verticesIn, getIfcSourceVertex(outMesh, i), settings.flipYAndZAxes); };
+    auto getNormal = [&](size_t i) { return getIfcVertexNormal(normalsIn, getIfcSourceVertex(outMesh, i), settings.flipYAndZAxes); };
+
+    glm::dvec3 min(std::numeric_limits<double>::max());
+    glm::dvec3 max(std::numeric_limits<double>::lowest());
+    for (size_t i = 0; i < vertexCount; i++)
+    {
+        min = glm::min(min, getPosition(i));
+        max = glm::max(max, getPosition(i));
+    }
+    glm::dvec3 center = (min + max) * 0.5;
+    glm::dvec3 extent = (max - min) * 0.5;
+    outMesh->boundsMin = glm::vec3(min);
+    outMesh->boundsMax = glm::vec3(max);
+
+    if (settings.quantizeVertices)
+    {
+        double largestExtent = std::max({extent.x, extent.y, extent.z});
+        largestExtent = largestExtent > 0.0 ? largestExtent : 1.0;
+        extent = glm::max(extent, glm::dvec3(largestExtent * ifcMinQuantizationExtent));
+
+        outMesh->quantizedPositions = allocateScratchArray<short4>(scratchArena, vertexCount);
+        for (size_t i = 0; i < vertexCount; i++)
+        {
+            glm::dvec3 position = (getPosition(i) - center) / extent;
+            outMesh->quantizedPositions[i] = short4{
+                quantizeSnorm16(static_cast<float>(position.x)),
+                quantizeSnorm16(static_cast<float>(position.y)),
+                quantizeSnorm16(static_cast<float>(position.z)),
+                0
+            };
+        }
+
+        // the normal matrix of the node transform contains the inverse of the dequantization scale,
+        // so the normals are stored multiplied by the scale
+        outMesh->octahedralNormals = allocateScratchArray<short2>(scratchArena, vertexCount);
+        for (size_t i = 0; i < vertexCount; i++)
         {
-            if (foundIndices.contains(index))
+            float3 normal = getNormal(i);
+            outMesh->octahedralNormals[i] = encodeOctahedral(float3{
+                normal.x * static_cast<float>(extent.x),
+                normal.y * static_cast<float>(extent.y),
+                normal.z * static_cast<float>(extent.z)
+            });
+        }
+        outMesh->dequantization = glm::translate(glm::mat4(1), glm::vec3(center)) * glm::scale(glm::mat4(1), glm::vec3(extent));
+        outMesh->boundsMin = glm::vec3(-1);
+        outMesh->boundsMax = glm::vec3(1);
+    }
+    else
+    {
+        outMesh->positions = allocateScratchArray<float3>(scratchArena, vertexCount);
+        outMesh->normals = allocateScratchArray<float3>(scratchArena, vertexCount);
+        for (size_t i = 0; i < vertexCount; i++)
+        {
+            glm::dvec3 position = getPosition(i);
+            outMesh->positions[i] = float3{static_cast<float>(position.x), static_cast<float>(position.y), static_cast<float>(position.z)};
+            outMesh->normals[i] = getNormal(i);
+        }
+    }
+    outMesh->center = center;
+    outMesh->extent = extent;
+
+    // indices, sorted on material so that the triangles of each material are a contiguous range
+    // material_ids contains the material of each triangle, as an index into materials(), -1 is no material
+    std::vector<int> const& indicesIn = triangulation.faces();
+    std::vector<int> const& materialIds = triangulation.material_ids();
+    size_t materialCount = triangulation.materials().size();
+    size_t indexCount = indicesIn.size();
+    assert(indexCount % 3 == 0);
+    size_t triangleCount = indexCount / 3;
+    assert(materialIds.empty() || materialIds.size() == triangleCount);
+
+    // bucket of each material, the last bucket is for triangles without material
+    size_t bucketCount = materialCount + 1;
+    auto getBucket = [&](size_t triangle) {
+        int id = materialIds.empty() ? -1 : materialIds[triangle];
+        return id < 0 || (size_t)id >= materialCount ? materialCount : (size_t)id;
+    };
+
+    // stable counting sort of the triangles on bucket
+    std::span<size_t> bucketOffsets = allocateScratchArray<size_t>(scratchArena, bucketCount + 1);
+    std::fill(bucketOffsets.begin(), bucketOffsets.end(), 0);
+    for (size_t i = 0; i < triangleCount; i++)
+    {
+        bucketOffsets[getBucket(i) + 1]++;
+    }
+    for (size_t i = 0; i < bucketCount; i++)
+    {
+        bucketOffsets[i + 1] += bucketOffsets[i];
+    }
+
+    outMesh->indices = allocateScratchArray<uint32_t>(scratchArena, indexCount);
+    {
+        std::span<size_t> cursors = allocateScratchArray<size_t>(scratchArena, bucketCount);
+        std::copy(bucketOffsets.begin(), bucketOffsets.end() - 1, cursors.begin());
+        for (size_t i = 0; i < triangleCount; i++)
+        {
+            uint32_t* triangle = &outMesh->indices[cursors[getBucket(i)]++ * 3];
+            if (settings.flipYAndZAxes)
             {
-                return false;
+                // invert winding order
+                triangle[0] = getIndex(indicesIn[i * 3 + 2]);
+                triangle[1] = getIndex(indicesIn[i * 3 + 1]);
+                triangle[2] = getIndex(indicesIn[i * 3 + 0]);
             }
             else
             {
-                foundIndices.emplace(index);
+                triangle[0] = getIndex(indicesIn[i * 3 + 0]);
+                triangle[1] = getIndex(indicesIn[i * 3 + 1]);
+                triangle[2] = getIndex(indicesIn[i * 3 + 2]);
             }
         }
-        currentIndex = index;
     }
 
-    return true;
+    // index range and material of each bucket that contains triangles
+    // the materials are added to the model on the import thread, as they are shared between elements
+    std::span<IndexRange> ranges = allocateScratchArray<IndexRange>(scratchArena, bucketCount);
+    std::span<size_t> rangeMaterials = allocateScratchArray<size_t>(scratchArena, bucketCount);
+    size_t rangeCount = 0;
+    for (size_t i = 0; i < bucketCount; i++)
+    {
+        size_t count = bucketOffsets[i + 1] - bucketOffsets[i];
+        if (count == 0)
+        {
+            continue;
+        }
+        ranges[rangeCount] = IndexRange{.offset = bucketOffsets[i] * 3, .count = count * 3};
+        rangeMaterials[rangeCount] = i < materialCount ? i : invalidIndex;
+        rangeCount++;
+    }
+    outMesh->ranges = ranges.first(rangeCount);
+    outMesh->rangeMaterials = rangeMaterials.first(rangeCount);
+    outMesh->convertSeconds = secondsSince(phaseStart);
+
+    // levels of detail, the indices of all levels are stored after each other in the same index buffer
+    // not generated when the primitive would be split, as the split primitives don't share an index buffer
+    outMesh->lodIndices = outMesh->indices;
+    outMesh->lodRanges = outMesh->ranges;
+    outMesh->lodCount = 1;
+    if (settings.lodSettings.levelCount > 1 && !(settings.splitLargePrimitives && vertexCount > maxUInt16IndexedVertexCount))
+    {
+        phaseStart = ImportClock::now();
+
+        // simplified relative to the center of the bounds, and before quantization
+        std::span<float3> lodPositions = allocateScratchArray<float3>(scratchArena, vertexCount);
+        std::span<float3> lodNormals = allocateScratchArray<float3>(scratchArena, vertexCount);
+        for (size_t i = 0; i < vertexCount; i++)
+        {
+            glm::dvec3 position = getPosition(i) - center;
+            lodPositions[i] = float3{static_cast<float>(position.x), static_cast<float>(position.y), static_cast<float>(position.z)};
+            lodNormals[i] = getNormal(i);
+        }
+
+        size_t levelCount = settings.lodSettings.levelCount;
+        std::span<uint32_t> lodIndices = allocateScratchArray<uint32_t>(scratchArena, indexCount * levelCount);
+        std::span<IndexRange> lodRanges = allocateScratchArray<IndexRange>(scratchArena, outMesh->ranges.size() * levelCount);
+        outMesh->lodErrors = allocateScratchArray<float>(scratchArena, levelCount);
+        outMesh->lodCount = generateLods(lodPositions, lodNormals, outMesh->indices, outMesh->ranges, settings.lodSettings, lodIndices, lodRanges, outMesh->lodErrors);
+        outMesh->lodRanges = lodRanges.first(outMesh->ranges.size() * outMesh->lodCount);
+        outMesh->lodIndices = lodIndices.first(outMesh->lodRanges.back().offset + outMesh->lodRanges.back().count);
+        outMesh->simplifySeconds = secondsSince(phaseStart);
+    }
+
+    // occluders, generated relative to the center of the bounds and stored in the same space as the vertices
+    if (isOccluder)
+    {
+        phaseStart = ImportClock::now();
+        std::span<glm::vec3> occluderPositionsIn = allocateScratchArray<glm::vec3>(scratchArena, vertexCount);
+        for (size_t i = 0; i < vertexCount; i++)
+        {
+            occluderPositionsIn[i] = glm::vec3(getPosition(i) - center);
+        }
+        std::vector<OccluderBox> boxes;
+        generateBoxOccluders(occluderPositionsIn, outMesh->indices, settings.occluderSettings, scratchArena, &boxes);
+        for (OccluderBox const& box: boxes)
+        {
+            appendOccluderBox(box, &outMesh->occluderPositions, &outMesh->occluderIndices);
+        }
+        for (glm::vec3& position: outMesh->occluderPositions)
+        {
+            position = glm::vec3(settings.quantizeVertices ? glm::dvec3(position) / extent : glm::dvec3(position) + center);
+        }
+        outMesh->occluderSeconds = secondsSince(phaseStart);
+    }
 }
 
-bool importIfc(id <MTLDevice> device, std::filesystem::path const& path, model::Model* outModel, IfcImportSettings settings)
+// element taken from the iterator, its mesh is processed on a worker thread and then uploaded on the import thread
+struct IfcPendingElement
 {
-    assert(exists(path));
-    assert(outModel != nullptr);
+    IfcImportedElement element; // transform does not include the dequantization of the mesh yet
+    std::shared_ptr<IfcGeom::Representation::Triangulation> triangulation; // keeps the geometry alive after the iterator moves on
+    bool isOccluder = false; // the occluders are generated with the mesh
+    IfcMeshData mesh; // only when element.hasMesh
+};
+
+// elements that are taken from the iterator and processed together
+struct IfcElementBatch
+{
+    std::vector<IfcPendingElement> elements;
+    std::vector<ScratchArena> scratchArenas; // one per worker thread
+    std::atomic<size_t> nextElement = 0; // next element to be processed by a worker
+};
+
+// moves the next elements of the iterator to the batch, until the batch is full or the iterator has no more elements
+// the batch is sorted on element id and the geometry indices are assigned in that order, so that the order in which the
+// elements are added doesn't depend on which of the tessellation threads finishes first within a batch
+// returns whether the iterator has more elements
+[[nodiscard]] static bool takeIfcElementBatch(
+    IfcGeom::Iterator* iterator, IfcImportSettings const& settings, IfcElementBatch* outBatch,
+    std::unordered_map<std::string, size_t>* geometryIndices, size_t* geometryCount, ImportStatistics* statistics)
+{
+    outBatch->elements.clear();
+    bool hasElement = true;
+    while (hasElement && outBatch->elements.size() < ifcElementBatchSize)
+    {
+        IfcGeom::Element* element = iterator->get();
+        auto const* triangulationElement = dynamic_cast<IfcGeom::TriangulationElement const*>(element);
+
+        IfcPendingElement* pending = &outBatch->elements.emplace_back();
+        pending->element.id = element->id();
+        pending->element.globalId = element->guid();
+        pending->element.type = element->type();
+        pending->element.name = element->name();
+        pending->element.transform = getIfcElementTransform(triangulationElement, settings.flipYAndZAxes);
+        pending->triangulation = triangulationElement->geometry_pointer();
+        pending->isOccluder = settings.generateOccluders && isIfcOccluderElement(element);
+
+        ImportClock::time_point phaseStart = ImportClock::now();
+        hasElement = iterator->next();
+        addImportPhaseTime(statistics, "tessellate", phaseStart);
+    }
+
+    std::sort(outBatch->elements.begin(), outBatch->elements.end(), [](IfcPendingElement const& lhs, IfcPendingElement const& rhs) {
+        return lhs.element.id < rhs.element.id;
+    });
+    for (IfcPendingElement& pending: outBatch->elements)
+    {
+        // elements with the same representation (triangulation id) only differ in their transform
+        if (settings.instanceSharedRepresentations)
+        {
+            auto [it, inserted] = geometryIndices->try_emplace(pending.triangulation->id(), *geometryCount);
+            pending.element.geometryIndex = it->second;
+            pending.element.hasMesh = inserted;
+        }
+        else
+        {
+            pending.element.geometryIndex = *geometryCount;
+            pending.element.hasMesh = true;
+        }
+        if (pending.element.hasMesh)
+        {
+            (*geometryCount)++;
+        }
+    }
+    return hasElement;
+}
+
+// processes the meshes of the batch on the worker threads, waitForJobs should be called before the batch is used
+static void submitIfcElementBatch(ThreadPool* pool, IfcImportSettings const* settings, IfcElementBatch* batch)
+{
+    batch->nextElement = 0;
+    for (ScratchArena& scratchArena: batch->scratchArenas)
+    {
+        // one job per arena that takes elements until all have been taken, so that each arena is used by a single thread
+        submitJob(pool, [settings, batch, scratchArena = &scratchArena]() {
+            for (size_t i = batch->nextElement++; i < batch->elements.size(); i = batch->nextElement++)
+            {
+                IfcPendingElement* pending = &batch->elements[i];
+                if (pending->element.hasMesh)
+                {
+                    processIfcMesh(*pending->triangulation, *settings, pending->isOccluder, scratchArena, &pending->mesh);
+                }
+            }
+        });
+    }
+}
 
+// frees the meshes of the batch after they have been uploaded
+static void resetIfcElementBatch(IfcElementBatch* batch, ScratchMemoryTracker* scratch)
+{
+    // the arenas of all workers were in use at the same time
+    for (ScratchArena const& scratchArena: batch->scratchArenas)
+    {
+        addScratchMemory(scratch, scratchArena.usedSize);
+    }
+    for (ScratchArena& scratchArena: batch->scratchArenas)
+    {
+        removeScratchMemory(scratch, scratchArena.usedSize);
+        resetScratchArena(&scratchArena);
+    }
+    batch->elements.clear();
+}
+
+// tessellates all elements of the file and reports them to the sink in batches, sorted on element id within each batch
+// IfcOpenShell tessellates the elements on its own threads, the meshes are then welded, converted, simplified and turned
+// into occluders on a thread pool while the next batch is taken from the iterator, and uploaded on the import thread while
+// the next batch is processed
+// the vertex and index data of all elements is allocated from outVertexArena and outIndexArena, which are created here
+// returns false when the file can't be parsed or the import was cancelled
+static bool importIfcWithSink(
+    id <MTLDevice> device, std::filesystem::path const& path, IfcImportSettings const& settings, IfcImportSink* sink,
+    BufferArena* outVertexArena, BufferArena* outIndexArena, ImportStatistics* statistics, ScratchMemoryTracker* scratch)
+{
+    // temporaries of the upload of each element are allocated from the same memory, which is reset after the element is imported
+    ScratchArena scratchArena{};
+    createScratchArena(scratchBlockSize, &scratchArena);
+
+    ImportClock::time_point phaseStart = ImportClock::now();
     IfcParse::IfcFile ifcFile(path);
     if (!ifcFile.good())
     {
@@ -55,178 +547,735 @@ bool importIfc(id <MTLDevice> device, std::filesystem::path const& path, model::
             default:break;
             //@formatter:on
         }
+        destroyScratchArena(&scratchArena);
+        return false;
     }
-    assert(ifcFile.good() && "parsing failed");
+    addImportPhaseTime(statistics, "parse", phaseStart);
+    statistics->bytesRead += file_size(path);
 
     ifcopenshell::geometry::Settings geometrySettings;
     geometrySettings.get<ifcopenshell::geometry::UseWorldCoords>().value = false;
     geometrySettings.get<ifcopenshell::geometry::WeldVertices>().value = false;
     geometrySettings.get<ifcopenshell::geometry::ApplyDefaultMaterials>().value = false;
     geometrySettings.get<ifcopenshell::geometry::IteratorOutput>().value = ifcopenshell::geometry::IteratorOutputOptions::TRIANGULATED; // NATIVE = BRep
-    IfcGeom::Iterator iterator{geometrySettings, &ifcFile};
-    bool result = iterator.initialize();
-    assert(result && "initializing iterator failed");
-
-    do
+    // with multiple threads, the iterator tessellates elements on its own worker threads while the elements that are done
+    // are processed and uploaded. "tessellate" is then the time spent waiting for the next element.
+    // with a single thread, the iterator tessellates the elements one by one, initialize tessellates the first element
+    size_t threadCount = settings.tessellationThreadCount == 0 ? defaultThreadCount() : settings.tessellationThreadCount;
+    size_t processThreadCount = settings.processThreadCount == 0 ? std::max<size_t>(threadCount / 2, 1) : settings.processThreadCount;
+    phaseStart = ImportClock::now();
+    std::vector<IfcGeom::filter_t> filters;
+    if (!isIfcImportFilterEmpty(settings.filter))
     {
-        IfcGeom::Element* element = iterator.get();
-        auto const* triangulationElement = dynamic_cast<IfcGeom::TriangulationElement const*>(element);
-        IfcGeom::Representation::Triangulation const& triangulation = triangulationElement->geometry();
+        filters.emplace_back(createIfcElementFilter(&ifcFile, settings.filter, settings.flipYAndZAxes));
+    }
+    IfcGeom::Iterator iterator{geometrySettings, &ifcFile, filters, (int)threadCount};
+    // returns false when there are no elements to import, e.g. when the filter excludes all elements
+    bool hasElement = iterator.initialize();
+    addImportPhaseTime(statistics, "tessellate", phaseStart);
+    if (!hasElement)
+    {
+        std::cout << "ifc: no elements to import in " << path.filename() << std::endl;
+    }
 
-        //triangulation.materials()
+    MeshOptimizationStatistics optimizationStatistics{};
 
-        size_t meshIndex = invalidIndex;
+    // all elements are sub-allocated from a few large buffers, instead of two buffers per element
+    createBufferArena(device, arenaBlockSize, outVertexArena);
+    createBufferArena(device, arenaBlockSize, outIndexArena);
 
-        // create mesh
+    // geometry index per representation (triangulation id)
+    std::unordered_map<std::string, size_t> geometryIndices;
+    size_t geometryCount = 0;
+
+    // transform from the quantized vertex positions of each geometry to its positions, identity if not quantized
+    std::vector<glm::mat4> geometryDequantizations;
+
+    // materials in the order they were first encountered
+    std::vector<model::Material> materials;
+    std::unordered_map<std::string, size_t> materialIndices;
+
+    // vertex counts of the meshes before and after welding
+    size_t weldVertexCountBefore = 0;
+    size_t weldVertexCountAfter = 0;
+
+    // one batch is processed by the pool while the other is taken from the iterator or uploaded
+    ThreadPool pool{};
+    startThreadPool(&pool, processThreadCount);
+    std::array<IfcElementBatch, 2> batches;
+    for (IfcElementBatch& batch: batches)
+    {
+        batch.scratchArenas.resize(processThreadCount);
+        for (ScratchArena& batchScratchArena: batch.scratchArenas)
         {
-            model::Mesh* outMesh = &outModel->meshes.emplace_back();
-            meshIndex = outModel->meshes.size() - 1;
+            createScratchArena(scratchBlockSize, &batchScratchArena);
+        }
+    }
+    IfcElementBatch* batch = &batches[0];
+    IfcElementBatch* nextBatch = &batches[1];
+    if (hasElement)
+    {
+        hasElement = takeIfcElementBatch(&iterator, settings, batch, &geometryIndices, &geometryCount, statistics);
+        submitIfcElementBatch(&pool, &settings, batch);
+    }
 
-            // positions
-            std::vector<double> const& verticesIn = triangulation.verts();
-            assert(!verticesIn.empty());
-            assert(verticesIn.size() % 3 == 0);
-            size_t vertexCount = verticesIn.size() / 3;
-            std::vector<float3> positionsOut(vertexCount);
-            for (size_t i = 0; i < vertexCount; i++)
+    std::vector<PrimitiveDeinterleaved> chunks; // reused for each element
+    bool cancelled = false;
+    while (!batch->elements.empty() && !cancelled)
+    {
+        if (hasElement)
+        {
+            hasElement = takeIfcElementBatch(&iterator, settings, nextBatch, &geometryIndices, &geometryCount, statistics);
+        }
+        phaseStart = ImportClock::now();
+        waitForJobs(&pool);
+        addImportPhaseTime(statistics, "process_wait", phaseStart);
+        if (!nextBatch->elements.empty())
+        {
+            submitIfcElementBatch(&pool, &settings, nextBatch);
+        }
+
+        for (IfcPendingElement& pending: batch->elements)
+        {
+            IfcImportedElement outElement = std::move(pending.element);
+            IfcGeom::Representation::Triangulation const& triangulation = *pending.triangulation;
+
+            // create mesh
+            if (outElement.hasMesh)
             {
-                positionsOut[i] = float3{
-                    static_cast<float>(verticesIn[i * 3]),
-                    static_cast<float>(verticesIn[i * 3 + (settings.flipYAndZAxes ? 2 : 1)]),
-                    static_cast<float>(verticesIn[i * 3 + (settings.flipYAndZAxes ? 1 : 2)])
+                statistics->meshCount++;
+                IfcMeshData const* mesh = &pending.mesh;
+                model::Mesh* outMesh = &outElement.mesh;
+                size_t firstNewMaterial = materials.size();
+                outMesh->boundsMin = mesh->boundsMin;
+                outMesh->boundsMax = mesh->boundsMax;
+                geometryDequantizations.emplace_back(mesh->dequantization);
+                std::span<IndexRange> ranges = mesh->ranges;
+
+                if (settings.weldVertices)
+                {
+                    weldVertexCountBefore += mesh->inputVertexCount;
+                    weldVertexCountAfter += mesh->vertexCount;
+                    addImportPhaseSeconds(statistics, "weld", mesh->weldSeconds);
+                }
+                addImportPhaseSeconds(statistics, "convert", mesh->convertSeconds);
+                if (settings.lodSettings.levelCount > 1)
+                {
+                    addImportPhaseSeconds(statistics, "simplify", mesh->simplifySeconds);
+                }
+                if (pending.isOccluder)
+                {
+                    addImportPhaseSeconds(statistics, "occluders", mesh->occluderSeconds);
+                    outMesh->occluderPositions = std::move(pending.mesh.occluderPositions);
+                    outMesh->occluderIndices = std::move(pending.mesh.occluderIndices);
+                }
+
+                // materials are shared between elements, so they are added here instead of on the worker threads
+                std::span<size_t> rangeMaterials = allocateScratchArray<size_t>(&scratchArena, ranges.size());
+                for (size_t i = 0; i < ranges.size(); i++)
+                {
+                    size_t material = mesh->rangeMaterials[i];
+                    rangeMaterials[i] = material == invalidIndex ? invalidIndex : getIfcMaterial(triangulation.materials()[material], &materials, &materialIndices);
+                }
+
+                std::span<uint32_t> lodIndices = mesh->lodIndices;
+                std::span<IndexRange> lodRanges = mesh->lodRanges;
+                std::span<float> lodErrors = mesh->lodErrors;
+                size_t lodCount = mesh->lodCount;
+
+                // create primitive, the primitives of all materials share its vertex buffer
+                phaseStart = ImportClock::now();
+                PrimitiveDeinterleavedDescriptor descriptor{
+                    .positions = mesh->positions,
+                    .quantizedPositions = mesh->quantizedPositions,
+                    .normals = mesh->normals,
+                    .octahedralNormals = mesh->octahedralNormals,
+                    .indices = lodIndices,
+                    .primitiveType = MTLPrimitiveTypeTriangle,
+                    .vertexArena = outVertexArena,
+                    .indexArena = outIndexArena
                 };
+                PrimitiveDeinterleaved primitive = createPrimitiveDeinterleaved(device, &descriptor);
+                addImportPhaseTime(statistics, "upload", phaseStart);
+
+                if (settings.optimizeMeshes)
+                {
+                    phaseStart = ImportClock::now();
+                    optimizePrimitiveRanges(&primitive, lodRanges, &scratchArena, &optimizationStatistics);
+                    addImportPhaseTime(statistics, "optimize", phaseStart);
+                }
+
+                // one primitive per material, that only differ in their index range
+                size_t indexSize = primitive.indexType == MTLIndexTypeUInt16 ? sizeof(uint16_t) : sizeof(uint32_t);
+                bool sharedVertexBufferUsed = false;
+                for (size_t i = 0; i < ranges.size(); i++)
+                {
+                    PrimitiveDeinterleaved materialPrimitive = primitive;
+                    materialPrimitive.indexBufferOffset += ranges[i].offset * indexSize;
+                    materialPrimitive.indexCount = ranges[i].count;
+
+                    // the arena space of the original primitive is not reclaimed when it is split
+                    phaseStart = ImportClock::now();
+                    chunks.clear();
+                    if (settings.splitLargePrimitives &&
+                        splitPrimitiveForUInt16Indices(device, outVertexArena, outIndexArena, &materialPrimitive, &chunks))
+                    {
+                        for (PrimitiveDeinterleaved const& chunk: chunks)
+                        {
+                            for (VertexAttribute const& attribute: chunk.attributes)
+                            {
+                                statistics->vertexBytes += attribute.size;
+                            }
+                        }
+                    }
+                    else
+                    {
+                        chunks.emplace_back(materialPrimitive);
+                        sharedVertexBufferUsed = true;
+                    }
+                    addImportPhaseTime(statistics, "split", phaseStart);
+
+                    for (PrimitiveDeinterleaved& chunk: chunks)
+                    {
+                        statistics->indexBytes += chunk.indexCount * (chunk.indexType == MTLIndexTypeUInt16 ? 2 : 4);
+                        statistics->primitiveCount++;
+                        outMesh->primitives.emplace_back(model::Primitive{
+                            .primitive = chunk,
+                            .materialIndex = rangeMaterials[i]
+                        });
+                    }
+                }
+                if (lodCount > 1)
+                {
+                    assert(outMesh->primitives.size() == ranges.size() && "primitives with levels of detail should not be split");
+                    for (size_t level = 0; level < lodCount; level++)
+                    {
+                        model::MeshLod* lod = &outMesh->lods.emplace_back();
+                        lod->error = lodErrors[level];
+                        for (size_t i = 0; i < ranges.size(); i++)
+                        {
+                            IndexRange range = lodRanges[level * ranges.size() + i];
+                            lod->primitiveRanges.emplace_back(IndexRange{.offset = range.offset - ranges[i].offset, .count = range.count});
+                            if (level > 0)
+                            {
+                                statistics->indexBytes += range.count * indexSize;
+                            }
+                        }
+                    }
+                }
+                if (sharedVertexBufferUsed)
+                {
+                    for (VertexAttribute const& attribute: primitive.attributes)
+                    {
+                        statistics->vertexBytes += attribute.size;
+                    }
+                }
+
+                // materials that were first referenced by this mesh
+                outElement.materials.assign(materials.begin() + (ptrdiff_t)firstNewMaterial, materials.end());
             }
+            outElement.transform = outElement.transform * geometryDequantizations[outElement.geometryIndex];
 
-            // normals
-            std::vector<double> const& normalsIn = triangulation.normals();
-            assert(normalsIn.size() == verticesIn.size());
-            std::vector<float3> normalsOut(vertexCount);
+            addScratchArenaUsage(scratch, &scratchArena);
+            resetScratchArena(&scratchArena);
 
-            for (size_t i = 0; i < vertexCount; i++)
+            if (settings.verbose)
             {
-                normalsOut[i] = float3{
-                    static_cast<float>(normalsIn[i * 3]),
-                    static_cast<float>(normalsIn[i * 3 + (settings.flipYAndZAxes ? 2 : 1)]),
-                    static_cast<float>(normalsIn[i * 3 + (settings.flipYAndZAxes ? 1 : 2)])
-                };
+                std::cout << "ifc: imported " << (outElement.hasMesh ? "triangulation" : "instance") << " for " << outElement.name << std::endl;
             }
 
-            // indices
-            std::vector<int> const& indicesIn = triangulation.faces();
-            size_t indexCount = indicesIn.size();
-            assert(indexCount % 3 == 0);
-            std::vector<uint32_t> indicesOut(indexCount);
-            if (settings.flipYAndZAxes)
+            sink->onElement(std::move(outElement));
+
+            if (sink->cancelled && *sink->cancelled)
             {
-                // invert winding order
-                size_t triangleCount = indexCount / 3;
-                for (size_t i = 0; i < triangleCount; i++)
-                {
-                    indicesOut[i * 3 + 0] = indicesIn[i * 3 + 2];
-                    indicesOut[i * 3 + 1] = indicesIn[i * 3 + 1];
-                    indicesOut[i * 3 + 2] = indicesIn[i * 3 + 0];
-                }
+                cancelled = true;
+                break;
             }
-            else
+        }
+
+        resetIfcElementBatch(batch, scratch);
+        std::swap(batch, nextBatch);
+    }
+
+    // waits for the batch that is still being processed when the import was cancelled
+    stopThreadPool(&pool);
+    for (IfcElementBatch& batchToDestroy: batches)
+    {
+        for (ScratchArena& batchScratchArena: batchToDestroy.scratchArenas)
+        {
+            addScratchArenaStatistics(statistics, &batchScratchArena);
+            destroyScratchArena(&batchScratchArena);
+        }
+    }
+
+    if (settings.weldVertices && !cancelled)
+    {
+        double reduction = weldVertexCountBefore == 0 ? 0.0 : 100.0 * (1.0 - (double)weldVertexCountAfter / (double)weldVertexCountBefore);
+        std::cout << fmt::format("ifc: welded vertices of {}: {} -> {} ({:.1f}% fewer)",
+                                 path.filename().string(), weldVertexCountBefore, weldVertexCountAfter, reduction) << std::endl;
+    }
+
+    if (settings.optimizeMeshes && !cancelled)
+    {
+        std::cout << "ifc: optimized meshes of " << path.filename() << ": " << meshOptimizationStatisticsToString(&optimizationStatistics) << std::endl;
+    }
+
+    addScratchArenaStatistics(statistics, &scratchArena);
+    destroyScratchArena(&scratchArena);
+    return !cancelled;
+}
+
+// adds a node for each element, sorted on id so that the model is the same for any thread count
+// meshes are added in the order they are first referenced, and the materials in the order they are first referenced by the meshes
+// the metadata of each node is added to outIndex
+static void addIfcElements(
+    std::vector<IfcElementInstance>* elements, std::vector<model::Mesh>* geometries, std::vector<model::Material> const& materials,
+    model::Model* outModel, IfcElementIndex* outIndex)
+{
+    std::sort(elements->begin(), elements->end(), [](IfcElementInstance const& lhs, IfcElementInstance const& rhs) {
+        return lhs.id < rhs.id;
+    });
+    std::vector<size_t> meshIndices(geometries->size(), invalidIndex);
+    std::vector<size_t> materialRemap(materials.size(), invalidIndex);
+    for (IfcElementInstance const& elementInstance: *elements)
+    {
+        size_t* meshIndex = &meshIndices[elementInstance.geometryIndex];
+        if (*meshIndex == invalidIndex)
+        {
+            model::Mesh* mesh = &outModel->meshes.emplace_back(std::move((*geometries)[elementInstance.geometryIndex]));
+            *meshIndex = outModel->meshes.size() - 1;
+
+            for (model::Primitive& primitive: mesh->primitives)
             {
-                for (size_t i = 0; i < indexCount; i++)
+                if (primitive.materialIndex == invalidIndex)
                 {
-                    indicesOut[i] = static_cast<uint32_t>(indicesIn[i]);
+                    continue;
                 }
+                size_t* materialIndex = &materialRemap[primitive.materialIndex];
+                if (*materialIndex == invalidIndex)
+                {
+                    outModel->materials.emplace_back(materials[primitive.materialIndex]);
+                    *materialIndex = outModel->materials.size() - 1;
+                }
+                primitive.materialIndex = *materialIndex;
             }
+        }
+        outModel->nodes.emplace_back(model::Node{
+            .meshIndex = *meshIndex,
+            .localTransform = elementInstance.transform
+        });
+        addIfcElementInfo(outIndex, outModel->nodes.size() - 1, elementInstance.globalId, elementInstance.type, elementInstance.name);
+    }
+}
+
+// collects the elements of an import, so that they can be added to a model with addIfcElements
+struct IfcElementCollector
+{
+    std::vector<IfcElementInstance> elements;
+    std::vector<model::Mesh> geometries; // per geometry index
+    std::vector<model::Material> materials; // in the order they were first encountered
+};
+
+static void collectIfcElement(IfcElementCollector* collector, IfcImportedElement const& element)
+{
+    if (element.hasMesh)
+    {
+        assert(element.geometryIndex == collector->geometries.size());
+        collector->geometries.emplace_back(element.mesh);
+    }
+    collector->materials.insert(collector->materials.end(), element.materials.begin(), element.materials.end());
+    collector->elements.emplace_back(IfcElementInstance{
+        .id = element.id,
+        .geometryIndex = element.geometryIndex,
+        .transform = element.transform,
+        .globalId = element.globalId,
+        .type = element.type,
+        .name = element.name
+    });
+}
+
+// creates a scene with a root node that has all nodes of the model as children
+// this makes iterating easier using a tree-traversal algorithm
+static void addIfcScene(model::Model* outModel)
+{
+    std::vector<size_t> nodeIndices(outModel->nodes.size());
+    std::iota(nodeIndices.begin(), nodeIndices.end(), 0);
+
+    outModel->nodes.emplace_back(model::Node{
+        .meshIndex = invalidIndex,
+        .localTransform = glm::mat4(1),
+        .childNodes = nodeIndices
+    });
+    outModel->scenes.emplace_back(model::Scene{
+        .rootNode = outModel->nodes.size() - 1
+    });
+}
+
+// adds the uploaded bytes and counts of a model that was read from the cache
+static void addIfcCachedModelStatistics(ImportStatistics* statistics, model::Model const* model)
+{
+    statistics->vertexBytes += model->vertexArena.allocatedSize;
+    statistics->indexBytes += model->indexArena.allocatedSize;
+    statistics->meshCount += model->meshes.size();
+    for (model::Mesh const& mesh: model->meshes)
+    {
+        statistics->primitiveCount += mesh.primitives.size();
+    }
+}
 
-            // split based on materials
+bool importIfc(
+    id <MTLDevice> device, std::filesystem::path const& path, model::Model* outModel, IfcImportSettings settings,
+    ImportStatistics* outStatistics, IfcElementIndex* outIndex)
+{
+    assert(exists(path));
+    assert(outModel != nullptr);
+
+    // the index is always created, as it is stored in the cache
+    IfcElementIndex index{};
+    if (outIndex == nullptr)
+    {
+        outIndex = &index;
+    }
+
+    ImportStatistics statistics{};
+    ScratchMemoryTracker scratch{};
+    ImportClock::time_point importStart = ImportClock::now();
+
+    // a cache hit skips parsing and tessellation entirely
+    ImportClock::time_point phaseStart = ImportClock::now();
+    uint64_t cacheKey = 0;
+    bool useCache = !settings.cacheDirectory.empty() && getIfcCacheKey(path, settings, &cacheKey);
+    if (useCache)
+    {
+        std::filesystem::path cachePath = getIfcCachePath(settings.cacheDirectory, cacheKey);
+        size_t bytesRead = 0;
+        if (readIfcCache(device, cachePath, cacheKey, outModel, outIndex, &bytesRead))
+        {
+            addImportPhaseTime(&statistics, "cache_read", phaseStart);
+            statistics.bytesRead += file_size(path) + bytesRead; // the ifc file is read for the cache key
+            addIfcCachedModelStatistics(&statistics, outModel);
+            addIfcScene(outModel);
+            std::cout << "ifc: read " << path.filename() << " from cache " << cachePath << std::endl;
+
+            statistics.totalSeconds = secondsSince(importStart);
+            if (outStatistics != nullptr)
             {
-                std::vector<size_t> materialIndices(triangulation.material_ids().size());
-                for (int i = 0; i < materialIndices.size(); i++)
-                {
-                    materialIndices[i] = triangulation.material_ids()[i];
-                }
-                assert(grouped(&materialIndices));
+                *outStatistics = std::move(statistics);
+            }
+            return true;
+        }
+        addImportPhaseTime(&statistics, "cache_key", phaseStart);
+    }
 
-                // we want to go from:
-                // vertices [x0, y0, z0, x1, y1, z1, x2, y2, z2]
-                // indices [v0_0, v0_1, v0_2, v1_0, v1_1, v1_2]
+    // elements are returned in the order they finish tessellating, which depends on the thread count and timing
+    IfcElementCollector collector{};
+    IfcImportSink sink{
+        .onElement = [&collector](IfcImportedElement&& element) { collectIfcElement(&collector, element); }
+    };
+    if (!importIfcWithSink(device, path, settings, &sink, &outModel->vertexArena, &outModel->indexArena, &statistics, &scratch))
+    {
+        return false;
+    }
 
-                // to vertices and indices that are split based on materials
-                // material_ids [f0, f1, f2, f3]
+    addIfcElements(&collector.elements, &collector.geometries, collector.materials, outModel, outIndex);
+    if (settings.verbose)
+    {
+        std::cout << "ifc: " << collector.elements.size() << " elements share " << collector.geometries.size() << " meshes in " << path.filename() << std::endl;
+    }
+    addIfcScene(outModel);
 
-                // having the same vertex buffer would be easier, but for now let's keep it separate
+    if (useCache)
+    {
+        phaseStart = ImportClock::now();
+        if (!writeIfcCache(getIfcCachePath(settings.cacheDirectory, cacheKey), cacheKey, outModel, outIndex))
+        {
+            std::cout << "ifc: failed to write cache for " << path.filename() << std::endl;
+        }
+        addImportPhaseTime(&statistics, "cache_write", phaseStart);
+    }
 
+    statistics.totalSeconds = secondsSince(importStart);
+    statistics.peakScratchBytes = scratch.peak;
+    if (outStatistics != nullptr)
+    {
+        *outStatistics = std::move(statistics);
+    }
+    return true;
+}
+
+bool importIfcSubset(
+    id <MTLDevice> device, std::filesystem::path const& path, model::Model* model, IfcImportSettings settings,
+    ImportStatistics* outStatistics, IfcElementIndex* index)
+{
+    assert(model != nullptr);
+    assert(!model->scenes.empty() && "the model should have been imported with importIfc");
+
+    // the subset is imported as a separate model (which also uses the cache), and then merged into the model
+    model::Model subset{};
+    IfcElementIndex subsetIndex{};
+    if (!importIfc(device, path, &subset, std::move(settings), outStatistics, &subsetIndex))
+    {
+        return false;
+    }
+
+    size_t firstMesh = model->meshes.size();
+    size_t firstMaterial = model->materials.size();
+    model->materials.insert(model->materials.end(), subset.materials.begin(), subset.materials.end());
+    for (model::Mesh& mesh: subset.meshes)
+    {
+        for (model::Primitive& primitive: mesh.primitives)
+        {
+            if (primitive.materialIndex != invalidIndex)
+            {
+                primitive.materialIndex += firstMaterial;
             }
+        }
+        model->meshes.emplace_back(std::move(mesh));
+    }
 
-            // create primitive
-            // todo: split primitives on material
-            PrimitiveDeinterleavedDescriptor descriptor{
-                .positions = &positionsOut,
-                .normals = &normalsOut,
-                .indices = &indicesOut,
-                .primitiveType = MTLPrimitiveTypeTriangle,
-            };
-            outMesh->primitives.emplace_back(model::Primitive{
-                .primitive = createPrimitiveDeinterleaved(device, &descriptor),
-                .materialIndex = invalidIndex
-            });
+    // all nodes of the subset except for its root node, which has all other nodes as children
+    size_t rootNode = model->scenes[0].rootNode;
+    size_t subsetRootNode = subset.scenes[0].rootNode;
+    for (size_t i = 0; i < subset.nodes.size(); i++)
+    {
+        if (i == subsetRootNode)
+        {
+            continue;
         }
+        model::Node* node = &subset.nodes[i];
+        assert(node->childNodes.empty());
+        model->nodes.emplace_back(model::Node{
+            .meshIndex = node->meshIndex == invalidIndex ? invalidIndex : firstMesh + node->meshIndex,
+            .localTransform = node->localTransform
+        });
+        model->nodes[rootNode].childNodes.emplace_back(model->nodes.size() - 1);
 
-        // create node
+        IfcElementInfo const* info = getIfcElementInfo(&subsetIndex, i);
+        if (index != nullptr && info != nullptr)
         {
-            model::Node* outNode = &outModel->nodes.emplace_back();
+            addIfcElementInfo(index, model->nodes.size() - 1,
+                              getString(&subsetIndex.strings, info->globalId),
+                              getString(&subsetIndex.strings, info->type),
+                              getString(&subsetIndex.strings, info->name));
+        }
+    }
 
-            // get transform
-            ifcopenshell::geometry::taxonomy::matrix4::ptr const& transform = triangulationElement->transformation().data();
-            Eigen::Matrix<double, 4, 4>& m = transform->components();
-            glm::mat4 outMatrix;
-            for (int i = 0; i < 4 * 4; i++)
+    appendBufferArena(&model->vertexArena, &subset.vertexArena);
+    appendBufferArena(&model->indexArena, &subset.indexArena);
+    return true;
+}
+
+// pushes the element to the queue of the import, waits while the queue is full
+// returns false if the import was cancelled while waiting
+static bool pushIfcImportedElement(IfcImport* import, IfcImportedElement* element)
+{
+    while (!tryPushSpscQueue(&import->queue, element))
+    {
+        if (import->cancelled)
+        {
+            return false;
+        }
+        // the consumer drains the queue once per frame
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    return true;
+}
+
+// streams the elements of a cached model in node order, so that a cache hit is displayed the same way as a tessellated file
+// the meshes of the cached model are in the order they are first referenced by the nodes, and the materials in the order
+// they are first referenced by the meshes, so appending them in that order results in the same indices
+static bool streamIfcCachedModel(IfcImport* import, model::Model* cachedModel, IfcElementIndex const* cachedIndex)
+{
+    size_t meshCount = 0;
+    size_t materialCount = 0;
+    for (size_t i = 0; i < cachedModel->nodes.size(); i++)
+    {
+        model::Node const& node = cachedModel->nodes[i];
+        IfcImportedElement element{};
+        element.geometryIndex = node.meshIndex;
+        element.transform = node.localTransform;
+        if (IfcElementInfo const* info = getIfcElementInfo(cachedIndex, i))
+        {
+            element.globalId = getString(&cachedIndex->strings, info->globalId);
+            element.type = getString(&cachedIndex->strings, info->type);
+            element.name = getString(&cachedIndex->strings, info->name);
+        }
+        if (node.meshIndex == meshCount)
+        {
+            meshCount++;
+            element.hasMesh = true;
+            element.mesh = std::move(cachedModel->meshes[node.meshIndex]);
+            size_t endMaterial = materialCount;
+            for (model::Primitive const& primitive: element.mesh.primitives)
             {
-                auto a = static_cast<float>(m(i));
-                outMatrix[i / 4][i % 4] = a;
+                if (primitive.materialIndex != invalidIndex)
+                {
+                    endMaterial = std::max(endMaterial, primitive.materialIndex + 1);
+                }
             }
+            element.materials.assign(
+                cachedModel->materials.begin() + (ptrdiff_t)materialCount,
+                cachedModel->materials.begin() + (ptrdiff_t)endMaterial);
+            materialCount = endMaterial;
+        }
+        if (!pushIfcImportedElement(import, &element))
+        {
+            return false;
+        }
+    }
+    return true;
+}
 
-            if (settings.flipYAndZAxes)
+void startIfcImport(id <MTLDevice> device, std::filesystem::path const& path, IfcImportSettings settings, IfcImport* outImport)
+{
+    assert(exists(path));
+    assert(outImport != nullptr);
+    assert(!outImport->thread.joinable() && "import already started");
+
+    outImport->path = path;
+    outImport->cancelled = false;
+    outImport->finished = false;
+    outImport->succeeded = false;
+    outImport->appliedBuffers = false;
+    outImport->appliedElementCount = 0;
+    outImport->reportedFailure = false;
+    outImport->elementIndex = {};
+    createSpscQueue(ifcImportQueueCapacity, &outImport->queue);
+
+    outImport->thread = std::thread([device, path, settings, outImport]() {
+        @autoreleasepool
+        {
+            ImportStatistics statistics{};
+            ScratchMemoryTracker scratch{};
+            ImportClock::time_point importStart = ImportClock::now();
+
+            ImportClock::time_point phaseStart = ImportClock::now();
+            uint64_t cacheKey = 0;
+            bool useCache = !settings.cacheDirectory.empty() && getIfcCacheKey(path, settings, &cacheKey);
+            std::filesystem::path cachePath = useCache ? getIfcCachePath(settings.cacheDirectory, cacheKey) : std::filesystem::path{};
+
+            model::Model cachedModel{};
+            IfcElementIndex cachedIndex{};
+            size_t cacheBytesRead = 0;
+            bool succeeded;
+            if (useCache && readIfcCache(device, cachePath, cacheKey, &cachedModel, &cachedIndex, &cacheBytesRead))
+            {
+                addImportPhaseTime(&statistics, "cache_read", phaseStart);
+                statistics.bytesRead += file_size(path) + cacheBytesRead;
+                addIfcCachedModelStatistics(&statistics, &cachedModel);
+                succeeded = streamIfcCachedModel(outImport, &cachedModel, &cachedIndex);
+                outImport->vertexArena = std::move(cachedModel.vertexArena);
+                outImport->indexArena = std::move(cachedModel.indexArena);
+            }
+            else
             {
-                glm::mat4 flipMatrix = glm::mat4{
-                    1, 0, 0, 0,
-                    0, 0, 1, 0,
-                    0, 1, 0, 0,
-                    0, 0, 0, 1
+                // the elements are also collected here, so that the cache can be written in the same order as importIfc
+                IfcElementCollector collector{};
+                IfcImportSink sink{
+                    .onElement = [outImport, useCache, &collector](IfcImportedElement&& element) {
+                        if (useCache)
+                        {
+                            collectIfcElement(&collector, element);
+                        }
+                        pushIfcImportedElement(outImport, &element);
+                    },
+                    .cancelled = &outImport->cancelled
                 };
-                outMatrix = flipMatrix * outMatrix * flipMatrix;
+                succeeded = importIfcWithSink(device, path, settings, &sink, &outImport->vertexArena, &outImport->indexArena, &statistics, &scratch);
+
+                if (succeeded && useCache)
+                {
+                    phaseStart = ImportClock::now();
+                    model::Model cacheModel{};
+                    IfcElementIndex cacheIndex{};
+                    addIfcElements(&collector.elements, &collector.geometries, collector.materials, &cacheModel, &cacheIndex);
+                    if (!writeIfcCache(cachePath, cacheKey, &cacheModel, &cacheIndex))
+                    {
+                        std::cout << "ifc: failed to write cache for " << path.filename() << std::endl;
+                    }
+                    addImportPhaseTime(&statistics, "cache_write", phaseStart);
+                }
             }
-            outNode->localTransform = outMatrix;
 
-            assert(meshIndex != invalidIndex);
-            outNode->meshIndex = meshIndex;
+            statistics.totalSeconds = secondsSince(importStart);
+            statistics.peakScratchBytes = scratch.peak;
+            outImport->statistics = std::move(statistics);
+            outImport->succeeded = succeeded;
+
+            // the buffer arenas and statistics are handed over by setting finished, after all elements have been pushed
+            outImport->finished.store(true, std::memory_order_release);
         }
+    });
+}
 
-        std::cout << "ifc: imported triangulation for " << element->name() << std::endl;
+bool updateIfcImport(IfcImport* import, model::Model* model, size_t maxElementCount)
+{
+    assert(import != nullptr);
+    assert(model != nullptr);
+
+    // read before draining, so that elements that are pushed after this point are applied in the next update
+    bool finished = import->finished.load(std::memory_order_acquire);
+
+    // the root node is created first, and the nodes of the elements are added as its children
+    if (model->scenes.empty())
+    {
+        assert(model->nodes.empty() && model->meshes.empty() && "ifc should be streamed into an empty model");
+        model->nodes.emplace_back(model::Node{
+            .meshIndex = invalidIndex,
+            .localTransform = glm::mat4(1)
+        });
+        model->scenes.emplace_back(model::Scene{
+            .rootNode = 0
+        });
     }
-    while (iterator.next());
+    size_t rootNode = model->scenes[0].rootNode;
 
-    // create scene
-    size_t sceneIndex = invalidIndex;
+    bool drained = false;
+    IfcImportedElement element{};
+    for (size_t i = 0; i < maxElementCount; i++)
     {
-        outModel->scenes.emplace_back();
-        sceneIndex = outModel->scenes.size() - 1;
+        if (!tryPopSpscQueue(&import->queue, &element))
+        {
+            drained = true;
+            break;
+        }
+        if (element.hasMesh)
+        {
+            assert(element.geometryIndex == model->meshes.size());
+            model->meshes.emplace_back(std::move(element.mesh));
+        }
+        model->materials.insert(model->materials.end(), element.materials.begin(), element.materials.end());
+        model->nodes.emplace_back(model::Node{
+            .meshIndex = element.geometryIndex,
+            .localTransform = element.transform
+        });
+        model->nodes[rootNode].childNodes.emplace_back(model->nodes.size() - 1);
+        if (!element.globalId.empty())
+        {
+            addIfcElementInfo(&import->elementIndex, model->nodes.size() - 1, element.globalId, element.type, element.name);
+        }
+        import->appliedElementCount++;
     }
 
-    // create root node
+    if (finished && drained && !import->appliedBuffers)
     {
-        assert(sceneIndex != invalidIndex);
-        model::Scene* scene = &outModel->scenes[sceneIndex];
+        model->vertexArena = std::move(import->vertexArena);
+        model->indexArena = std::move(import->indexArena);
+        import->appliedBuffers = true;
+    }
+    return import->appliedBuffers;
+}
 
-        std::vector<size_t> nodeIndices(outModel->nodes.size());
-        std::iota(nodeIndices.begin(), nodeIndices.end(), 0);
+void cancelIfcImport(IfcImport* import)
+{
+    import->cancelled = true;
+}
 
-        // create the root node
-        // this makes iterating easier using a tree-traversal algorithm
-        outModel->nodes.emplace_back(model::Node{
-            .meshIndex = invalidIndex,
-            .localTransform = glm::mat4(1),
-            .childNodes = nodeIndices
-        });
-        scene->rootNode = outModel->nodes.size() - 1;
+bool finishIfcImport(IfcImport* import)
+{
+    if (import->thread.joinable())
+    {
+        import->thread.join();
     }
-
-    return true;
-}
\ No newline at end of file
+    return import->succeeded;
+}
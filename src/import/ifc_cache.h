@@ -0,0 +1,40 @@
+#ifndef METAL_EXPERIMENT_IFC_CACHE_H
+#define METAL_EXPERIMENT_IFC_CACHE_H
+
+#include <cstdint>
+#include <filesystem>
+
+#import <Metal/MTLDevice.h>
+
+#include "ifc.h"
+#include "../model.h"
+
+// on-disk cache of the result of importIfc, so that IfcOpenShell (parsing and tessellation) can be skipped entirely
+// when the same file is imported again with the same settings.
+//
+// layout (all integers little endian, sections aligned to 16 bytes, see IfcCacheHeader):
+// header | materials | meshes | primitives | vertex attributes | nodes | levels of detail | level index ranges |
+// strings | string offsets | occluder positions | occluder indices | vertex data | index data
+// the vertex and index data are stored exactly as they are uploaded to the GPU, so a cache hit memory maps the file
+// and copies both sections into the model's buffer arenas with one copy each.
+
+// key of the cache entry, hash of the file contents, the settings that affect the output, and the cache version
+// returns false if the file can't be read
+[[nodiscard]] bool getIfcCacheKey(std::filesystem::path const& path, IfcImportSettings const& settings, uint64_t* outKey);
+
+// e.g. <cacheDirectory>/0123456789abcdef.ifccache
+[[nodiscard]] std::filesystem::path getIfcCachePath(std::filesystem::path const& cacheDirectory, uint64_t key);
+
+// reads the materials, meshes and nodes (without scene and root node) into the model, and creates its buffer arenas
+// the metadata of the nodes is added to outIndex
+// returns false if the cache file doesn't exist, is invalid or was written for a different key. the model is then unchanged
+[[nodiscard]] bool readIfcCache(
+    id <MTLDevice> device, std::filesystem::path const& cachePath, uint64_t key,
+    model::Model* outModel, IfcElementIndex* outIndex, size_t* outBytesRead);
+
+// writes the materials, meshes and nodes of the model and their metadata (except for the root node, which is recreated when reading)
+// the file is written to a temporary file first and then renamed, so a partially written cache file is never read
+// returns true when successful
+[[nodiscard]] bool writeIfcCache(std::filesystem::path const& cachePath, uint64_t key, model::Model const* model, IfcElementIndex const* index);
+
+#endif //METAL_EXPERIMENT_IFC_CACHE_H
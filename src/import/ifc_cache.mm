@@ -0,0 +1,620 @@
+#include "ifc_cache.h"
+
+#include "../hash.h"
+#include "../mapped_file.h"
+
+#include <algorithm>
+#include <bit>
+#include <cassert>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <limits>
+#include <map>
+#include <span>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+#include "fmt/format.h"
+
+constexpr char ifcCacheMagic[8] = {'I', 'F', 'C', 'C', 'A', 'C', 'H', 'E'};
+
+// should be incremented when the layout, the geometry settings of importIfc or its output changes
+constexpr uint32_t ifcCacheVersion = 4;
+
+constexpr size_t ifcCacheSectionAlignment = 16;
+
+// the types below use fixed size integers only, so that the layout doesn't depend on the platform
+struct IfcCacheSection
+{
+    uint64_t offset; // in bytes from the start of the file
+    uint64_t size; // in bytes
+};
+
+struct IfcCacheHeader
+{
+    char magic[8];
+    uint32_t version;
+    uint32_t headerSize;
+    uint64_t key;
+    uint64_t fileSize;
+    IfcCacheSection materials;
+    IfcCacheSection meshes;
+    IfcCacheSection primitives;
+    IfcCacheSection attributes;
+    IfcCacheSection nodes;
+    IfcCacheSection lods;
+    IfcCacheSection lodRanges;
+    IfcCacheSection strings;
+    IfcCacheSection stringOffsets;
+    IfcCacheSection occluderPositions;
+    IfcCacheSection occluderIndices;
+    IfcCacheSection vertexData;
+    IfcCacheSection indexData;
+};
+
+struct IfcCacheMaterial
+{
+    float baseColor[3];
+    float metalness;
+    float roughness;
+};
+
+struct IfcCacheMesh
+{
+    uint64_t firstPrimitive;
+    uint64_t primitiveCount;
+    uint64_t firstLod;
+    uint64_t lodCount;
+    float boundsMin[3];
+    float boundsMax[3];
+    uint64_t firstOccluderPosition; // in positions (3 floats each)
+    uint64_t occluderPositionCount;
+    uint64_t firstOccluderIndex; // the indices are relative to the first position of the mesh
+    uint64_t occluderIndexCount;
+};
+
+struct IfcCacheLod
+{
+    uint64_t firstRange; // one range per primitive of the mesh
+    float error;
+    uint32_t padding;
+};
+
+struct IfcCacheIndexRange
+{
+    uint64_t offset; // in indices, relative to the index data of the primitive
+    uint64_t count;
+};
+
+struct IfcCachePrimitive
+{
+    uint64_t materialIndex; // invalidIndex if none
+    uint64_t vertexDataOffset; // relative to the start of the vertex data section
+    uint64_t indexDataOffset; // relative to the start of the index data section
+    uint64_t vertexCount;
+    uint64_t indexCount; // 0 if not indexed
+    uint64_t firstAttribute;
+    uint64_t attributeCount;
+    uint32_t primitiveType; // MTLPrimitiveType
+    uint32_t indexType; // MTLIndexType
+};
+
+struct IfcCacheAttribute
+{
+    uint16_t type; // VertexAttributeType
+    uint16_t index;
+    uint16_t componentType; // VertexComponentType
+    uint16_t normalized;
+    uint32_t componentCount;
+    uint32_t stride;
+    uint64_t size;
+};
+
+struct IfcCacheNode
+{
+    uint64_t meshIndex;
+    float transform[16]; // column major
+    uint32_t globalId; // index into the strings, invalidStringId if the node has no metadata
+    uint32_t type;
+    uint32_t name;
+    uint32_t padding;
+};
+
+[[nodiscard]] static size_t alignCacheOffset(size_t offset, size_t alignment)
+{
+    return (offset + alignment - 1) / alignment * alignment;
+}
+
+bool getIfcCacheKey(std::filesystem::path const& path, IfcImportSettings const& settings, uint64_t* outKey)
+{
+    // only the settings that change the output, not e.g. the thread count
+    uint64_t settingsValues[] = {
+        ifcCacheVersion,
+        settings.flipYAndZAxes,
+        settings.instanceSharedRepresentations,
+        settings.splitLargePrimitives,
+        settings.optimizeMeshes,
+        settings.quantizeVertices,
+        settings.weldVertices,
+        std::bit_cast<uint64_t>(settings.weldTolerance.position),
+        std::bit_cast<uint64_t>(settings.weldTolerance.normal),
+        settings.lodSettings.levelCount,
+        std::bit_cast<uint32_t>(settings.lodSettings.indexRatio),
+        std::bit_cast<uint32_t>(settings.lodSettings.maxError),
+        std::bit_cast<uint32_t>(settings.lodSettings.normalWeight),
+        hashIfcImportFilter(settings.filter),
+        settings.generateOccluders,
+        settings.occluderSettings.gridResolution,
+        std::bit_cast<uint32_t>(settings.occluderSettings.minThicknessRatio),
+        settings.occluderSettings.maxBoxCount,
+        std::bit_cast<uint32_t>(settings.occluderSettings.minBoxAreaRatio)
+    };
+    uint64_t seed = hashBytes(settingsValues, sizeof(settingsValues));
+
+    MappedFile file{};
+    if (!mapFile(path, &file))
+    {
+        return false;
+    }
+    *outKey = hashBytes(file.data, file.size, seed);
+    unmapFile(&file);
+    return true;
+}
+
+std::filesystem::path getIfcCachePath(std::filesystem::path const& cacheDirectory, uint64_t key)
+{
+    return cacheDirectory / fmt::format("{:016x}.ifccache", key);
+}
+
+// returns the section as an array of Type, or an empty span if the section is out of bounds
+template<typename Type>
+[[nodiscard]] static std::span<Type const> getCacheSection(MappedFile const* file, IfcCacheSection section, bool* outValid)
+{
+    if (section.offset > file->size || section.size > file->size - section.offset ||
+        section.size % sizeof(Type) != 0 || section.offset % alignof(Type) != 0)
+    {
+        *outValid = false;
+        return {};
+    }
+    auto const* data = static_cast<unsigned char const*>(file->data) + section.offset;
+    return {reinterpret_cast<Type const*>(data), section.size / sizeof(Type)};
+}
+
+bool readIfcCache(
+    id <MTLDevice> device, std::filesystem::path const& cachePath, uint64_t key,
+    model::Model* outModel, IfcElementIndex* outIndex, size_t* outBytesRead)
+{
+    MappedFile file{};
+    if (!exists(cachePath) || !mapFile(cachePath, &file))
+    {
+        return false;
+    }
+
+    IfcCacheHeader header{};
+    bool valid = file.size >= sizeof(IfcCacheHeader);
+    if (valid)
+    {
+        memcpy(&header, file.data, sizeof(IfcCacheHeader));
+        valid = memcmp(header.magic, ifcCacheMagic, sizeof(ifcCacheMagic)) == 0 &&
+                header.version == ifcCacheVersion &&
+                header.headerSize == sizeof(IfcCacheHeader) &&
+                header.key == key &&
+                header.fileSize == file.size;
+    }
+
+    std::span<IfcCacheMaterial const> materials;
+    std::span<IfcCacheMesh const> meshes;
+    std::span<IfcCachePrimitive const> primitives;
+    std::span<IfcCacheAttribute const> attributes;
+    std::span<IfcCacheNode const> nodes;
+    std::span<IfcCacheLod const> lods;
+    std::span<IfcCacheIndexRange const> lodRanges;
+    std::span<char const> strings;
+    std::span<uint32_t const> stringOffsets; // per string its start in strings, the last element is the end of the last string
+    std::span<float const> occluderPositions;
+    std::span<uint32_t const> occluderIndices;
+    std::span<unsigned char const> vertexData;
+    std::span<unsigned char const> indexData;
+    if (valid)
+    {
+        materials = getCacheSection<IfcCacheMaterial>(&file, header.materials, &valid);
+        meshes = getCacheSection<IfcCacheMesh>(&file, header.meshes, &valid);
+        primitives = getCacheSection<IfcCachePrimitive>(&file, header.primitives, &valid);
+        attributes = getCacheSection<IfcCacheAttribute>(&file, header.attributes, &valid);
+        nodes = getCacheSection<IfcCacheNode>(&file, header.nodes, &valid);
+        lods = getCacheSection<IfcCacheLod>(&file, header.lods, &valid);
+        lodRanges = getCacheSection<IfcCacheIndexRange>(&file, header.lodRanges, &valid);
+        strings = getCacheSection<char>(&file, header.strings, &valid);
+        stringOffsets = getCacheSection<uint32_t>(&file, header.stringOffsets, &valid);
+        occluderPositions = getCacheSection<float>(&file, header.occluderPositions, &valid);
+        occluderIndices = getCacheSection<uint32_t>(&file, header.occluderIndices, &valid);
+        vertexData = getCacheSection<unsigned char>(&file, header.vertexData, &valid);
+        indexData = getCacheSection<unsigned char>(&file, header.indexData, &valid);
+    }
+
+    // validate all references before changing the model
+    for (size_t i = 0; valid && i < meshes.size(); i++)
+    {
+        valid = meshes[i].firstPrimitive + meshes[i].primitiveCount <= primitives.size();
+    }
+    for (size_t i = 0; valid && i < primitives.size(); i++)
+    {
+        IfcCachePrimitive const& primitive = primitives[i];
+        size_t vertexDataSize = 0;
+        valid = primitive.firstAttribute + primitive.attributeCount <= attributes.size() &&
+                (primitive.materialIndex == invalidIndex || primitive.materialIndex < materials.size());
+        for (size_t j = 0; valid && j < primitive.attributeCount; j++)
+        {
+            vertexDataSize += attributes[primitive.firstAttribute + j].size;
+        }
+        size_t indexSize = primitive.indexType == MTLIndexTypeUInt16 ? sizeof(uint16_t) : sizeof(uint32_t);
+        valid = valid &&
+                primitive.vertexDataOffset + vertexDataSize <= vertexData.size() &&
+                primitive.indexDataOffset + primitive.indexCount * indexSize <= indexData.size();
+    }
+    for (size_t i = 0; valid && i < meshes.size(); i++)
+    {
+        IfcCacheMesh const& mesh = meshes[i];
+        valid = mesh.firstLod + mesh.lodCount <= lods.size();
+        for (size_t j = 0; valid && j < mesh.lodCount; j++)
+        {
+            IfcCacheLod const& lod = lods[mesh.firstLod + j];
+            valid = lod.firstRange + mesh.primitiveCount <= lodRanges.size();
+            for (size_t k = 0; valid && k < mesh.primitiveCount; k++)
+            {
+                IfcCachePrimitive const& primitive = primitives[mesh.firstPrimitive + k];
+                IfcCacheIndexRange const& range = lodRanges[lod.firstRange + k];
+                size_t indexSize = primitive.indexType == MTLIndexTypeUInt16 ? sizeof(uint16_t) : sizeof(uint32_t);
+                valid = primitive.indexDataOffset + (range.offset + range.count) * indexSize <= indexData.size();
+            }
+        }
+    }
+    for (size_t i = 0; valid && i < meshes.size(); i++)
+    {
+        IfcCacheMesh const& mesh = meshes[i];
+        valid = (mesh.firstOccluderPosition + mesh.occluderPositionCount) * 3 <= occluderPositions.size() &&
+                mesh.firstOccluderIndex + mesh.occluderIndexCount <= occluderIndices.size() &&
+                mesh.occluderIndexCount % 3 == 0;
+        for (size_t j = 0; valid && j < mesh.occluderIndexCount; j++)
+        {
+            valid = occluderIndices[mesh.firstOccluderIndex + j] < mesh.occluderPositionCount;
+        }
+    }
+    valid = valid && !stringOffsets.empty() && stringOffsets.back() <= strings.size();
+    for (size_t i = 1; valid && i < stringOffsets.size(); i++)
+    {
+        valid = stringOffsets[i - 1] <= stringOffsets[i];
+    }
+    size_t stringCount = stringOffsets.empty() ? 0 : stringOffsets.size() - 1;
+    for (size_t i = 0; valid && i < nodes.size(); i++)
+    {
+        IfcCacheNode const& node = nodes[i];
+        valid = node.meshIndex < meshes.size() &&
+                (node.globalId == invalidStringId || (node.globalId < stringCount && node.type < stringCount && node.name < stringCount));
+    }
+    if (!valid)
+    {
+        std::cout << "ifc: ignoring invalid or outdated cache file " << cachePath << std::endl;
+        unmapFile(&file);
+        return false;
+    }
+
+    // copy the vertex and index data into the GPU buffers, with one copy each
+    createBufferArena(device, std::max(vertexData.size(), (size_t)1), &outModel->vertexArena);
+    createBufferArena(device, std::max(indexData.size(), (size_t)1), &outModel->indexArena);
+    BufferArenaAllocation vertexAllocation{};
+    BufferArenaAllocation indexAllocation{};
+    if (!vertexData.empty())
+    {
+        vertexAllocation = allocateFromBufferArena(&outModel->vertexArena, vertexData.size(), vertexDataAlignment);
+        memcpy(vertexAllocation.data, vertexData.data(), vertexData.size());
+    }
+    if (!indexData.empty())
+    {
+        indexAllocation = allocateFromBufferArena(&outModel->indexArena, indexData.size(), indexDataAlignment);
+        memcpy(indexAllocation.data, indexData.data(), indexData.size());
+    }
+
+    for (IfcCacheMaterial const& material: materials)
+    {
+        outModel->materials.emplace_back(model::Material{
+            .baseColor = simd_float3{material.baseColor[0], material.baseColor[1], material.baseColor[2]},
+            .metalness = material.metalness,
+            .roughness = material.roughness
+        });
+    }
+
+    for (IfcCacheMesh const& mesh: meshes)
+    {
+        model::Mesh* outMesh = &outModel->meshes.emplace_back();
+        outMesh->boundsMin = glm::vec3(mesh.boundsMin[0], mesh.boundsMin[1], mesh.boundsMin[2]);
+        outMesh->boundsMax = glm::vec3(mesh.boundsMax[0], mesh.boundsMax[1], mesh.boundsMax[2]);
+        for (size_t i = 0; i < mesh.occluderPositionCount; i++)
+        {
+            float const* position = &occluderPositions[(mesh.firstOccluderPosition + i) * 3];
+            outMesh->occluderPositions.emplace_back(position[0], position[1], position[2]);
+        }
+        std::span<uint32_t const> meshOccluderIndices = occluderIndices.subspan(mesh.firstOccluderIndex, mesh.occluderIndexCount);
+        outMesh->occluderIndices.assign(meshOccluderIndices.begin(), meshOccluderIndices.end());
+        for (size_t i = 0; i < mesh.lodCount; i++)
+        {
+            IfcCacheLod const& lod = lods[mesh.firstLod + i];
+            model::MeshLod* outLod = &outMesh->lods.emplace_back();
+            outLod->error = lod.error;
+            for (size_t j = 0; j < mesh.primitiveCount; j++)
+            {
+                IfcCacheIndexRange const& range = lodRanges[lod.firstRange + j];
+                outLod->primitiveRanges.emplace_back(IndexRange{.offset = range.offset, .count = range.count});
+            }
+        }
+        for (size_t i = 0; i < mesh.primitiveCount; i++)
+        {
+            IfcCachePrimitive const& primitive = primitives[mesh.firstPrimitive + i];
+            PrimitiveDeinterleaved outPrimitive{
+                .vertexBuffer = vertexAllocation.buffer,
+                .vertexBufferOffset = vertexAllocation.offset + primitive.vertexDataOffset,
+                .indexBuffer = indexAllocation.buffer,
+                .indexBufferOffset = indexAllocation.offset + primitive.indexDataOffset,
+                .vertexCount = primitive.vertexCount,
+                .indexCount = primitive.indexCount,
+                .primitiveType = (MTLPrimitiveType)primitive.primitiveType,
+                .indexType = (MTLIndexType)primitive.indexType,
+                .indexed = primitive.indexCount > 0
+            };
+            for (size_t j = 0; j < primitive.attributeCount; j++)
+            {
+                IfcCacheAttribute const& attribute = attributes[primitive.firstAttribute + j];
+                outPrimitive.attributes.emplace_back(VertexAttribute{
+                    .type = (VertexAttributeType)attribute.type,
+                    .index = attribute.index,
+                    .componentCount = attribute.componentCount,
+                    .componentType = (VertexComponentType)attribute.componentType,
+                    .normalized = attribute.normalized != 0,
+                    .stride = attribute.stride,
+                    .size = attribute.size
+                });
+            }
+            outMesh->primitives.emplace_back(model::Primitive{
+                .primitive = outPrimitive,
+                .materialIndex = primitive.materialIndex
+            });
+        }
+    }
+
+    auto getCacheString = [&](uint32_t id) {
+        return std::string_view(strings.data() + stringOffsets[id], stringOffsets[id + 1] - stringOffsets[id]);
+    };
+    for (IfcCacheNode const& node: nodes)
+    {
+        model::Node* outNode = &outModel->nodes.emplace_back();
+        outNode->meshIndex = node.meshIndex;
+        memcpy(&outNode->localTransform, node.transform, sizeof(node.transform));
+        if (node.globalId != invalidStringId)
+        {
+            addIfcElementInfo(outIndex, outModel->nodes.size() - 1,
+                              getCacheString(node.globalId), getCacheString(node.type), getCacheString(node.name));
+        }
+    }
+
+    *outBytesRead = file.size;
+    unmapFile(&file);
+    return true;
+}
+
+// appends the array to the file data as a section, aligned to ifcCacheSectionAlignment
+template<typename Type>
+static IfcCacheSection appendCacheSection(std::vector<unsigned char>* data, std::span<Type const> values)
+{
+    data->resize(alignCacheOffset(data->size(), ifcCacheSectionAlignment), 0);
+    IfcCacheSection section{.offset = data->size(), .size = values.size_bytes()};
+    auto const* bytes = reinterpret_cast<unsigned char const*>(values.data());
+    data->insert(data->end(), bytes, bytes + values.size_bytes());
+    return section;
+}
+
+bool writeIfcCache(std::filesystem::path const& cachePath, uint64_t key, model::Model const* model, IfcElementIndex const* index)
+{
+    std::vector<IfcCacheMaterial> materials;
+    for (model::Material const& material: model->materials)
+    {
+        materials.emplace_back(IfcCacheMaterial{
+            .baseColor = {material.baseColor.x, material.baseColor.y, material.baseColor.z},
+            .metalness = material.metalness,
+            .roughness = material.roughness
+        });
+    }
+
+    std::vector<IfcCacheMesh> meshes;
+    std::vector<IfcCachePrimitive> primitives;
+    std::vector<IfcCacheAttribute> attributes;
+    std::vector<IfcCacheLod> lods;
+    std::vector<IfcCacheIndexRange> lodRanges;
+    std::vector<float> occluderPositions;
+    std::vector<uint32_t> occluderIndices;
+    std::vector<unsigned char> vertexData;
+    std::vector<unsigned char> indexData;
+
+    // primitives can share vertex data (e.g. one primitive per material), which is then stored once
+    std::map<std::pair<void const*, size_t>, uint64_t> vertexDataOffsets;
+
+    for (model::Mesh const& mesh: model->meshes)
+    {
+        meshes.emplace_back(IfcCacheMesh{
+            .firstPrimitive = primitives.size(),
+            .primitiveCount = mesh.primitives.size(),
+            .firstLod = lods.size(),
+            .lodCount = mesh.lods.size(),
+            .boundsMin = {mesh.boundsMin.x, mesh.boundsMin.y, mesh.boundsMin.z},
+            .boundsMax = {mesh.boundsMax.x, mesh.boundsMax.y, mesh.boundsMax.z},
+            .firstOccluderPosition = occluderPositions.size() / 3,
+            .occluderPositionCount = mesh.occluderPositions.size(),
+            .firstOccluderIndex = occluderIndices.size(),
+            .occluderIndexCount = mesh.occluderIndices.size()
+        });
+        for (glm::vec3 const& position: mesh.occluderPositions)
+        {
+            occluderPositions.insert(occluderPositions.end(), {position.x, position.y, position.z});
+        }
+        occluderIndices.insert(occluderIndices.end(), mesh.occluderIndices.begin(), mesh.occluderIndices.end());
+        for (model::MeshLod const& lod: mesh.lods)
+        {
+            assert(lod.primitiveRanges.size() == mesh.primitives.size());
+            lods.emplace_back(IfcCacheLod{.firstRange = lodRanges.size(), .error = lod.error});
+            for (IndexRange const& range: lod.primitiveRanges)
+            {
+                lodRanges.emplace_back(IfcCacheIndexRange{.offset = range.offset, .count = range.count});
+            }
+        }
+
+        // the primitives of a mesh with levels of detail share one index buffer region that contains the indices of all
+        // levels, which is stored as a whole so that the level ranges stay valid
+        size_t lodIndexDataStart = std::numeric_limits<size_t>::max();
+        size_t lodIndexDataEnd = 0;
+        uint64_t lodIndexDataOffset = 0;
+        if (!mesh.lods.empty())
+        {
+            for (size_t i = 0; i < mesh.primitives.size(); i++)
+            {
+                PrimitiveDeinterleaved const& p = mesh.primitives[i].primitive;
+                assert(p.indexed && p.indexBuffer == mesh.primitives[0].primitive.indexBuffer);
+                size_t indexSize = p.indexType == MTLIndexTypeUInt16 ? sizeof(uint16_t) : sizeof(uint32_t);
+                lodIndexDataStart = std::min(lodIndexDataStart, p.indexBufferOffset);
+                lodIndexDataEnd = std::max(lodIndexDataEnd, p.indexBufferOffset + p.indexCount * indexSize);
+                for (model::MeshLod const& lod: mesh.lods)
+                {
+                    IndexRange const& range = lod.primitiveRanges[i];
+                    lodIndexDataEnd = std::max(lodIndexDataEnd, p.indexBufferOffset + (range.offset + range.count) * indexSize);
+                }
+            }
+            lodIndexDataOffset = alignCacheOffset(indexData.size(), indexDataAlignment);
+            indexData.resize(lodIndexDataOffset, 0);
+            auto const* source = (unsigned char const*)[mesh.primitives[0].primitive.indexBuffer contents] + lodIndexDataStart;
+            indexData.insert(indexData.end(), source, source + (lodIndexDataEnd - lodIndexDataStart));
+        }
+
+        for (model::Primitive const& primitive: mesh.primitives)
+        {
+            PrimitiveDeinterleaved const& p = primitive.primitive;
+
+            size_t vertexDataSize = 0;
+            uint64_t firstAttribute = attributes.size();
+            for (VertexAttribute const& attribute: p.attributes)
+            {
+                attributes.emplace_back(IfcCacheAttribute{
+                    .type = (uint16_t)attribute.type,
+                    .index = attribute.index,
+                    .componentType = (uint16_t)attribute.componentType,
+                    .normalized = attribute.normalized,
+                    .componentCount = (uint32_t)attribute.componentCount,
+                    .stride = (uint32_t)attribute.stride,
+                    .size = attribute.size
+                });
+                vertexDataSize += attribute.size;
+            }
+
+            auto [it, inserted] = vertexDataOffsets.try_emplace({(void const*)p.vertexBuffer, p.vertexBufferOffset}, 0);
+            if (inserted)
+            {
+                it->second = alignCacheOffset(vertexData.size(), vertexDataAlignment);
+                vertexData.resize(it->second, 0);
+                auto const* source = (unsigned char const*)[p.vertexBuffer contents] + p.vertexBufferOffset;
+                vertexData.insert(vertexData.end(), source, source + vertexDataSize);
+            }
+
+            size_t indexSize = p.indexType == MTLIndexTypeUInt16 ? sizeof(uint16_t) : sizeof(uint32_t);
+            size_t indexCount = p.indexed ? p.indexCount : 0;
+            uint64_t indexDataOffset = 0;
+            if (!mesh.lods.empty())
+            {
+                indexDataOffset = lodIndexDataOffset + (p.indexBufferOffset - lodIndexDataStart);
+            }
+            else
+            {
+                indexDataOffset = alignCacheOffset(indexData.size(), indexDataAlignment);
+                indexData.resize(indexDataOffset, 0);
+            }
+            if (indexCount > 0 && mesh.lods.empty())
+            {
+                auto const* source = (unsigned char const*)[p.indexBuffer contents] + p.indexBufferOffset;
+                indexData.insert(indexData.end(), source, source + indexCount * indexSize);
+            }
+
+            primitives.emplace_back(IfcCachePrimitive{
+                .materialIndex = primitive.materialIndex,
+                .vertexDataOffset = it->second,
+                .indexDataOffset = indexDataOffset,
+                .vertexCount = p.vertexCount,
+                .indexCount = indexCount,
+                .firstAttribute = firstAttribute,
+                .attributeCount = p.attributes.size(),
+                .primitiveType = (uint32_t)p.primitiveType,
+                .indexType = (uint32_t)p.indexType
+            });
+        }
+    }
+
+    // the root node is recreated when reading
+    // the strings of the index are stored as is, the string ids stay the same
+    std::vector<IfcCacheNode> nodes;
+    for (size_t i = 0; i < model->nodes.size(); i++)
+    {
+        model::Node const& node = model->nodes[i];
+        if (node.meshIndex == invalidIndex)
+        {
+            continue;
+        }
+        IfcCacheNode* outNode = &nodes.emplace_back();
+        outNode->meshIndex = node.meshIndex;
+        memcpy(outNode->transform, &node.localTransform, sizeof(outNode->transform));
+        IfcElementInfo const* info = getIfcElementInfo(index, i);
+        outNode->globalId = info ? info->globalId : invalidStringId;
+        outNode->type = info ? info->type : invalidStringId;
+        outNode->name = info ? info->name : invalidStringId;
+    }
+
+    IfcCacheHeader header{};
+    memcpy(header.magic, ifcCacheMagic, sizeof(ifcCacheMagic));
+    header.version = ifcCacheVersion;
+    header.headerSize = sizeof(IfcCacheHeader);
+    header.key = key;
+
+    std::vector<unsigned char> data(sizeof(IfcCacheHeader));
+    header.materials = appendCacheSection<IfcCacheMaterial>(&data, materials);
+    header.meshes = appendCacheSection<IfcCacheMesh>(&data, meshes);
+    header.primitives = appendCacheSection<IfcCachePrimitive>(&data, primitives);
+    header.attributes = appendCacheSection<IfcCacheAttribute>(&data, attributes);
+    header.nodes = appendCacheSection<IfcCacheNode>(&data, nodes);
+    header.lods = appendCacheSection<IfcCacheLod>(&data, lods);
+    header.lodRanges = appendCacheSection<IfcCacheIndexRange>(&data, lodRanges);
+    header.strings = appendCacheSection<char>(&data, index->strings.characters);
+    header.stringOffsets = appendCacheSection<uint32_t>(&data, index->strings.offsets);
+    header.occluderPositions = appendCacheSection<float>(&data, occluderPositions);
+    header.occluderIndices = appendCacheSection<uint32_t>(&data, occluderIndices);
+    header.vertexData = appendCacheSection<unsigned char>(&data, vertexData);
+    header.indexData = appendCacheSection<unsigned char>(&data, indexData);
+    header.fileSize = data.size();
+    memcpy(data.data(), &header, sizeof(IfcCacheHeader));
+
+    std::error_code error;
+    create_directories(cachePath.parent_path(), error);
+    std::filesystem::path temporaryPath = cachePath;
+    temporaryPath += ".tmp";
+    {
+        std::ofstream file(temporaryPath, std::ios::binary | std::ios::trunc);
+        if (!file || !file.write(reinterpret_cast<char const*>(data.data()), (std::streamsize)data.size()))
+        {
+            std::cout << "ifc: failed to write cache file " << temporaryPath << std::endl;
+            return false;
+        }
+    }
+    rename(temporaryPath, cachePath, error);
+    if (error)
+    {
+        std::cout << "ifc: failed to write cache file " << cachePath << ": " << error.message() << std::endl;
+        remove(temporaryPath, error);
+        return false;
+    }
+    return true;
+}
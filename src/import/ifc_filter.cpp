@@ -0,0 +1,303 @@
+#include "ifc_filter.h"
+
+#include <ifcparse/IfcFile.h>
+
+#include <algorithm>
+#include <iostream>
+#include <memory>
+#include <unordered_map>
+#include <unordered_set>
+
+#include "../hash.h"
+
+#include "glm/geometric.hpp"
+#include "glm/mat4x4.hpp"
+#include "glm/vector_relational.hpp"
+
+// entities are accessed by attribute name, so that the filter works for each schema (IFC2X3, IFC4, IFC4X3)
+using IfcEntity = IfcUtil::IfcBaseClass;
+
+// local placements that are nested deeper than this are assumed to be cyclic (invalid file)
+constexpr size_t maxIfcPlacementDepth = 64;
+
+bool isIfcImportFilterEmpty(IfcImportFilter const& filter)
+{
+    return filter.storeys.empty() && filter.includeTypes.empty() && filter.excludeTypes.empty() && !filter.useBounds;
+}
+
+uint64_t hashIfcImportFilter(IfcImportFilter const& filter)
+{
+    // the sizes are hashed as well, so that e.g. {"ab", "c"} and {"a", "bc"} have a different hash
+    uint64_t hash = 0;
+    for (std::vector<std::string> const* names: {&filter.storeys, &filter.includeTypes, &filter.excludeTypes})
+    {
+        uint64_t count = names->size();
+        hash = hashBytes(&count, sizeof(count), hash);
+        for (std::string const& name: *names)
+        {
+            uint64_t size = name.size();
+            hash = hashBytes(&size, sizeof(size), hash);
+            hash = hashString(name, hash);
+        }
+    }
+    float bounds[7] = {
+        filter.useBounds ? 1.0f : 0.0f,
+        filter.boundsMin.x, filter.boundsMin.y, filter.boundsMin.z,
+        filter.boundsMax.x, filter.boundsMax.y, filter.boundsMax.z
+    };
+    return hashBytes(bounds, sizeof(bounds), hash);
+}
+
+[[nodiscard]] static std::vector<IfcEntity*> getIfcEntities(IfcParse::IfcFile* file, std::string const& type)
+{
+    std::vector<IfcEntity*> result;
+    aggregate_of_instance::ptr instances = file->instances_by_type(type);
+    if (instances)
+    {
+        result.assign(instances->begin(), instances->end());
+    }
+    return result;
+}
+
+// returns nullptr if the attribute is not set
+[[nodiscard]] static IfcEntity* getIfcReference(IfcEntity* entity, std::string const& attribute)
+{
+    auto value = entity->get(attribute);
+    return value.isNull() ? nullptr : (IfcEntity*)value;
+}
+
+[[nodiscard]] static std::vector<IfcEntity*> getIfcReferences(IfcEntity* entity, std::string const& attribute)
+{
+    auto value = entity->get(attribute);
+    if (value.isNull())
+    {
+        return {};
+    }
+    aggregate_of_instance::ptr references = value;
+    return {references->begin(), references->end()};
+}
+
+[[nodiscard]] static std::string getIfcString(IfcEntity* entity, std::string const& attribute)
+{
+    auto value = entity->get(attribute);
+    return value.isNull() ? std::string{} : (std::string)value;
+}
+
+// ids of all elements in the given storeys (by Name or GlobalId), including the storeys, their spaces and the parts of
+// the elements (e.g. the flights of a stair)
+[[nodiscard]] static std::unordered_set<int> getIfcStoreyElements(IfcParse::IfcFile* file, std::vector<std::string> const& storeys)
+{
+    // children per spatial structure or element
+    std::unordered_map<int, std::vector<IfcEntity*>> children;
+    for (IfcEntity* relation: getIfcEntities(file, "IfcRelContainedInSpatialStructure"))
+    {
+        IfcEntity* structure = getIfcReference(relation, "RelatingStructure");
+        std::vector<IfcEntity*> elements = getIfcReferences(relation, "RelatedElements");
+        if (structure)
+        {
+            std::vector<IfcEntity*>* structureChildren = &children[structure->id()];
+            structureChildren->insert(structureChildren->end(), elements.begin(), elements.end());
+        }
+    }
+    for (IfcEntity* relation: getIfcEntities(file, "IfcRelAggregates"))
+    {
+        IfcEntity* object = getIfcReference(relation, "RelatingObject");
+        std::vector<IfcEntity*> parts = getIfcReferences(relation, "RelatedObjects");
+        if (object)
+        {
+            std::vector<IfcEntity*>* objectChildren = &children[object->id()];
+            objectChildren->insert(objectChildren->end(), parts.begin(), parts.end());
+        }
+    }
+
+    std::vector<IfcEntity*> stack;
+    std::unordered_set<std::string> foundStoreys;
+    for (IfcEntity* storey: getIfcEntities(file, "IfcBuildingStorey"))
+    {
+        for (std::string const& key: {getIfcString(storey, "Name"), getIfcString(storey, "GlobalId")})
+        {
+            if (std::find(storeys.begin(), storeys.end(), key) != storeys.end())
+            {
+                foundStoreys.emplace(key);
+                stack.emplace_back(storey);
+            }
+        }
+    }
+    for (std::string const& storey: storeys)
+    {
+        if (!foundStoreys.contains(storey))
+        {
+            std::cout << "ifc: storey \"" << storey << "\" not found" << std::endl;
+        }
+    }
+
+    // depth-first search over containment and decomposition
+    std::unordered_set<int> result;
+    while (!stack.empty())
+    {
+        IfcEntity* entity = stack.back();
+        stack.pop_back();
+        if (!result.emplace(entity->id()).second)
+        {
+            continue;
+        }
+        auto it = children.find(entity->id());
+        if (it != children.end())
+        {
+            stack.insert(stack.end(), it->second.begin(), it->second.end());
+        }
+    }
+    return result;
+}
+
+[[nodiscard]] static glm::dvec3 getIfcVector(IfcEntity* entity, std::string const& attribute, glm::dvec3 fallback)
+{
+    auto value = entity->get(attribute);
+    if (value.isNull())
+    {
+        return fallback;
+    }
+    std::vector<double> components = value;
+    glm::dvec3 result(0);
+    for (size_t i = 0; i < std::min(components.size(), (size_t)3); i++)
+    {
+        result[(int)i] = components[i];
+    }
+    return result;
+}
+
+// transform of an IfcAxis2Placement2D or IfcAxis2Placement3D, in file units
+[[nodiscard]] static glm::dmat4 getIfcAxisPlacementTransform(IfcEntity* placement)
+{
+    IfcEntity* location = getIfcReference(placement, "Location");
+    glm::dvec3 origin = location ? getIfcVector(location, "Coordinates", glm::dvec3(0)) : glm::dvec3(0);
+
+    glm::dvec3 z(0, 0, 1);
+    if (placement->declaration().is("IfcAxis2Placement3D"))
+    {
+        IfcEntity* axis = getIfcReference(placement, "Axis");
+        z = axis ? glm::normalize(getIfcVector(axis, "DirectionRatios", z)) : z;
+    }
+    IfcEntity* refDirection = getIfcReference(placement, "RefDirection");
+    glm::dvec3 x = refDirection ? getIfcVector(refDirection, "DirectionRatios", glm::dvec3(1, 0, 0)) : glm::dvec3(1, 0, 0);
+    x = glm::normalize(x - glm::dot(x, z) * z);
+    glm::dvec3 y = glm::cross(z, x);
+
+    return glm::dmat4(
+        glm::dvec4(x, 0),
+        glm::dvec4(y, 0),
+        glm::dvec4(z, 0),
+        glm::dvec4(origin, 1)
+    );
+}
+
+// origin of the object placement of a product, in file units
+// only local placements are resolved, other placements (e.g. grid placements) are at the origin of their parent
+[[nodiscard]] static glm::dvec3 getIfcPlacementOrigin(IfcEntity* placement)
+{
+    glm::dmat4 transform(1);
+    for (size_t depth = 0; placement && placement->declaration().is("IfcLocalPlacement") && depth < maxIfcPlacementDepth; depth++)
+    {
+        IfcEntity* relativePlacement = getIfcReference(placement, "RelativePlacement");
+        if (relativePlacement && (relativePlacement->declaration().is("IfcAxis2Placement3D") ||
+                                  relativePlacement->declaration().is("IfcAxis2Placement2D")))
+        {
+            transform = getIfcAxisPlacementTransform(relativePlacement) * transform;
+        }
+        placement = getIfcReference(placement, "PlacementRelTo");
+    }
+    return glm::dvec3(transform[3]);
+}
+
+// scale from the unit to meters (for length units)
+[[nodiscard]] static double getIfcUnitScale(IfcEntity* unit)
+{
+    if (unit->declaration().is("IfcSIUnit"))
+    {
+        std::string prefix = getIfcString(unit, "Prefix");
+        //@formatter:off
+        if (prefix == "KILO") { return 1e3; }
+        if (prefix == "HECTO") { return 1e2; }
+        if (prefix == "DECA") { return 1e1; }
+        if (prefix == "DECI") { return 1e-1; }
+        if (prefix == "CENTI") { return 1e-2; }
+        if (prefix == "MILLI") { return 1e-3; }
+        if (prefix == "MICRO") { return 1e-6; }
+        if (prefix == "NANO") { return 1e-9; }
+        //@formatter:on
+        return 1.0;
+    }
+    if (unit->declaration().is("IfcConversionBasedUnit"))
+    {
+        // e.g. a foot is 0.3048 times the SI unit meter
+        IfcEntity* factor = getIfcReference(unit, "ConversionFactor");
+        IfcEntity* value = factor ? getIfcReference(factor, "ValueComponent") : nullptr;
+        IfcEntity* component = factor ? getIfcReference(factor, "UnitComponent") : nullptr;
+        if (value)
+        {
+            double scale = value->get("wrappedValue");
+            return scale * (component ? getIfcUnitScale(component) : 1.0);
+        }
+    }
+    return 1.0;
+}
+
+// IfcOpenShell outputs the geometry and transforms in meters, while the placements in the file are in the length unit
+[[nodiscard]] static double getIfcLengthUnitScale(IfcParse::IfcFile* file)
+{
+    for (IfcEntity* assignment: getIfcEntities(file, "IfcUnitAssignment"))
+    {
+        for (IfcEntity* unit: getIfcReferences(assignment, "Units"))
+        {
+            if (unit->declaration().is("IfcNamedUnit") && getIfcString(unit, "UnitType") == "LENGTHUNIT")
+            {
+                return getIfcUnitScale(unit);
+            }
+        }
+    }
+    return 1.0;
+}
+
+std::function<bool(IfcUtil::IfcBaseEntity*)> createIfcElementFilter(
+    IfcParse::IfcFile* file, IfcImportFilter const& filter, bool flipYAndZAxes)
+{
+    // shared, as the iterator can copy the filter
+    std::shared_ptr<std::unordered_set<int> const> storeyElements;
+    if (!filter.storeys.empty())
+    {
+        storeyElements = std::make_shared<std::unordered_set<int> const>(getIfcStoreyElements(file, filter.storeys));
+    }
+    double lengthUnitScale = filter.useBounds ? getIfcLengthUnitScale(file) : 1.0;
+
+    return [filter, flipYAndZAxes, storeyElements, lengthUnitScale](IfcUtil::IfcBaseEntity* entity) {
+        if (storeyElements && !storeyElements->contains(entity->id()))
+        {
+            return false;
+        }
+
+        auto isType = [entity](std::string const& type) { return entity->declaration().is(type); };
+        if (!filter.includeTypes.empty() && std::none_of(filter.includeTypes.begin(), filter.includeTypes.end(), isType))
+        {
+            return false;
+        }
+        if (std::any_of(filter.excludeTypes.begin(), filter.excludeTypes.end(), isType))
+        {
+            return false;
+        }
+
+        if (filter.useBounds)
+        {
+            glm::dvec3 origin = getIfcPlacementOrigin(getIfcReference(entity, "ObjectPlacement")) * lengthUnitScale;
+            if (flipYAndZAxes)
+            {
+                std::swap(origin.y, origin.z);
+            }
+            if (glm::any(glm::lessThan(origin, glm::dvec3(filter.boundsMin))) ||
+                glm::any(glm::greaterThan(origin, glm::dvec3(filter.boundsMax))))
+            {
+                return false;
+            }
+        }
+        return true;
+    };
+}
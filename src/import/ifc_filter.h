@@ -0,0 +1,53 @@
+#ifndef METAL_EXPERIMENT_IFC_FILTER_H
+#define METAL_EXPERIMENT_IFC_FILTER_H
+
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <vector>
+
+#include "glm/vec3.hpp"
+
+namespace IfcParse
+{
+    class IfcFile;
+}
+
+namespace IfcUtil
+{
+    class IfcBaseEntity;
+}
+
+// selects which elements of an ifc file are imported. the filter is evaluated on the entities of the parsed file, before
+// tessellation, so elements that are excluded are never tessellated. an element is imported when it passes all criteria
+struct IfcImportFilter
+{
+    // Name or GlobalId of IfcBuildingStorey entities, empty = all storeys
+    // elements are part of a storey when they are contained in it or in one of its spaces (IfcRelContainedInSpatialStructure),
+    // or when they are a part of such an element (IfcRelAggregates, e.g. the flights of a stair)
+    std::vector<std::string> storeys;
+
+    // entity types including their subtypes (e.g. "IfcWall" includes IfcWallStandardCase), empty = all types
+    std::vector<std::string> includeTypes;
+    std::vector<std::string> excludeTypes; // applied after includeTypes
+
+    // box in the coordinates of the imported model (meters, after flipYAndZAxes). as the geometry is not known before
+    // tessellation, the origin of the element's placement is tested, not its bounds
+    bool useBounds = false;
+    glm::vec3 boundsMin{0};
+    glm::vec3 boundsMax{0};
+};
+
+// returns true when the filter imports all elements
+[[nodiscard]] bool isIfcImportFilterEmpty(IfcImportFilter const& filter);
+
+// for the cache key, the order of the names matters
+[[nodiscard]] uint64_t hashIfcImportFilter(IfcImportFilter const& filter);
+
+// creates a filter for IfcGeom::Iterator that returns true for the elements that should be imported
+// the storeys and their contents are resolved once here, the returned function only does lookups
+// logs the storeys that don't exist in the file
+[[nodiscard]] std::function<bool(IfcUtil::IfcBaseEntity*)> createIfcElementFilter(
+    IfcParse::IfcFile* file, IfcImportFilter const& filter, bool flipYAndZAxes);
+
+#endif //METAL_EXPERIMENT_IFC_FILTER_H
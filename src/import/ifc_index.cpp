@@ -0,0 +1,42 @@
+#include "ifc_index.h"
+
+#include <cassert>
+
+constexpr uint32_t invalidNodeIndex = std::numeric_limits<uint32_t>::max();
+
+void addIfcElementInfo(IfcElementIndex* index, size_t nodeIndex, std::string_view globalId, std::string_view type, std::string_view name)
+{
+    assert(nodeIndex < invalidNodeIndex);
+    IfcElementInfo info{
+        .globalId = internString(&index->strings, globalId),
+        .type = internString(&index->strings, type),
+        .name = internString(&index->strings, name)
+    };
+    if (index->nodes.size() <= nodeIndex)
+    {
+        index->nodes.resize(nodeIndex + 1);
+    }
+    index->nodes[nodeIndex] = info;
+
+    index->nodeIndices.resize(getStringCount(&index->strings), invalidNodeIndex);
+    index->nodeIndices[info.globalId] = (uint32_t)nodeIndex;
+}
+
+size_t findIfcElementNode(IfcElementIndex const* index, std::string_view globalId)
+{
+    StringId id = findString(&index->strings, globalId);
+    if (id == invalidStringId || id >= index->nodeIndices.size() || index->nodeIndices[id] == invalidNodeIndex)
+    {
+        return invalidIndex;
+    }
+    return index->nodeIndices[id];
+}
+
+IfcElementInfo const* getIfcElementInfo(IfcElementIndex const* index, size_t nodeIndex)
+{
+    if (nodeIndex >= index->nodes.size() || index->nodes[nodeIndex].globalId == invalidStringId)
+    {
+        return nullptr;
+    }
+    return &index->nodes[nodeIndex];
+}
@@ -0,0 +1,37 @@
+#ifndef METAL_EXPERIMENT_IFC_INDEX_H
+#define METAL_EXPERIMENT_IFC_INDEX_H
+
+#include <cstddef>
+#include <limits>
+#include <string_view>
+#include <vector>
+
+#include "../constants.h"
+#include "../string_pool.h"
+
+// metadata of an ifc element, the strings are stored in the string pool of the index
+struct IfcElementInfo
+{
+    StringId globalId = invalidStringId; // 22 character IfcGloballyUniqueId, e.g. "2O2Fr$t4X7Zf8NOew3FLOH"
+    StringId type = invalidStringId; // entity type, e.g. "IfcWallStandardCase"
+    StringId name = invalidStringId; // can be empty
+};
+
+// metadata of the elements of an imported ifc model, so that e.g. selection and property lookups don't need to reopen
+// the ifc file. types and repeated names are stored once, as all strings are interned
+struct IfcElementIndex
+{
+    StringPool strings;
+    std::vector<IfcElementInfo> nodes; // per node of the model, nodes that are not an element (e.g. the root node) have invalid ids
+    std::vector<uint32_t> nodeIndices; // per string, the node of the element with that GlobalId, for lookups by GlobalId
+};
+
+void addIfcElementInfo(IfcElementIndex* index, size_t nodeIndex, std::string_view globalId, std::string_view type, std::string_view name);
+
+// returns the node of the element with the GlobalId, or invalidIndex if it is not in the index
+[[nodiscard]] size_t findIfcElementNode(IfcElementIndex const* index, std::string_view globalId);
+
+// returns nullptr if the node is not an element
+[[nodiscard]] IfcElementInfo const* getIfcElementInfo(IfcElementIndex const* index, size_t nodeIndex);
+
+#endif //METAL_EXPERIMENT_IFC_INDEX_H
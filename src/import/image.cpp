@@ -0,0 +1,314 @@
+#include "image.h"
+#include "ktx2.h"
+
+#include "turbojpeg.h"
+#include "lodepng.h"
+
+#include <algorithm>
+#include <cassert>
+#include <cctype>
+#include <cstring>
+#include <iostream>
+#include <string>
+
+#if defined(__ARM_NEON)
+#include <arm_neon.h>
+#endif
+
+ImageFormat imageFormatFromMimeType(char const* mimeType)
+{
+    if (mimeType == nullptr)
+    {
+        return ImageFormat::Unknown;
+    }
+    if (strcmp(mimeType, "image/jpeg") == 0)
+    {
+        return ImageFormat::Jpeg;
+    }
+    if (strcmp(mimeType, "image/png") == 0)
+    {
+        return ImageFormat::Png;
+    }
+    if (strcmp(mimeType, "image/ktx2") == 0)
+    {
+        return ImageFormat::Ktx2;
+    }
+    return ImageFormat::Unknown;
+}
+
+ImageFormat imageFormatFromPath(std::filesystem::path const& path)
+{
+    std::string extension = path.extension().string();
+    for (char& c: extension)
+    {
+        c = (char)tolower(c);
+    }
+    if (extension == ".jpg" || extension == ".jpeg")
+    {
+        return ImageFormat::Jpeg;
+    }
+    if (extension == ".png")
+    {
+        return ImageFormat::Png;
+    }
+    if (extension == ".ktx2")
+    {
+        return ImageFormat::Ktx2;
+    }
+    return ImageFormat::Unknown;
+}
+
+int getDownsampleCount(int width, int height, int maxDimension)
+{
+    int count = 0;
+    if (maxDimension <= 0)
+    {
+        return count;
+    }
+    while ((width > maxDimension || height > maxDimension) && (width > 1 || height > 1))
+    {
+        width = std::max(width / 2, 1);
+        height = std::max(height / 2, 1);
+        count++;
+    }
+    return count;
+}
+
+// averages 2x2 blocks of rgba8 pixels of two rows into outputCount pixels
+static void downsampleRows(unsigned char const* row0, unsigned char const* row1, unsigned char* out, size_t outputCount)
+{
+    size_t i = 0;
+#if defined(__ARM_NEON)
+    // 4 output pixels (= 8 input pixels per row) per iteration
+    for (; i + 4 <= outputCount; i += 4)
+    {
+        // deinterleave the even and odd pixels, each pixel is 32 bits
+        uint32x4x2_t top = vld2q_u32(reinterpret_cast<uint32_t const*>(row0 + i * 8));
+        uint32x4x2_t bottom = vld2q_u32(reinterpret_cast<uint32_t const*>(row1 + i * 8));
+
+        uint8x16_t a = vreinterpretq_u8_u32(top.val[0]);
+        uint8x16_t b = vreinterpretq_u8_u32(top.val[1]);
+        uint8x16_t c = vreinterpretq_u8_u32(bottom.val[0]);
+        uint8x16_t d = vreinterpretq_u8_u32(bottom.val[1]);
+
+        // widen to 16 bits to sum the four pixels without overflow
+        uint16x8_t low = vaddq_u16(vaddl_u8(vget_low_u8(a), vget_low_u8(b)), vaddl_u8(vget_low_u8(c), vget_low_u8(d)));
+        uint16x8_t high = vaddq_u16(vaddl_u8(vget_high_u8(a), vget_high_u8(b)), vaddl_u8(vget_high_u8(c), vget_high_u8(d)));
+
+        // divide by 4 with rounding and narrow back to 8 bits
+        vst1q_u8(out + i * 4, vcombine_u8(vrshrn_n_u16(low, 2), vrshrn_n_u16(high, 2)));
+    }
+#endif
+    for (; i < outputCount; i++)
+    {
+        for (size_t c = 0; c < 4; c++)
+        {
+            unsigned sum = row0[i * 8 + c] + row0[i * 8 + 4 + c] + row1[i * 8 + c] + row1[i * 8 + 4 + c];
+            out[i * 4 + c] = static_cast<unsigned char>((sum + 2) / 4);
+        }
+    }
+}
+
+void downsampleImage(DecodedImage* image)
+{
+    assert(image->width > 0 && image->height > 0);
+    if (image->width == 1 && image->height == 1)
+    {
+        return;
+    }
+
+    // a dimension of 1 is kept, by using the same row or column twice
+    int width = std::max(image->width / 2, 1);
+    int height = std::max(image->height / 2, 1);
+    size_t rowSize = image->width * 4;
+
+    std::vector<unsigned char> pixels(width * height * 4);
+    for (int y = 0; y < height; y++)
+    {
+        unsigned char const* row0 = image->pixels.data() + (size_t)(image->height == 1 ? 0 : y * 2) * rowSize;
+        unsigned char const* row1 = image->height == 1 ? row0 : row0 + rowSize;
+        unsigned char* out = pixels.data() + (size_t)y * width * 4;
+        if (image->width == 1)
+        {
+            // average vertically only
+            for (size_t c = 0; c < 4; c++)
+            {
+                out[c] = static_cast<unsigned char>((row0[c] + row1[c] + 1) / 2);
+            }
+            continue;
+        }
+        downsampleRows(row0, row1, out, width);
+    }
+
+    image->width = width;
+    image->height = height;
+    image->pixels = std::move(pixels);
+}
+
+bool readImageSize(unsigned char const* data, size_t size, ImageFormat format, int* outWidth, int* outHeight)
+{
+    switch (format)
+    {
+        case ImageFormat::Jpeg:
+        {
+            tjhandle tjInstance = tjInitDecompress();
+            assert(tjInstance != nullptr);
+            int jpegSubsampling, jpegColorspace;
+            bool success = tjDecompressHeader3(tjInstance, data, size, outWidth, outHeight, &jpegSubsampling, &jpegColorspace) == 0;
+            tj3Destroy(tjInstance);
+            return success;
+        }
+        case ImageFormat::Png:
+        {
+            unsigned w, h;
+            lodepng::State state;
+            if (lodepng_inspect(&w, &h, &state, data, size) != 0)
+            {
+                return false;
+            }
+            *outWidth = (int)w;
+            *outHeight = (int)h;
+            return true;
+        }
+        case ImageFormat::Ktx2: return readKtx2Size(data, size, outWidth, outHeight);
+        case ImageFormat::Unknown: break;
+    }
+    return false;
+}
+
+// returns the largest libjpeg-turbo scaling factor for which both dimensions are at most maxDimension,
+// or the smallest scaling factor if none fit
+[[nodiscard]] static tjscalingfactor getJpegScalingFactor(int width, int height, int maxDimension)
+{
+    int count = 0;
+    tjscalingfactor* factors = tjGetScalingFactors(&count);
+    assert(factors != nullptr && count > 0);
+
+    auto smaller = [](tjscalingfactor lhs, tjscalingfactor rhs) { return lhs.num * rhs.denom < rhs.num * lhs.denom; };
+
+    bool found = false;
+    tjscalingfactor best{1, 1};
+    tjscalingfactor smallest = factors[0];
+    for (int i = 0; i < count; i++)
+    {
+        tjscalingfactor factor = factors[i];
+        if (smaller(factor, smallest))
+        {
+            smallest = factor;
+        }
+        bool fits = TJSCALED(width, factor) <= maxDimension && TJSCALED(height, factor) <= maxDimension;
+        if (fits && (!found || smaller(best, factor)))
+        {
+            best = factor;
+            found = true;
+        }
+    }
+    return found ? best : smallest;
+}
+
+void getDecodedImageSize(int width, int height, ImageFormat format, int maxDimension, int* outWidth, int* outHeight)
+{
+    if (format == ImageFormat::Jpeg && maxDimension > 0)
+    {
+        tjscalingfactor factor = getJpegScalingFactor(width, height, maxDimension);
+        width = TJSCALED(width, factor);
+        height = TJSCALED(height, factor);
+    }
+    for (int i = getDownsampleCount(width, height, maxDimension); i > 0; i--)
+    {
+        width = std::max(width / 2, 1);
+        height = std::max(height / 2, 1);
+    }
+    *outWidth = width;
+    *outHeight = height;
+}
+
+[[nodiscard]] static bool decodeJpeg(unsigned char const* data, size_t size, DecodedImage* outImage, int maxDimension)
+{
+    // a tjhandle is not thread safe, so each call creates its own instance
+    tjhandle tjInstance = tjInitDecompress();
+    assert(tjInstance != nullptr);
+
+    int width, height;
+    int jpegSubsampling, jpegColorspace;
+    if (tjDecompressHeader3(tjInstance, data, size, &width, &height, &jpegSubsampling, &jpegColorspace) < 0)
+    {
+        std::cerr << "Error decompressing JPEG: " << tjGetErrorStr2(tjInstance) << std::endl;
+        tj3Destroy(tjInstance);
+        return false;
+    }
+
+    // decode at a reduced scale, the IDCT then directly outputs fewer pixels
+    if (maxDimension > 0)
+    {
+        tjscalingfactor factor = getJpegScalingFactor(width, height, maxDimension);
+        width = TJSCALED(width, factor);
+        height = TJSCALED(height, factor);
+    }
+
+    outImage->width = width;
+    outImage->height = height;
+    outImage->pixels.resize(width * height * 4); // rgba
+
+    // tjDecompress2 selects the scaling factor based on the given width and height
+    if (tjDecompress2(
+        tjInstance,
+        data,
+        size,
+        outImage->pixels.data(),
+        width,
+        0 /* pitch */,
+        height,
+        TJPF_RGBA,
+        TJFLAG_FASTDCT) < 0)
+    {
+        std::cerr << "Error decompressing JPEG: " << tjGetErrorStr2(tjInstance) << std::endl;
+        tj3Destroy(tjInstance);
+        return false;
+    }
+    tj3Destroy(tjInstance);
+    return true;
+}
+
+[[nodiscard]] static bool decodePng(unsigned char const* data, size_t size, DecodedImage* outImage)
+{
+    lodepng::State state;
+    state.info_raw.bitdepth = 8;
+    state.info_raw.colortype = LodePNGColorType::LCT_RGBA;
+    unsigned w, h;
+    unsigned error = lodepng::decode(outImage->pixels, w, h, state, data, size);
+    if (error != 0)
+    {
+        std::cerr << "Error decoding PNG: " << lodepng_error_text(error) << std::endl;
+        return false;
+    }
+    outImage->width = (int)w;
+    outImage->height = (int)h;
+    return true;
+}
+
+bool decodeImage(unsigned char const* data, size_t size, ImageFormat format, DecodedImage* outImage, int maxDimension)
+{
+    assert(data != nullptr);
+    assert(outImage != nullptr);
+
+    bool success = false;
+    switch (format)
+    {
+        case ImageFormat::Jpeg: success = decodeJpeg(data, size, outImage, maxDimension); break;
+        case ImageFormat::Png: success = decodePng(data, size, outImage); break;
+        case ImageFormat::Ktx2: std::cerr << "ktx2 images should be transcoded, not decoded" << std::endl; break;
+        case ImageFormat::Unknown: std::cerr << "only jpeg and png are supported" << std::endl; break;
+    }
+    if (!success)
+    {
+        return false;
+    }
+
+    // png, or jpeg images that are larger than maxDimension even at the smallest scaling factor
+    for (int i = getDownsampleCount(outImage->width, outImage->height, maxDimension); i > 0; i--)
+    {
+        downsampleImage(outImage);
+    }
+    return true;
+}
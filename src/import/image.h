@@ -0,0 +1,54 @@
+#ifndef METAL_EXPERIMENT_IMAGE_H
+#define METAL_EXPERIMENT_IMAGE_H
+
+#include <cstddef>
+#include <filesystem>
+#include <vector>
+
+enum class ImageFormat
+{
+    Unknown,
+    Jpeg,
+    Png,
+    Ktx2 // KHR_texture_basisu, transcoded to a block compressed format instead of decoded, see ktx2.h
+};
+
+// decoded image, always 8 bits per component rgba
+struct DecodedImage
+{
+    int width = 0;
+    int height = 0;
+    std::vector<unsigned char> pixels;
+};
+
+// returns ImageFormat::Unknown if the mime type is not supported
+[[nodiscard]] ImageFormat imageFormatFromMimeType(char const* mimeType);
+
+// determines the format from the file extension (.jpg, .jpeg, .png, .ktx2)
+// returns ImageFormat::Unknown if the extension is not supported
+[[nodiscard]] ImageFormat imageFormatFromPath(std::filesystem::path const& path);
+
+// reads the dimensions from the image header, without decoding the image
+// returns true when successful
+[[nodiscard]] bool readImageSize(unsigned char const* data, size_t size, ImageFormat format, int* outWidth, int* outHeight);
+
+// decodes the encoded image data into 8 bits per component rgba
+// ktx2 images are not supported, use transcodeKtx2 instead
+// if maxDimension is not 0, the image is scaled down until its width and height are at most maxDimension:
+// jpeg images are decoded directly at a reduced scale (libjpeg-turbo scaling factors),
+// png images are decoded at full resolution and then downsampled by halving (see downsampleImage)
+// returns true when successful
+// thread safe, can be called from multiple threads at the same time
+[[nodiscard]] bool decodeImage(unsigned char const* data, size_t size, ImageFormat format, DecodedImage* outImage, int maxDimension = 0);
+
+// halves the width and height of the image with a 2x2 box filter (rounded to the nearest value)
+// uses NEON when available. odd dimensions are rounded down, the last row / column is then dropped
+void downsampleImage(DecodedImage* image);
+
+// returns the amount of times the dimensions need to be halved so that width and height are at most maxDimension
+[[nodiscard]] int getDownsampleCount(int width, int height, int maxDimension);
+
+// returns the dimensions decodeImage outputs for an image of the given dimensions and maxDimension
+void getDecodedImageSize(int width, int height, ImageFormat format, int maxDimension, int* outWidth, int* outHeight);
+
+#endif //METAL_EXPERIMENT_IMAGE_H
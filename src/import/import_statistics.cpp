@@ -0,0 +1,132 @@
+#include "import_statistics.h"
+
+#include "fmt/format.h"
+
+#include <cassert>
+
+void addImportPhaseSeconds(ImportStatistics* statistics, std::string_view name, double seconds)
+{
+    for (ImportPhase& phase: statistics->phases)
+    {
+        if (phase.name == name)
+        {
+            phase.seconds += seconds;
+            return;
+        }
+    }
+    statistics->phases.emplace_back(ImportPhase{
+        .name = std::string(name),
+        .seconds = seconds
+    });
+}
+
+double secondsSince(ImportClock::time_point start)
+{
+    return std::chrono::duration<double>(ImportClock::now() - start).count();
+}
+
+void addImportPhaseTime(ImportStatistics* statistics, std::string_view name, ImportClock::time_point start)
+{
+    addImportPhaseSeconds(statistics, name, secondsSince(start));
+}
+
+void addScratchMemory(ScratchMemoryTracker* tracker, size_t bytes)
+{
+    size_t current = tracker->current.fetch_add(bytes) + bytes;
+    size_t peak = tracker->peak.load();
+    while (current > peak && !tracker->peak.compare_exchange_weak(peak, current))
+    {
+    }
+}
+
+void removeScratchMemory(ScratchMemoryTracker* tracker, size_t bytes)
+{
+    size_t previous = tracker->current.fetch_sub(bytes);
+    assert(previous >= bytes);
+    (void)previous;
+}
+
+void addScratchArenaUsage(ScratchMemoryTracker* tracker, ScratchArena const* arena)
+{
+    addScratchMemory(tracker, arena->usedSize);
+    removeScratchMemory(tracker, arena->usedSize);
+}
+
+void addScratchArenaStatistics(ImportStatistics* statistics, ScratchArena const* arena)
+{
+    statistics->scratchAllocationCount += arena->allocationCount;
+    statistics->scratchBlockAllocationCount += arena->blockAllocationCount;
+}
+
+std::string escapeJson(std::string_view in)
+{
+    std::string out;
+    out.reserve(in.size());
+    for (char c: in)
+    {
+        if (c == '"' || c == '\\')
+        {
+            out += '\\';
+        }
+        out += c;
+    }
+    return out;
+}
+
+// metrics other than the phases, in output order
+struct ImportMetric
+{
+    char const* name;
+    size_t value;
+};
+
+[[nodiscard]] static std::vector<ImportMetric> getMetrics(ImportStatistics const* statistics)
+{
+    return {
+        {"bytes_read", statistics->bytesRead},
+        {"bytes_decoded", statistics->bytesDecoded},
+        {"vertex_bytes", statistics->vertexBytes},
+        {"index_bytes", statistics->indexBytes},
+        {"texture_bytes", statistics->textureBytes},
+        {"mesh_count", statistics->meshCount},
+        {"primitive_count", statistics->primitiveCount},
+        {"texture_count", statistics->textureCount},
+        {"peak_scratch_bytes", statistics->peakScratchBytes},
+        {"scratch_allocation_count", statistics->scratchAllocationCount},
+        {"scratch_block_allocation_count", statistics->scratchBlockAllocationCount},
+    };
+}
+
+std::string importStatisticsToJson(ImportStatistics const* statistics)
+{
+    std::string out = "{";
+    out += fmt::format("\"total_seconds\":{:.6f}", statistics->totalSeconds);
+    for (ImportMetric const& metric: getMetrics(statistics))
+    {
+        out += fmt::format(",\"{}\":{}", metric.name, metric.value);
+    }
+    out += ",\"phases\":[";
+    for (size_t i = 0; i < statistics->phases.size(); i++)
+    {
+        ImportPhase const& phase = statistics->phases[i];
+        out += fmt::format("{}{{\"name\":\"{}\",\"seconds\":{:.6f}}}", i > 0 ? "," : "", escapeJson(phase.name), phase.seconds);
+    }
+    out += "]}";
+    return out;
+}
+
+std::string importStatisticsToCsv(ImportStatistics const* statistics)
+{
+    std::string out = "metric,value\n";
+    out += fmt::format("total_seconds,{:.6f}\n", statistics->totalSeconds);
+    for (ImportMetric const& metric: getMetrics(statistics))
+    {
+        out += fmt::format("{},{}\n", metric.name, metric.value);
+    }
+    for (ImportPhase const& phase: statistics->phases)
+    {
+        // phase names don't contain commas or quotes
+        out += fmt::format("time.{},{:.6f}\n", phase.name, phase.seconds);
+    }
+    return out;
+}
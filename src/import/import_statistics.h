@@ -0,0 +1,84 @@
+#ifndef METAL_EXPERIMENT_IMPORT_STATISTICS_H
+#define METAL_EXPERIMENT_IMPORT_STATISTICS_H
+
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "scratch_arena.h"
+
+using ImportClock = std::chrono::steady_clock;
+
+struct ImportPhase
+{
+    std::string name;
+    double seconds = 0.0;
+};
+
+// telemetry of a single import (gltf or ifc), to find out which part of the import pipeline is slow for a given file
+struct ImportStatistics
+{
+    // wall time per phase, in the order the phases were first reported
+    // phases that run on worker threads (e.g. image decoding) are summed over all threads, and overlap with other phases
+    std::vector<ImportPhase> phases;
+    double totalSeconds = 0.0;
+
+    size_t bytesRead = 0; // read from disk or memory mapped (files, buffers, images)
+    size_t bytesDecoded = 0; // output of decompression (EXT_meshopt_compression, base64, jpeg / png)
+
+    // uploaded to the GPU
+    size_t vertexBytes = 0;
+    size_t indexBytes = 0;
+    size_t textureBytes = 0;
+
+    size_t meshCount = 0;
+    size_t primitiveCount = 0;
+    size_t textureCount = 0;
+
+    // largest amount of temporary CPU memory that was in use at the same time, see ScratchMemoryTracker
+    size_t peakScratchBytes = 0;
+
+    // per element / primitive temporaries, see ScratchArena
+    size_t scratchAllocationCount = 0; // allocations served from scratch arenas
+    size_t scratchBlockAllocationCount = 0; // heap allocations made by the scratch arenas
+};
+
+// adds the time between start and now to the phase with the given name, creates the phase if it doesn't exist
+void addImportPhaseTime(ImportStatistics* statistics, std::string_view name, ImportClock::time_point start);
+
+void addImportPhaseSeconds(ImportStatistics* statistics, std::string_view name, double seconds);
+
+[[nodiscard]] double secondsSince(ImportClock::time_point start);
+
+// tracks the amount of temporary CPU memory in use during an import, thread safe
+struct ScratchMemoryTracker
+{
+    std::atomic<size_t> current = 0;
+    std::atomic<size_t> peak = 0;
+};
+
+void addScratchMemory(ScratchMemoryTracker* tracker, size_t bytes);
+
+void removeScratchMemory(ScratchMemoryTracker* tracker, size_t bytes);
+
+// reports the current usage of the arena to the tracker, should be called right before the arena is reset,
+// as that is when its usage is highest
+void addScratchArenaUsage(ScratchMemoryTracker* tracker, ScratchArena const* arena);
+
+// adds the allocation counts of the arena to the statistics
+void addScratchArenaStatistics(ImportStatistics* statistics, ScratchArena const* arena);
+
+// escapes quotes and backslashes for use in a json string, the input should not contain control characters
+// (e.g. phase and file names)
+[[nodiscard]] std::string escapeJson(std::string_view in);
+
+// single json object, phases are an array of {"name", "seconds"} objects
+[[nodiscard]] std::string importStatisticsToJson(ImportStatistics const* statistics);
+
+// two columns (metric,value) with a header row, phase times are named "time.<phase name>"
+[[nodiscard]] std::string importStatisticsToCsv(ImportStatistics const* statistics);
+
+#endif //METAL_EXPERIMENT_IMPORT_STATISTICS_H
@@ -0,0 +1,131 @@
+#include "ktx2.h"
+
+#include "basisu_transcoder.h"
+
+#include <algorithm>
+#include <cassert>
+#include <cstdint>
+#include <cstring>
+#include <iostream>
+#include <mutex>
+
+// «KTX 20»\r\n\x1A\n
+constexpr unsigned char ktx2Identifier[12] = {0xAB, 0x4B, 0x54, 0x58, 0x20, 0x32, 0x30, 0xBB, 0x0D, 0x0A, 0x1A, 0x0A};
+
+// offsets of the fields in the KTX2 header
+constexpr size_t ktx2PixelWidthOffset = 20;
+constexpr size_t ktx2PixelHeightOffset = 24;
+constexpr size_t ktx2HeaderSize = 80;
+
+[[nodiscard]] static uint32_t readUInt32(unsigned char const* data)
+{
+    // KTX2 is little endian, as are all platforms this runs on
+    uint32_t value;
+    memcpy(&value, data, sizeof(uint32_t));
+    return value;
+}
+
+bool readKtx2Size(unsigned char const* data, size_t size, int* outWidth, int* outHeight)
+{
+    if (size < ktx2HeaderSize || memcmp(data, ktx2Identifier, sizeof(ktx2Identifier)) != 0)
+    {
+        return false;
+    }
+    *outWidth = (int)readUInt32(data + ktx2PixelWidthOffset);
+    *outHeight = std::max((int)readUInt32(data + ktx2PixelHeightOffset), 1); // 0 for 1D textures
+    return *outWidth > 0;
+}
+
+[[nodiscard]] static basist::transcoder_texture_format getTranscoderFormat(CompressedTextureFormat format)
+{
+    switch (format)
+    {
+        //@formatter:off
+        case CompressedTextureFormat::BC7: return basist::transcoder_texture_format::cTFBC7_RGBA;
+        case CompressedTextureFormat::Astc4x4: return basist::transcoder_texture_format::cTFASTC_4x4_RGBA;
+        case CompressedTextureFormat::Etc2: return basist::transcoder_texture_format::cTFETC2_RGBA;
+        //@formatter:on
+    }
+    assert(false);
+    return basist::transcoder_texture_format::cTFBC7_RGBA;
+}
+
+// the global tables of the transcoder are initialized once, for all threads
+static void initializeTranscoder()
+{
+    static std::once_flag flag;
+    std::call_once(flag, []() { basist::basisu_transcoder_init(); });
+}
+
+bool transcodeKtx2(unsigned char const* data, size_t size, CompressedTextureFormat format, TranscodedImage* outImage, int maxDimension)
+{
+    assert(data != nullptr);
+    assert(outImage != nullptr);
+    initializeTranscoder();
+
+    // a ktx2_transcoder is not thread safe, so each call creates its own instance
+    basist::ktx2_transcoder transcoder;
+    if (!transcoder.init(data, (uint32_t)size))
+    {
+        std::cerr << "invalid KTX2 file" << std::endl;
+        return false;
+    }
+    if (transcoder.get_faces() != 1 || transcoder.get_layers() > 1)
+    {
+        std::cerr << "only KTX2 files with a single 2D image are supported, using the first face / layer" << std::endl;
+    }
+    if (!transcoder.start_transcoding())
+    {
+        std::cerr << "failed to start transcoding KTX2 file" << std::endl;
+        return false;
+    }
+
+    // skip levels that are too large
+    uint32_t levelCount = std::max(transcoder.get_levels(), 1u);
+    uint32_t firstLevel = 0;
+    if (maxDimension > 0)
+    {
+        while (firstLevel + 1 < levelCount)
+        {
+            basist::ktx2_image_level_info info{};
+            if (!transcoder.get_image_level_info(info, firstLevel, 0, 0))
+            {
+                return false;
+            }
+            if ((int)info.m_orig_width <= maxDimension && (int)info.m_orig_height <= maxDimension)
+            {
+                break;
+            }
+            firstLevel++;
+        }
+    }
+
+    basist::transcoder_texture_format transcoderFormat = getTranscoderFormat(format);
+    assert(basist::basis_get_bytes_per_block_or_pixel(transcoderFormat) == compressedBlockSize);
+
+    outImage->format = format;
+    outImage->levels.clear();
+    outImage->levels.reserve(levelCount - firstLevel);
+    for (uint32_t level = firstLevel; level < levelCount; level++)
+    {
+        basist::ktx2_image_level_info info{};
+        if (!transcoder.get_image_level_info(info, level, 0, 0))
+        {
+            return false;
+        }
+
+        TranscodedImageLevel* outLevel = &outImage->levels.emplace_back();
+        outLevel->width = (int)info.m_orig_width;
+        outLevel->height = (int)info.m_orig_height;
+        outLevel->blockCountX = info.m_num_blocks_x;
+        outLevel->blockCountY = info.m_num_blocks_y;
+        outLevel->blocks.resize(info.m_total_blocks * compressedBlockSize);
+
+        if (!transcoder.transcode_image_level(level, 0, 0, outLevel->blocks.data(), info.m_total_blocks, transcoderFormat))
+        {
+            std::cerr << "failed to transcode KTX2 level " << level << std::endl;
+            return false;
+        }
+    }
+    return true;
+}
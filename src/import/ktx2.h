@@ -0,0 +1,47 @@
+#ifndef METAL_EXPERIMENT_KTX2_H
+#define METAL_EXPERIMENT_KTX2_H
+
+#include <cstddef>
+#include <vector>
+
+// GPU block compressed formats that KTX2 / Basis Universal images are transcoded to
+// all use 4x4 blocks of 16 bytes (1 byte per pixel) and contain an alpha channel
+enum class CompressedTextureFormat
+{
+    BC7, // desktop GPUs
+    Astc4x4, // Apple and mobile GPUs
+    Etc2 // fallback for mobile GPUs without ASTC (ETC2 rgb + EAC alpha)
+};
+
+constexpr size_t compressedBlockDimension = 4;
+constexpr size_t compressedBlockSize = 16;
+
+struct TranscodedImageLevel
+{
+    int width = 0;
+    int height = 0;
+    size_t blockCountX = 0;
+    size_t blockCountY = 0;
+    std::vector<unsigned char> blocks;
+};
+
+// KTX2 image transcoded to a block compressed format, levels are ordered from largest to smallest
+struct TranscodedImage
+{
+    CompressedTextureFormat format = CompressedTextureFormat::BC7;
+    std::vector<TranscodedImageLevel> levels;
+};
+
+// reads the dimensions of the base level from the KTX2 header, without initializing the transcoder
+// returns true when successful
+[[nodiscard]] bool readKtx2Size(unsigned char const* data, size_t size, int* outWidth, int* outHeight);
+
+// transcodes the first layer / face of a KTX2 file (ETC1S or UASTC supercompressed) to the given format
+// if maxDimension is not 0, mip levels larger than maxDimension are skipped. when the file contains no level that
+// is small enough, only the smallest level is transcoded
+// returns true when successful
+// thread safe, can be called from multiple threads at the same time
+[[nodiscard]] bool transcodeKtx2(
+    unsigned char const* data, size_t size, CompressedTextureFormat format, TranscodedImage* outImage, int maxDimension = 0);
+
+#endif //METAL_EXPERIMENT_KTX2_H
@@ -27,6 +27,7 @@
 #include "procedural_mesh.h"
 #include "import/gltf.h"
 #include "import/ifc.h"
+#include "occlusion_culling.h"
 
 #define SHADER_BINDINGS_MAIN
 
@@ -37,6 +38,8 @@
 #include "glm/gtx/transform.hpp"
 #include "glm/gtx/quaternion.hpp"
 
+#include <algorithm>
+#include <array>
 #include <stack>
 
 struct App;
@@ -250,11 +253,17 @@ struct AppConfig
     MTLClearColor clearColor;
     std::filesystem::path assetsPath;
     std::filesystem::path privateAssetsPath;
+    std::filesystem::path cachePath; // generated data that can be deleted at any time, e.g. tessellated ifc files
     std::string fontCharacterMap;
     float cameraFov;
     float cameraNear;
     float cameraFar;
     uint32_t shadowMapSize;
+    size_t ifcElementsPerFrame; // maximum amount of elements added to each streamed ifc model per frame
+    float lodMaxPixelError; // the coarsest level of detail of a mesh is drawn whose simplification error is below this on screen
+    bool occlusionCulling; // skip ifc elements that are hidden behind the occluders of walls, slabs and roofs
+    uint32_t occlusionBufferWidth; // of the CPU depth buffer the occluders are rasterized into, the height follows the aspect ratio
+    size_t occluderTriangleBudget; // maximum amount of occluder triangles rasterized per frame, closest occluders first
 
     // experiments
     bool terrain;
@@ -366,6 +375,12 @@ struct Transform
     return translation * rotation * scale;
 }
 
+// amount of frames the CPU can encode ahead of the GPU, each frame in flight has its own transient buffers
+constexpr size_t maxFramesInFlight = 3;
+
+// initial size of the per-frame buffer for instance data that doesn't fit in setVertexBytes
+constexpr size_t frameInstanceArenaBlockSize = 1024 * 1024;
+
 struct App
 {
     AppConfig* config;
@@ -383,6 +398,11 @@ struct App
     id <MTLCommandQueue> commandQueue;
     id <MTLDepthStencilState> depthStencilStateDefault;
 
+    // transient instance data of each frame in flight, reset when the command buffers of that frame have completed
+    std::array<BufferArena, maxFramesInFlight> frameInstanceArenas;
+    size_t frameIndex = 0;
+    dispatch_semaphore_t frameSemaphore; // signaled when a frame in flight has completed
+
     // shaders
     id <MTLRenderPipelineState> shaderClearDepth;
     id <MTLRenderPipelineState> shaderShadow;
@@ -394,6 +414,7 @@ struct App
     id <MTLRenderPipelineState> shaderUnlitColored; // simplest shader possible, only uses the color
     id <MTLRenderPipelineState> shaderPbr; // OpenPbr Surface implementation from https://academysoftwarefoundation.github.io/OpenPbr/
     id <MTLRenderPipelineState> shaderPbrWithMaps;
+    std::unordered_map<uint32_t, id <MTLRenderPipelineState>> shaderPbrVariants; // for quantized vertex formats, see getPbrShader
 
     // for clearing the depth buffer (https://stackoverflow.com/questions/58964035/in-metal-how-to-clear-the-depth-buffer-or-the-stencil-buffer)
     id <MTLDepthStencilState> depthStencilStateClear;
@@ -469,12 +490,26 @@ struct App
     model::Model gltfVrLoftLivingRoomBaked{};
     model::Model gltfUgv{}; // https://sketchfab.com/3d-models/the-d-21-multi-missions-ugv-ebe40dc504a145d0909310e124334420
 
+    // gltf models are imported in the background and filled in while rendering
+    GltfImport gltfCathedralImport;
+    GltfImport gltfVrLoftLivingRoomBakedImport;
+    GltfImport gltfUgvImport;
+
     // ifc models
     model::Model ifcFzkHaus{};
     model::Model ifcInstituteVar2{};
     model::Model ifcAiscSculptureBrep{};
     model::Model ifcTableChairs{};
 
+    // ifc models are streamed in the background, elements are added to the model while rendering
+    IfcImport ifcFzkHausImport;
+    IfcImport ifcInstituteVar2Import;
+    IfcImport ifcAiscSculptureBrepImport;
+    IfcImport ifcTableChairsImport;
+
+    // occluders of the ifc models, rasterized each frame before the main pass
+    OcclusionBuffer occlusionBuffer;
+
     // silly periodic timer
     float time = 0.0f;
 
@@ -643,6 +678,88 @@ id <MTLRenderPipelineState> createShader(
     return renderPipelineState;
 }
 
+// vertex_format for each vertex attribute that the pbr vertex shader reads
+struct PbrVertexFormats
+{
+    int position = vertex_format::float32;
+    int normal = vertex_format::float32;
+    int tangent = vertex_format::float32;
+    int uv0 = vertex_format::float32;
+    bool octahedralNormal = false; // normal has 2 components, see encodeOctahedral
+};
+
+[[nodiscard]] int getVertexFormat(VertexAttribute const* attribute)
+{
+    //@formatter:off
+    switch (attribute->componentType)
+    {
+        case VertexComponentType::Float32: return vertex_format::float32;
+        case VertexComponentType::Int8: return attribute->normalized ? vertex_format::int8Normalized : vertex_format::int8;
+        case VertexComponentType::UInt8: return attribute->normalized ? vertex_format::uint8Normalized : vertex_format::uint8;
+        case VertexComponentType::Int16: return attribute->normalized ? vertex_format::int16Normalized : vertex_format::int16;
+        case VertexComponentType::UInt16: return attribute->normalized ? vertex_format::uint16Normalized : vertex_format::uint16;
+    }
+    //@formatter:on
+    return vertex_format::float32;
+}
+
+[[nodiscard]] PbrVertexFormats getPbrVertexFormats(PrimitiveDeinterleaved const* primitive)
+{
+    PbrVertexFormats formats{};
+    for (VertexAttribute const& attribute: primitive->attributes)
+    {
+        //@formatter:off
+        switch (attribute.type)
+        {
+            case VertexAttributeType::Position: formats.position = getVertexFormat(&attribute); break;
+            case VertexAttributeType::Normal: formats.normal = getVertexFormat(&attribute); formats.octahedralNormal = attribute.componentCount == 2; break;
+            case VertexAttributeType::Tangent: formats.tangent = getVertexFormat(&attribute); break;
+            case VertexAttributeType::TextureCoordinate: formats.uv0 = getVertexFormat(&attribute); break;
+            default: break;
+        }
+        //@formatter:on
+    }
+    return formats;
+}
+
+id <MTLRenderPipelineState> createPbrShader(App* app, bool hasMaps, PbrVertexFormats formats)
+{
+    MTLFunctionConstantValues* vertexConstants = [[MTLFunctionConstantValues alloc] init];
+    [vertexConstants setConstantValue:&formats.position type:MTLDataTypeInt atIndex:binding_constant::positionFormat];
+    [vertexConstants setConstantValue:&formats.normal type:MTLDataTypeInt atIndex:binding_constant::normalFormat];
+    [vertexConstants setConstantValue:&formats.tangent type:MTLDataTypeInt atIndex:binding_constant::tangentFormat];
+    [vertexConstants setConstantValue:&formats.uv0 type:MTLDataTypeInt atIndex:binding_constant::uv0Format];
+    [vertexConstants setConstantValue:&formats.octahedralNormal type:MTLDataTypeBool atIndex:binding_constant::octahedralNormal];
+
+    MTLFunctionConstantValues* fragmentConstants = [[MTLFunctionConstantValues alloc] init];
+    [fragmentConstants setConstantValue:&hasMaps type:MTLDataTypeBool atIndex:binding_constant::hasBaseColorMap];
+    [fragmentConstants setConstantValue:&hasMaps type:MTLDataTypeBool atIndex:binding_constant::hasNormalMap];
+    [fragmentConstants setConstantValue:&hasMaps type:MTLDataTypeBool atIndex:binding_constant::hasMetallicRoughnessMap];
+
+    return createShader(app, @"pbr_vertex", @"pbr_fragment", vertexConstants, fragmentConstants, ShaderFeatureFlags_None);
+}
+
+// returns the pbr shader variant for the vertex formats of the primitive, variants are created on first use
+id <MTLRenderPipelineState> getPbrShader(App* app, bool hasMaps, PrimitiveDeinterleaved const* primitive)
+{
+    PbrVertexFormats formats = getPbrVertexFormats(primitive);
+    uint32_t key = (hasMaps ? 1 : 0) | formats.position << 1 | formats.normal << 5 | formats.tangent << 9 | formats.uv0 << 13 | (formats.octahedralNormal ? 1 : 0) << 17;
+    if ((key >> 1) == 0)
+    {
+        // all float
+        return hasMaps ? app->shaderPbrWithMaps : app->shaderPbr;
+    }
+
+    auto it = app->shaderPbrVariants.find(key);
+    if (it != app->shaderPbrVariants.end())
+    {
+        return it->second;
+    }
+    id <MTLRenderPipelineState> shader = createPbrShader(app, hasMaps, formats);
+    app->shaderPbrVariants[key] = shader;
+    return shader;
+}
+
 id <MTLTexture> importTexture(id <MTLDevice> device, std::filesystem::path const& path)
 {
     assert(std::filesystem::exists(path));
@@ -1010,6 +1127,15 @@ void onLaunch(App* app)
         [commandQueue retain];
     }
 
+    // create transient buffers per frame in flight
+    {
+        for (BufferArena& arena: app->frameInstanceArenas)
+        {
+            createBufferArena(app->device, frameInstanceArenaBlockSize, &arena);
+        }
+        app->frameSemaphore = dispatch_semaphore_create(maxFramesInFlight);
+    }
+
     // create default depth stencil state
     {
         MTLDepthStencilDescriptor* descriptor = [[MTLDepthStencilDescriptor alloc] init];
@@ -1094,20 +1220,10 @@ void onLaunch(App* app)
         app->shaderUnlitColored = createShader(app, @"unlit_vertex", @"unlit_colored_fragment", nullptr, nullptr, ShaderFeatureFlags_None);
 
 
-        // PBR
+        // PBR (float vertex formats, variants for quantized vertex formats are created on first use)
         {
-            MTLFunctionConstantValues* hasMaps = [[MTLFunctionConstantValues alloc] init];
-            [hasMaps setConstantValue:&true_ type:MTLDataTypeBool atIndex:binding_constant::hasBaseColorMap];
-            [hasMaps setConstantValue:&true_ type:MTLDataTypeBool atIndex:binding_constant::hasNormalMap];
-            [hasMaps setConstantValue:&true_ type:MTLDataTypeBool atIndex:binding_constant::hasMetallicRoughnessMap];
-
-            MTLFunctionConstantValues* doesNotHaveMaps = [[MTLFunctionConstantValues alloc] init];
-            [doesNotHaveMaps setConstantValue:&false_ type:MTLDataTypeBool atIndex:binding_constant::hasBaseColorMap];
-            [doesNotHaveMaps setConstantValue:&false_ type:MTLDataTypeBool atIndex:binding_constant::hasNormalMap];
-            [doesNotHaveMaps setConstantValue:&false_ type:MTLDataTypeBool atIndex:binding_constant::hasMetallicRoughnessMap];
-
-            app->shaderPbrWithMaps = createShader(app, @"pbr_vertex", @"pbr_fragment", nullptr, hasMaps, ShaderFeatureFlags_None);
-            app->shaderPbr = createShader(app, @"pbr_vertex", @"pbr_fragment", nullptr, doesNotHaveMaps, ShaderFeatureFlags_None);
+            app->shaderPbrWithMaps = createPbrShader(app, true, PbrVertexFormats{});
+            app->shaderPbr = createPbrShader(app, false, PbrVertexFormats{});
         }
     }
 
@@ -1204,8 +1320,8 @@ void onLaunch(App* app)
         MTLPrimitiveType primitiveType;
         createTerrain(RectMinMaxf{-30, -30, 30, 30}, 2000, 2000, &positions, &indices, &primitiveType);
         PrimitiveDeinterleavedDescriptor descriptor{
-            .positions = &positions,
-            .indices = &indices,
+            .positions = positions,
+            .indices = indices,
             .primitiveType = primitiveType
         };
         app->meshTerrain = createPrimitiveDeinterleaved(app->device, &descriptor);
@@ -1243,41 +1359,29 @@ void onLaunch(App* app)
         app->textureShrub = importTexture(app->device, app->config->assetsPath / "textures" / "shrub.png");
     }
 
-    // import gltfs
+    // import gltfs (asynchronously, see updateGltfImports)
     if (app->config->gltf)
     {
-        bool success;
-
-        success = importGltf(app->device, app->config->privateAssetsPath / "gltf" / "the_d-21_multi-missions_ugv.glb", &app->gltfUgv);
-        assert(success);
-
-        success = importGltf(app->device, app->config->assetsPath / "gltf" / "cathedral.glb", &app->gltfCathedral);
-        assert(success);
-
-        success = importGltf(app->device, app->config->privateAssetsPath / "gltf" / "vr_loft__living_room__baked.glb", &app->gltfVrLoftLivingRoomBaked);
-        assert(success);
+        GltfImportSettings settings{};
+        startGltfImport(app->device, app->config->privateAssetsPath / "gltf" / "the_d-21_multi-missions_ugv.glb", settings, &app->gltfUgvImport);
+        startGltfImport(app->device, app->config->assetsPath / "gltf" / "cathedral.glb", settings, &app->gltfCathedralImport);
+        startGltfImport(app->device, app->config->privateAssetsPath / "gltf" / "vr_loft__living_room__baked.glb", settings, &app->gltfVrLoftLivingRoomBakedImport);
     }
 
-    // import ifc files, if ifc
+    // import ifc files (asynchronously, see updateIfcImports), if ifc
     if (app->config->ifc)
     {
-        bool success;
-
         IfcImportSettings settings{
-            .flipYAndZAxes = true
+            .flipYAndZAxes = true,
+            .quantizeVertices = true,
+            .generateOccluders = true,
+            .cacheDirectory = app->config->cachePath / "ifc"
         };
 
-        success = importIfc(app->device, app->config->assetsPath / "ifc" / "AC20-FZK-Haus.ifc", &app->ifcFzkHaus, settings);
-        assert(success);
-
-        success = importIfc(app->device, app->config->assetsPath / "ifc" / "AC20-Institute-Var-2.ifc", &app->ifcInstituteVar2, settings);
-        assert(success);
-
-        success = importIfc(app->device, app->config->assetsPath / "ifc" / "aisc_sculpture_brep.ifc", &app->ifcAiscSculptureBrep, settings);
-        assert(success);
-
-        success = importIfc(app->device, app->config->assetsPath / "ifc" / "Tabel_Chairs.ifc", &app->ifcTableChairs, settings);
-        assert(success);
+        startIfcImport(app->device, app->config->assetsPath / "ifc" / "AC20-FZK-Haus.ifc", settings, &app->ifcFzkHausImport);
+        startIfcImport(app->device, app->config->assetsPath / "ifc" / "AC20-Institute-Var-2.ifc", settings, &app->ifcInstituteVar2Import);
+        startIfcImport(app->device, app->config->assetsPath / "ifc" / "aisc_sculpture_brep.ifc", settings, &app->ifcAiscSculptureBrepImport);
+        startIfcImport(app->device, app->config->assetsPath / "ifc" / "Tabel_Chairs.ifc", settings, &app->ifcTableChairsImport);
     }
 
     // create brdf lookup texture (same for all skyboxes)
@@ -1341,7 +1445,74 @@ void onLaunch(App* app)
 
 void onTerminate(App* app)
 {
+    if (app->config->gltf)
+    {
+        GltfImport* imports[] = {&app->gltfUgvImport, &app->gltfCathedralImport, &app->gltfVrLoftLivingRoomBakedImport};
+        for (GltfImport* import: imports)
+        {
+            cancelGltfImport(import);
+        }
+        for (GltfImport* import: imports)
+        {
+            finishGltfImport(import);
+        }
+    }
+
+    if (app->config->ifc)
+    {
+        IfcImport* imports[] = {&app->ifcFzkHausImport, &app->ifcInstituteVar2Import, &app->ifcAiscSculptureBrepImport, &app->ifcTableChairsImport};
+        for (IfcImport* import: imports)
+        {
+            cancelIfcImport(import);
+        }
+        for (IfcImport* import: imports)
+        {
+            finishIfcImport(import);
+        }
+    }
+}
+
+// logs the path of an import that finished without succeeding, only once
+template<typename Import>
+void reportImportFailure(bool finished, Import* import)
+{
+    if (finished && !import->succeeded && !import->reportedFailure)
+    {
+        std::cout << "failed to import " << import->path << std::endl;
+        import->reportedFailure = true;
+    }
+}
+
+// applies the meshes, materials and textures that were imported since the last frame
+void updateGltfImports(App* app)
+{
+    std::pair<GltfImport*, model::Model*> imports[] = {
+        {&app->gltfUgvImport, &app->gltfUgv},
+        {&app->gltfCathedralImport, &app->gltfCathedral},
+        {&app->gltfVrLoftLivingRoomBakedImport, &app->gltfVrLoftLivingRoomBaked},
+    };
+    for (auto [import, model]: imports)
+    {
+        bool finished = updateGltfImport(import, model);
+        reportImportFailure(finished, import);
+    }
+}
 
+// adds a limited amount of the ifc elements that were imported since the last frame, so that a frame is never stalled
+void updateIfcImports(App* app)
+{
+    size_t maxElementCount = app->config->ifcElementsPerFrame;
+    std::pair<IfcImport*, model::Model*> imports[] = {
+        {&app->ifcFzkHausImport, &app->ifcFzkHaus},
+        {&app->ifcInstituteVar2Import, &app->ifcInstituteVar2},
+        {&app->ifcAiscSculptureBrepImport, &app->ifcAiscSculptureBrep},
+        {&app->ifcTableChairsImport, &app->ifcTableChairs},
+    };
+    for (auto [import, model]: imports)
+    {
+        bool finished = updateIfcImport(import, model, maxElementCount);
+        reportImportFailure(finished, import);
+    }
 }
 
 void addQuad(std::vector<Image2dVertexData>* vertices, RectMinMaxf position, RectMinMaxf uv)
@@ -1425,33 +1596,56 @@ void clearDepthBuffer(App* app, id <MTLRenderCommandEncoder> encoder)
     [encoder drawPrimitives:MTLPrimitiveTypeTriangleStrip vertexStart:0 vertexCount:4];
 }
 
-void bindPrimitiveAttributes(id <MTLRenderCommandEncoder> encoder, PrimitiveDeinterleaved const* mesh)
+// vertex buffers that are currently bound to the encoder
+// primitives that share a vertex buffer (e.g. from the same model) only need to update the offsets
+struct VertexBufferBindings
+{
+    id <MTLBuffer> positions = nil;
+    id <MTLBuffer> normals = nil;
+    id <MTLBuffer> tangents = nil;
+    id <MTLBuffer> uv0s = nil;
+    id <MTLBuffer> colors = nil;
+};
+
+void bindPrimitiveAttributes(id <MTLRenderCommandEncoder> encoder, PrimitiveDeinterleaved const* mesh, VertexBufferBindings* bindings = nullptr)
 {
     // bind vertex attributes
-    size_t offset = 0;
+    size_t offset = mesh->vertexBufferOffset;
     for (auto& attribute: mesh->attributes)
     {
         int index = 0;
+        id <MTLBuffer>* bound = nullptr;
         //@formatter:off
         switch (attribute.type)
         {
-            case VertexAttributeType::Position: index = binding_vertex::positions; break;
-            case VertexAttributeType::Normal: index = binding_vertex::normals; break;
-            case VertexAttributeType::Tangent: index = binding_vertex::tangents; break;
-            case VertexAttributeType::TextureCoordinate: index = binding_vertex::uv0s; break;
-            case VertexAttributeType::Color: index = binding_vertex::colors; break;
+            case VertexAttributeType::Position: index = binding_vertex::positions; bound = bindings ? &bindings->positions : nullptr; break;
+            case VertexAttributeType::Normal: index = binding_vertex::normals; bound = bindings ? &bindings->normals : nullptr; break;
+            case VertexAttributeType::Tangent: index = binding_vertex::tangents; bound = bindings ? &bindings->tangents : nullptr; break;
+            case VertexAttributeType::TextureCoordinate: index = binding_vertex::uv0s; bound = bindings ? &bindings->uv0s : nullptr; break;
+            case VertexAttributeType::Color: index = binding_vertex::colors; bound = bindings ? &bindings->colors : nullptr; break;
             case VertexAttributeType::Joints: assert(false);
             case VertexAttributeType::Weights: assert(false);
         }
         //@formatter:on
-        [encoder setVertexBuffer:mesh->vertexBuffer offset:offset atIndex:index];
+        if (bound && *bound == mesh->vertexBuffer)
+        {
+            [encoder setVertexBufferOffset:offset atIndex:index];
+        }
+        else
+        {
+            [encoder setVertexBuffer:mesh->vertexBuffer offset:offset atIndex:index];
+            if (bound)
+            {
+                *bound = mesh->vertexBuffer;
+            }
+        }
         offset += attribute.size;
     }
 }
 
-void drawPrimitive(id <MTLRenderCommandEncoder> encoder, PrimitiveDeinterleaved const* mesh, uint32_t instanceCount)
+void drawPrimitive(id <MTLRenderCommandEncoder> encoder, PrimitiveDeinterleaved const* mesh, uint32_t instanceCount, VertexBufferBindings* bindings = nullptr, uint32_t baseInstance = 0)
 {
-    bindPrimitiveAttributes(encoder, mesh);
+    bindPrimitiveAttributes(encoder, mesh, bindings);
     if (mesh->indexed)
     {
         [encoder
@@ -1459,10 +1653,10 @@ void drawPrimitive(id <MTLRenderCommandEncoder> encoder, PrimitiveDeinterleaved
             indexCount:mesh->indexCount
             indexType:mesh->indexType
             indexBuffer:mesh->indexBuffer
-            indexBufferOffset:0
+            indexBufferOffset:mesh->indexBufferOffset
             instanceCount:instanceCount
             baseVertex:0
-            baseInstance:0];
+            baseInstance:baseInstance];
     }
     else
     {
@@ -1471,10 +1665,28 @@ void drawPrimitive(id <MTLRenderCommandEncoder> encoder, PrimitiveDeinterleaved
             vertexStart:0
             vertexCount:mesh->vertexCount
             instanceCount:instanceCount
-            baseInstance:0];
+            baseInstance:baseInstance];
     }
 }
 
+// draws a range of the indices of an indexed primitive, e.g. a level of detail
+// the offset of the range is relative to the indexBufferOffset of the primitive
+void drawPrimitiveIndexRange(id <MTLRenderCommandEncoder> encoder, PrimitiveDeinterleaved const* mesh, IndexRange range, uint32_t instanceCount, VertexBufferBindings* bindings = nullptr, uint32_t baseInstance = 0)
+{
+    assert(mesh->indexed);
+    size_t indexSize = mesh->indexType == MTLIndexTypeUInt16 ? sizeof(uint16_t) : sizeof(uint32_t);
+    bindPrimitiveAttributes(encoder, mesh, bindings);
+    [encoder
+        drawIndexedPrimitives:mesh->primitiveType
+        indexCount:range.count
+        indexType:mesh->indexType
+        indexBuffer:mesh->indexBuffer
+        indexBufferOffset:mesh->indexBufferOffset + range.offset * indexSize
+        instanceCount:instanceCount
+        baseVertex:0
+        baseInstance:baseInstance];
+}
+
 void drawPrimitiveInstance(id <MTLRenderCommandEncoder> encoder, PrimitiveDeinterleaved const* mesh, InstanceData* instance)
 {
     [encoder setVertexBytes:instance length:sizeof(InstanceData) atIndex:binding_vertex::instanceData];
@@ -1528,12 +1740,89 @@ void setPbrInstanceData(App const* app, id <MTLRenderCommandEncoder> encoder, Pb
     [encoder setVertexBytes:&data length:sizeof(PbrInstanceData) atIndex:binding_vertex::instanceData];
 }
 
+// sets the instance data of all instances that are drawn next (see baseInstance in drawPrimitive)
+void setPbrInstances(App* app, id <MTLRenderCommandEncoder> encoder, std::vector<PbrInstanceData> const* instances)
+{
+    // setVertexBytes is limited to 4 KB, larger instance data is sub-allocated from the transient buffer of this frame
+    size_t size = sizeof(PbrInstanceData) * instances->size();
+    if (size <= 4096)
+    {
+        [encoder setVertexBytes:instances->data() length:size atIndex:binding_vertex::instanceData];
+    }
+    else
+    {
+        // buffer offsets in the constant address space should be a multiple of 256 bytes on macOS
+        BufferArenaAllocation allocation = allocateFromBufferArena(&app->frameInstanceArenas[app->frameIndex], size, 256);
+        memcpy(allocation.data, instances->data(), size);
+        [encoder setVertexBuffer:allocation.buffer offset:allocation.offset atIndex:binding_vertex::instanceData];
+    }
+}
+
+[[nodiscard]] bool hasSamePbrVertexFormats(PrimitiveDeinterleaved const* lhs, PrimitiveDeinterleaved const* rhs)
+{
+    PbrVertexFormats a = getPbrVertexFormats(lhs);
+    PbrVertexFormats b = getPbrVertexFormats(rhs);
+    return a.position == b.position && a.normal == b.normal && a.tangent == b.tangent && a.uv0 == b.uv0 && a.octahedralNormal == b.octahedralNormal;
+}
+
 struct ModelDfsData
 {
     model::Node* node;
     glm::mat4 localToWorld; // calculated
 };
 
+// node of the model that references a mesh, with its calculated transform
+struct ModelMeshInstance
+{
+    size_t meshIndex;
+    size_t lod; // index into the levels of detail of the mesh, 0 if it has none
+    glm::mat4 localToWorld;
+};
+
+// primitive of a mesh, drawn once for each node that references the mesh
+struct ModelDraw
+{
+    model::Primitive const* primitive;
+    model::MeshLod const* lod; // nullptr if the primitive should be drawn entirely
+    size_t primitiveIndex; // within the mesh, for the index range of the level of detail
+    uint32_t baseInstance;
+    uint32_t instanceCount;
+};
+
+// selects the coarsest level of detail of the mesh whose simplification error, projected onto the screen at the
+// distance of the closest point of the mesh's bounding sphere, is below app->config->lodMaxPixelError
+size_t selectMeshLod(App* app, model::Mesh const* mesh, glm::mat4 const& localToWorld)
+{
+    if (mesh->lods.size() <= 1)
+    {
+        return 0;
+    }
+
+    // bounds in world space
+    glm::vec3 localCenter = (mesh->boundsMin + mesh->boundsMax) * 0.5f;
+    glm::vec3 localHalfExtent = (mesh->boundsMax - mesh->boundsMin) * 0.5f;
+    glm::vec3 center = glm::vec3(localToWorld * glm::vec4(localCenter, 1.0f));
+    glm::vec3 halfExtent = glm::abs(glm::vec3(localToWorld[0])) * localHalfExtent.x +
+                           glm::abs(glm::vec3(localToWorld[1])) * localHalfExtent.y +
+                           glm::abs(glm::vec3(localToWorld[2])) * localHalfExtent.z;
+    float radius = glm::length(halfExtent);
+    float size = 2.0f * std::max({halfExtent.x, halfExtent.y, halfExtent.z}); // the errors are relative to this size
+
+    float distance = std::max(glm::distance(center, app->cameraTransform.position) - radius, app->config->cameraNear);
+    float pixelsPerUnit = (float)app->view.frame.size.height / (2.0f * tanf(glm::radians(app->config->cameraFov) * 0.5f)) / distance;
+
+    size_t lod = 0;
+    for (size_t i = 1; i < mesh->lods.size(); i++)
+    {
+        if (mesh->lods[i].error * size * pixelsPerUnit > app->config->lodMaxPixelError)
+        {
+            break;
+        }
+        lod = i;
+    }
+    return lod;
+}
+
 id <MTLTexture> getPbrTexture(model::Model* model, size_t textureIndex)
 {
     if (textureIndex != invalidIndex && textureIndex < model->textures.size())
@@ -1546,7 +1835,7 @@ id <MTLTexture> getPbrTexture(model::Model* model, size_t textureIndex)
     }
 }
 
-void setPbrMaterial(App const* app, id <MTLRenderCommandEncoder> encoder, model::Model* model, size_t materialIndex)
+void setPbrMaterial(App* app, id <MTLRenderCommandEncoder> encoder, model::Model* model, size_t materialIndex, PrimitiveDeinterleaved const* primitive)
 {
     bool hasMaterial = materialIndex != invalidIndex && materialIndex < model->materials.size();
     model::Material* material = hasMaterial ? &model->materials[materialIndex] : nullptr;
@@ -1558,14 +1847,8 @@ void setPbrMaterial(App const* app, id <MTLRenderCommandEncoder> encoder, model:
     id <MTLTexture> emission = hasMaterial ? getPbrTexture(model, material->emissionMap) : nullptr;
 
     // set shader
-    if (!baseColor && !normal && !metallicRoughness && !emission)
-    {
-        [encoder setRenderPipelineState:app->shaderPbr];
-    }
-    else
-    {
-        [encoder setRenderPipelineState:app->shaderPbrWithMaps];
-    }
+    bool hasMaps = baseColor || normal || metallicRoughness || emission;
+    [encoder setRenderPipelineState:getPbrShader(app, hasMaps, primitive)];
 
     // set data
     PbrMaterialData materialData{
@@ -1582,14 +1865,14 @@ void setPbrMaterial(App const* app, id <MTLRenderCommandEncoder> encoder, model:
     [encoder setFragmentTexture:emission atIndex:binding_fragment::emissionMap];
 }
 
-void drawModel(App const* app, id <MTLRenderCommandEncoder> encoder, model::Model* model, glm::mat4 transform)
+// appends the nodes of the model that reference a mesh, with their transform, lod is 0
+void getModelMeshInstances(model::Model* model, glm::mat4 transform, std::vector<ModelMeshInstance>* outInstances)
 {
-    [encoder setCullMode:MTLCullModeBack];
-    [encoder setTriangleFillMode:app->showLines > 0.5f ? MTLTriangleFillModeLines : MTLTriangleFillModeFill];
-    [encoder setDepthStencilState:app->depthStencilStateDefault];
-
-    // same for all meshes
-    setPbrFragmentData(app, encoder);
+    // the model can still be loading
+    if (model->scenes.empty())
+    {
+        return;
+    }
 
     // traverse scene using depth-first search (dfs)
     model::Scene* scene = &model->scenes[0];
@@ -1604,23 +1887,13 @@ void drawModel(App const* app, id <MTLRenderCommandEncoder> encoder, model::Mode
         ModelDfsData data = stack.top();
         stack.pop();
 
-        // draw mesh at transform
         if (data.node->meshIndex != invalidIndex)
         {
-            PbrInstanceData instance{
+            outInstances->emplace_back(ModelMeshInstance{
+                .meshIndex = data.node->meshIndex,
+                .lod = 0,
                 .localToWorld = data.localToWorld
-            };
-            setPbrInstanceData(app, encoder, instance);
-
-            model::Mesh* mesh = &model->meshes[data.node->meshIndex];
-            for (auto& primitive: mesh->primitives)
-            {
-                // set material
-                setPbrMaterial(app, encoder, model, primitive.materialIndex);
-
-                // draw primitive
-                drawPrimitive(encoder, &primitive.primitive, 1);
-            }
+            });
         }
 
         // iterate over children
@@ -1637,6 +1910,182 @@ void drawModel(App const* app, id <MTLRenderCommandEncoder> encoder, model::Mode
     }
 }
 
+// occlusionBuffer is optional, when set the nodes that are occluded are skipped
+void drawModel(App* app, id <MTLRenderCommandEncoder> encoder, model::Model* model, glm::mat4 transform, OcclusionBuffer const* occlusionBuffer = nullptr)
+{
+    [encoder setCullMode:MTLCullModeBack];
+    [encoder setTriangleFillMode:app->showLines > 0.5f ? MTLTriangleFillModeLines : MTLTriangleFillModeFill];
+    [encoder setDepthStencilState:app->depthStencilStateDefault];
+
+    // same for all meshes
+    setPbrFragmentData(app, encoder);
+
+    // the model can still be loading
+    if (model->scenes.empty())
+    {
+        return;
+    }
+
+    // all primitives of the model share the vertex buffers of the model's arena
+    VertexBufferBindings bindings{};
+
+    // collect the transforms of all nodes that reference a mesh, so that nodes that share a mesh (e.g. instanced ifc
+    // elements) can be drawn with a single instanced draw call per primitive
+    std::vector<ModelMeshInstance> meshInstances;
+    getModelMeshInstances(model, transform, &meshInstances);
+
+    // nodes whose bounds are entirely behind the occluders are not drawn
+    if (occlusionBuffer)
+    {
+        std::erase_if(meshInstances, [model, occlusionBuffer](ModelMeshInstance const& instance) {
+            model::Mesh const* mesh = &model->meshes[instance.meshIndex];
+            return isBoxOccluded(occlusionBuffer, mesh->boundsMin, mesh->boundsMax, instance.localToWorld);
+        });
+    }
+    for (ModelMeshInstance& instance: meshInstances)
+    {
+        instance.lod = selectMeshLod(app, &model->meshes[instance.meshIndex], instance.localToWorld);
+    }
+
+    // instances of all meshes are uploaded once, each draw selects the instances of its mesh and level of detail with
+    // baseInstance
+    std::stable_sort(meshInstances.begin(), meshInstances.end(), [](ModelMeshInstance const& lhs, ModelMeshInstance const& rhs) {
+        return lhs.meshIndex < rhs.meshIndex || (lhs.meshIndex == rhs.meshIndex && lhs.lod < rhs.lod);
+    });
+    std::vector<PbrInstanceData> instances;
+    instances.reserve(meshInstances.size());
+    std::vector<ModelDraw> draws;
+    for (size_t i = 0; i < meshInstances.size();)
+    {
+        size_t meshIndex = meshInstances[i].meshIndex;
+        size_t lod = meshInstances[i].lod;
+        size_t baseInstance = instances.size();
+        for (; i < meshInstances.size() && meshInstances[i].meshIndex == meshIndex && meshInstances[i].lod == lod; i++)
+        {
+            glm::mat4 localToWorld = meshInstances[i].localToWorld;
+            instances.emplace_back(PbrInstanceData{
+                .localToWorld = localToWorld,
+                .localToWorldTransposedInverse = glm::transpose(glm::inverse(localToWorld))
+            });
+        }
+
+        model::Mesh const* mesh = &model->meshes[meshIndex];
+        for (size_t j = 0; j < mesh->primitives.size(); j++)
+        {
+            draws.emplace_back(ModelDraw{
+                .primitive = &mesh->primitives[j],
+                .lod = lod > 0 ? &mesh->lods[lod] : nullptr,
+                .primitiveIndex = j,
+                .baseInstance = (uint32_t)baseInstance,
+                .instanceCount = (uint32_t)(instances.size() - baseInstance)
+            });
+        }
+    }
+    if (draws.empty())
+    {
+        return;
+    }
+    setPbrInstances(app, encoder, &instances);
+
+    // draws are batched by material, so that the material only needs to be set when it changes
+    std::stable_sort(draws.begin(), draws.end(), [](ModelDraw const& lhs, ModelDraw const& rhs) {
+        return lhs.primitive->materialIndex < rhs.primitive->materialIndex;
+    });
+    model::Primitive const* previous = nullptr;
+    for (ModelDraw const& draw: draws)
+    {
+        // the shader also depends on the vertex formats of the primitive
+        if (previous == nullptr ||
+            previous->materialIndex != draw.primitive->materialIndex ||
+            !hasSamePbrVertexFormats(&previous->primitive, &draw.primitive->primitive))
+        {
+            setPbrMaterial(app, encoder, model, draw.primitive->materialIndex, &draw.primitive->primitive);
+        }
+        previous = draw.primitive;
+
+        if (draw.lod)
+        {
+            IndexRange range = draw.lod->primitiveRanges[draw.primitiveIndex];
+            if (range.count > 0)
+            {
+                drawPrimitiveIndexRange(encoder, &draw.primitive->primitive, range, draw.instanceCount, &bindings, draw.baseInstance);
+            }
+        }
+        else
+        {
+            drawPrimitive(encoder, &draw.primitive->primitive, draw.instanceCount, &bindings, draw.baseInstance);
+        }
+    }
+}
+
+// ifc model with the transform it is drawn with
+struct IfcModelInstance
+{
+    model::Model* model;
+    glm::mat4 transform;
+};
+
+[[nodiscard]] std::vector<IfcModelInstance> getIfcModelInstances(App* app)
+{
+    return {
+        {&app->ifcFzkHaus, glm::translate(glm::mat4(1), glm::vec3(0.2f * sin(app->time), 0.2f, 0.2f * cos(app->time)))},
+        {&app->ifcAiscSculptureBrep, glm::translate(glm::scale(glm::vec3(3, 3, 3)), glm::vec3(7, 0, 0))},
+        {&app->ifcInstituteVar2, glm::translate(glm::scale(glm::vec3(1, 1, 1)), glm::vec3(0, 0, 25))},
+        {&app->ifcTableChairs, glm::translate(glm::vec3(0, 0, -7))}
+    };
+}
+
+// rasterizes the occluders of the ifc models into app->occlusionBuffer, closest to the camera first, until
+// app->config->occluderTriangleBudget is reached
+void rasterizeOccluders(App* app, glm::mat4 viewProjection)
+{
+    CGSize size = app->view.frame.size;
+    uint32_t width = app->config->occlusionBufferWidth;
+    auto height = (uint32_t)std::max(1.0, std::round((double)width * size.height / std::max(size.width, 1.0)));
+    clearOcclusionBuffer(width, height, viewProjection, app->config->cameraNear, &app->occlusionBuffer);
+
+    struct Occluder
+    {
+        model::Mesh const* mesh;
+        glm::mat4 localToWorld;
+        float distance; // from the camera to the center of the bounds
+    };
+    std::vector<Occluder> occluders;
+    std::vector<ModelMeshInstance> meshInstances;
+    for (IfcModelInstance const& instance: getIfcModelInstances(app))
+    {
+        meshInstances.clear();
+        getModelMeshInstances(instance.model, instance.transform, &meshInstances);
+        for (ModelMeshInstance const& meshInstance: meshInstances)
+        {
+            model::Mesh const* mesh = &instance.model->meshes[meshInstance.meshIndex];
+            if (mesh->occluderIndices.empty())
+            {
+                continue;
+            }
+            glm::vec3 center = glm::vec3(meshInstance.localToWorld * glm::vec4((mesh->boundsMin + mesh->boundsMax) * 0.5f, 1.0f));
+            occluders.emplace_back(Occluder{
+                .mesh = mesh,
+                .localToWorld = meshInstance.localToWorld,
+                .distance = glm::distance(center, app->cameraTransform.position)
+            });
+        }
+    }
+    std::sort(occluders.begin(), occluders.end(), [](Occluder const& lhs, Occluder const& rhs) {
+        return lhs.distance < rhs.distance;
+    });
+
+    for (Occluder const& occluder: occluders)
+    {
+        if (app->occlusionBuffer.triangleCount + occluder.mesh->occluderIndices.size() / 3 > app->config->occluderTriangleBudget)
+        {
+            break;
+        }
+        rasterizeOccluder(&app->occlusionBuffer, occluder.mesh->occluderPositions, occluder.mesh->occluderIndices, occluder.localToWorld);
+    }
+    finalizeOcclusionBuffer(&app->occlusionBuffer);
+}
+
 void drawScene(App* app, id <MTLRenderCommandEncoder> encoder, DrawSceneFlags_ flags)
 {
     assert(encoder != nullptr);
@@ -1738,10 +2187,12 @@ void drawScene(App* app, id <MTLRenderCommandEncoder> encoder, DrawSceneFlags_ f
     // draw ifc
     if (app->config->ifc)
     {
-        drawModel(app, encoder, &app->ifcFzkHaus, glm::translate(glm::mat4(1), glm::vec3(0.2f * sin(app->time), 0.2f, 0.2f * cos(app->time))));
-        drawModel(app, encoder, &app->ifcAiscSculptureBrep, glm::translate(glm::scale(glm::vec3(3, 3, 3)), glm::vec3(7, 0, 0)));
-        drawModel(app, encoder, &app->ifcInstituteVar2, glm::translate(glm::scale(glm::vec3(1, 1, 1)), glm::vec3(0, 0, 25)));
-        drawModel(app, encoder, &app->ifcTableChairs, glm::translate(glm::vec3(0, 0, -7)));
+        // the occlusion buffer is rasterized from the view of the camera, so it can't be used for the shadow map
+        bool occlusionCulling = app->config->occlusionCulling && !(flags & DrawSceneFlags_IsShadowPass);
+        for (IfcModelInstance const& instance: getIfcModelInstances(app))
+        {
+            drawModel(app, encoder, instance.model, instance.transform, occlusionCulling ? &app->occlusionBuffer : nullptr);
+        }
     }
 }
 
@@ -1772,12 +2223,26 @@ void drawTexture(App* app, id <MTLRenderCommandEncoder> encoder, id <MTLTexture>
 // main render loop
 void onDraw(App* app)
 {
+    // wait until the transient buffers of the oldest frame in flight can be reused
+    dispatch_semaphore_wait(app->frameSemaphore, DISPATCH_TIME_FOREVER);
+    app->frameIndex = (app->frameIndex + 1) % maxFramesInFlight;
+
     app->time += 0.015f;
     if (app->time > 2.0f * pi_)
     {
         app->time -= 2.0f * pi_;
     }
 
+    if (app->config->gltf)
+    {
+        updateGltfImports(app);
+    }
+
+    if (app->config->ifc)
+    {
+        updateIfcImports(app);
+    }
+
     // update sun / update camera transform
     {
         float speed = 0.1f;
@@ -1873,6 +2338,11 @@ void onDraw(App* app)
             view = glm::inverse(transformToMatrix(&app->cameraTransform));
             viewProjection = projection * view;
 
+            if (app->config->ifc && app->config->occlusionCulling)
+            {
+                rasterizeOccluders(app, viewProjection);
+            }
+
             [encoder setFragmentTexture:app->shadowMap atIndex:binding_fragment::shadowMap];
             [encoder setVertexBytes:&lightData length:sizeof(LightData) atIndex:binding_vertex::lightData];
 
@@ -1986,6 +2456,18 @@ void onDraw(App* app)
             std::string c = fmt::format("mip level: {} (U: previous, I: next)", app->currentMipLevel);
             addText(app, c, &vertices, 0, 200, 20);
 
+            if (app->config->gltf)
+            {
+                float progress = (getGltfImportProgress(&app->gltfUgvImport) +
+                                  getGltfImportProgress(&app->gltfCathedralImport) +
+                                  getGltfImportProgress(&app->gltfVrLoftLivingRoomBakedImport)) / 3.0f;
+                if (progress < 1.0f)
+                {
+                    std::string d = fmt::format("importing gltf: {:.0f}%", progress * 100.0f);
+                    addText(app, d, &vertices, 600, 0, 14);
+                }
+            }
+
             MTLResourceOptions options = MTLResourceCPUCacheModeDefaultCache | MTLResourceStorageModeShared;
             id <MTLBuffer> buffer = [app->device newBufferWithBytes:vertices.data() length:vertices.size() * sizeof(Image2dVertexData) options:options];
 
@@ -2020,6 +2502,14 @@ void onDraw(App* app)
         [encoder endEncoding];
         assert(app->view.currentDrawable);
         [cmd presentDrawable:app->view.currentDrawable];
+
+        // the main pass is committed after the shadow pass on the same queue, so it completes last
+        BufferArena* frameInstanceArena = &app->frameInstanceArenas[app->frameIndex];
+        dispatch_semaphore_t frameSemaphore = app->frameSemaphore;
+        [cmd addCompletedHandler:^(id <MTLCommandBuffer> completedCommandBuffer) {
+            resetBufferArena(frameInstanceArena);
+            dispatch_semaphore_signal(frameSemaphore);
+        }];
         [cmd commit];
     }
 }
@@ -2047,11 +2537,17 @@ int main(int argc, char const* argv[])
         .clearColor = MTLClearColorMake(0, 1, 1, 1.0),
         .assetsPath = assetsDirectory,
         .privateAssetsPath = privateAssetsDirectory,
+        .cachePath = std::filesystem::temp_directory_path() / "metal_experiment_cache",
         .fontCharacterMap = fontCharacterMap,
         .cameraFov = 90.0f,
         .cameraNear = 0.1f,
         .cameraFar = 1000.0f,
         .shadowMapSize = 4096,
+        .ifcElementsPerFrame = 256,
+        .lodMaxPixelError = 1.0f,
+        .occlusionCulling = true,
+        .occlusionBufferWidth = 256,
+        .occluderTriangleBudget = 512,
 
         // experiments, can be conditionally turned on or off
         .terrain = false,
@@ -0,0 +1,53 @@
+#include "mapped_file.h"
+
+#include <cassert>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+bool mapFile(std::filesystem::path const& path, MappedFile* outFile)
+{
+    assert(outFile != nullptr);
+
+    int fileDescriptor = open(path.c_str(), O_RDONLY);
+    if (fileDescriptor < 0)
+    {
+        return false;
+    }
+
+    struct stat fileStat{};
+    if (fstat(fileDescriptor, &fileStat) != 0 || fileStat.st_size <= 0)
+    {
+        // mapping a file with size 0 is not allowed
+        close(fileDescriptor);
+        return false;
+    }
+
+    auto size = static_cast<size_t>(fileStat.st_size);
+    void* data = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fileDescriptor, 0);
+
+    // the mapping stays valid after closing the file descriptor
+    close(fileDescriptor);
+
+    if (data == MAP_FAILED)
+    {
+        return false;
+    }
+
+    outFile->data = data;
+    outFile->size = size;
+    return true;
+}
+
+void unmapFile(MappedFile* file)
+{
+    assert(file != nullptr);
+    if (file->data != nullptr)
+    {
+        munmap(file->data, file->size);
+    }
+    file->data = nullptr;
+    file->size = 0;
+}
@@ -0,0 +1,20 @@
+#ifndef METAL_EXPERIMENT_MAPPED_FILE_H
+#define METAL_EXPERIMENT_MAPPED_FILE_H
+
+#include <cstddef>
+#include <filesystem>
+
+// read-only memory mapped file
+// pages are loaded lazily by the OS when accessed, so no copy to heap memory is made
+struct MappedFile
+{
+    void* data = nullptr;
+    size_t size = 0;
+};
+
+// returns true when successful
+[[nodiscard]] bool mapFile(std::filesystem::path const& path, MappedFile* outFile);
+
+void unmapFile(MappedFile* file);
+
+#endif //METAL_EXPERIMENT_MAPPED_FILE_H
@@ -9,8 +9,11 @@
 
 #import <Metal/Metal.h>
 
+#include <span>
 #include <vector>
 
+#include "buffer_arena.h"
+
 enum class VertexAttributeType : uint16_t
 {
     Position,
@@ -22,15 +25,33 @@ enum class VertexAttributeType : uint16_t
     Weights,
 };
 
-// only floats supported right now
+// format of a single component of a vertex attribute
+// 8 and 16 bit formats are used for quantized data (e.g. KHR_mesh_quantization)
+enum class VertexComponentType : uint16_t
+{
+    Float32,
+    Int8,
+    UInt8,
+    Int16,
+    UInt16,
+};
+
 struct VertexAttribute
 {
     VertexAttributeType type;
     uint16_t index;
-    size_t componentCount; // amount of floats per vertex (e.g. 3 for a vector3)
+    size_t componentCount; // amount of components per vertex (e.g. 3 for a vector3), normals with 2 components are octahedral encoded
+    VertexComponentType componentType = VertexComponentType::Float32;
+    bool normalized = false; // whether integer components map to [0, 1] (unsigned) or [-1, 1] (signed)
+    size_t stride; // size of one element in bytes, see vertexAttributeStride
     size_t size; // size of this part of the buffer
 };
 
+[[nodiscard]] size_t vertexComponentSize(VertexComponentType componentType);
+
+// elements are aligned to 4 bytes, e.g. a vector3 of int16 has a stride of 8 bytes
+[[nodiscard]] size_t vertexAttributeStride(VertexComponentType componentType, size_t componentCount);
+
 // todo: use grouped interleaved attributes that are grouped per pass where they are needed
 // e.g. shadow pass only needs 1., this is faster due to having less memory reads
 // 1. position (uv0 if alpha testing)
@@ -38,10 +59,14 @@ struct VertexAttribute
 // 3. skinning data
 // still store everything in the same buffer, only change attributes
 // generate shader based on data layout
+// the vertex and index buffers can be shared with other primitives (e.g. a BufferArena of a Model),
+// so the data of this primitive starts at vertexBufferOffset and indexBufferOffset
 struct PrimitiveDeinterleaved
 {
     id <MTLBuffer> vertexBuffer;
+    size_t vertexBufferOffset = 0; // in bytes, the attributes are stored one after another from this offset
     id <MTLBuffer> indexBuffer;
+    size_t indexBufferOffset = 0; // in bytes
     size_t vertexCount;
     size_t indexCount;
     MTLPrimitiveType primitiveType;
@@ -50,6 +75,14 @@ struct PrimitiveDeinterleaved
     std::vector<VertexAttribute> attributes;
 };
 
+// alignment of the vertex and index data of a primitive inside a (shared) buffer
+constexpr size_t vertexDataAlignment = 16;
+constexpr size_t indexDataAlignment = 4;
+
+// largest vertex count for which 16-bit indices can be used
+// index 0xFFFF is excluded, as Metal uses it as the primitive restart index for strip topologies
+constexpr size_t maxUInt16IndexedVertexCount = 0xFFFF;
+
 struct float2
 {
     float x;
@@ -71,19 +104,71 @@ struct float4
     float w;
 };
 
+// quantized vector3 of normalized int16 components, w is padding (elements are aligned to 4 bytes)
+struct short4
+{
+    int16_t x;
+    int16_t y;
+    int16_t z;
+    int16_t w;
+};
+
+// octahedral encoded normal of normalized int16 components, see encodeOctahedral
+struct short2
+{
+    int16_t x;
+    int16_t y;
+};
+
+// value is clamped to [-1, 1]
+[[nodiscard]] int16_t quantizeSnorm16(float value);
+
+[[nodiscard]] float dequantizeSnorm16(int16_t value);
+
+// maps the unit sphere onto a square (octahedral projection), so that a normal can be stored in 2 components instead of 3
+// with 16-bit components the error is a few hundredths of a degree. decoded by decodeOctahedral in shader_pbr.metal
+[[nodiscard]] short2 encodeOctahedral(float3 normal);
+
+// range of indices in the index buffer of a primitive, in indices (not bytes)
+struct IndexRange
+{
+    size_t offset = 0;
+    size_t count = 0;
+};
+
 // to avoid having to specify all parameters each time in a function
 struct PrimitiveDeinterleavedDescriptor
 {
-    std::vector<float3>* positions = nullptr;
-    std::vector<float3>* normals = nullptr;
-    std::vector<float4>* colors = nullptr;
-    std::vector<float2>* uv0s = nullptr;
-    std::vector<uint32_t>* indices = nullptr; // if nullptr, this mesh is not indexed
+    // attributes that are empty are omitted
+    // the data is copied into the vertex and index buffers, so can be temporary (e.g. from a ScratchArena)
+    std::span<float3 const> positions;
+    std::span<short4 const> quantizedPositions; // used instead of positions, dequantized by the node transform
+    std::span<float3 const> normals;
+    std::span<short2 const> octahedralNormals; // used instead of normals
+    std::span<float4 const> colors;
+    std::span<float2 const> uv0s;
+    std::span<uint32_t const> indices; // if empty, this mesh is not indexed
     MTLPrimitiveType primitiveType = MTLPrimitiveTypeTriangle;
+    BufferArena* vertexArena = nullptr; // if nullptr, a separate vertex buffer is created
+    BufferArena* indexArena = nullptr; // if nullptr, a separate index buffer is created
 };
 
+// allocates from the arena, or creates a separate buffer if arena is nullptr
+[[nodiscard]] BufferArenaAllocation allocatePrimitiveData(id <MTLDevice> device, BufferArena* arena, size_t size, size_t alignment);
+
+// indices are stored as 16 bits when the vertex count allows it, see maxUInt16IndexedVertexCount
 [[nodiscard]] PrimitiveDeinterleaved createPrimitiveDeinterleaved(
     id <MTLDevice> device,
     PrimitiveDeinterleavedDescriptor* descriptor);
 
+// splits an indexed triangle list with 32-bit indices into chunks that each have at most maxUInt16IndexedVertexCount
+// vertices, so that all chunks can use 16-bit indices. the chunks are allocated from the arenas (see allocatePrimitiveData)
+// returns false if the primitive can't or doesn't need to be split, outPrimitives is then left unchanged
+[[nodiscard]] bool splitPrimitiveForUInt16Indices(
+    id <MTLDevice> device,
+    BufferArena* vertexArena,
+    BufferArena* indexArena,
+    PrimitiveDeinterleaved const* primitive,
+    std::vector<PrimitiveDeinterleaved>* outPrimitives);
+
 #endif //METAL_EXPERIMENT_MESH_H
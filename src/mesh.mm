@@ -1,45 +1,131 @@
 #include "mesh.h"
 
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+#include <limits>
 #include <vector>
 
+#include "constants.h"
+
+size_t vertexComponentSize(VertexComponentType componentType)
+{
+    switch (componentType)
+    {
+        case VertexComponentType::Float32: return 4;
+        case VertexComponentType::Int8: return 1;
+        case VertexComponentType::UInt8: return 1;
+        case VertexComponentType::Int16: return 2;
+        case VertexComponentType::UInt16: return 2;
+    }
+    assert(false);
+    return 0;
+}
+
+size_t vertexAttributeStride(VertexComponentType componentType, size_t componentCount)
+{
+    size_t size = vertexComponentSize(componentType) * componentCount;
+    return (size + 3) & ~static_cast<size_t>(3);
+}
+
+BufferArenaAllocation allocatePrimitiveData(id <MTLDevice> device, BufferArena* arena, size_t size, size_t alignment)
+{
+    if (arena != nullptr)
+    {
+        return allocateFromBufferArena(arena, size, alignment);
+    }
+
+    MTLResourceOptions options = MTLResourceCPUCacheModeDefaultCache | MTLResourceStorageModeShared;
+    id <MTLBuffer> buffer = [device newBufferWithLength:size options:options];
+    return BufferArenaAllocation{
+        .buffer = buffer,
+        .offset = 0,
+        .data = static_cast<unsigned char*>([buffer contents])
+    };
+}
+
+int16_t quantizeSnorm16(float value)
+{
+    return static_cast<int16_t>(std::lround(std::clamp(value, -1.0f, 1.0f) * 32767.0f));
+}
+
+float dequantizeSnorm16(int16_t value)
+{
+    return std::max(static_cast<float>(value) / 32767.0f, -1.0f);
+}
+
+short2 encodeOctahedral(float3 normal)
+{
+    float length = std::abs(normal.x) + std::abs(normal.y) + std::abs(normal.z);
+    if (length == 0.0f)
+    {
+        return short2{0, 0};
+    }
+    float x = normal.x / length;
+    float y = normal.y / length;
+
+    // fold the lower hemisphere over the diagonals
+    if (normal.z < 0.0f)
+    {
+        float foldedX = (1.0f - std::abs(y)) * (x >= 0.0f ? 1.0f : -1.0f);
+        float foldedY = (1.0f - std::abs(x)) * (y >= 0.0f ? 1.0f : -1.0f);
+        x = foldedX;
+        y = foldedY;
+    }
+    return short2{quantizeSnorm16(x), quantizeSnorm16(y)};
+}
+
 [[nodiscard]] PrimitiveDeinterleaved createPrimitiveDeinterleaved(
     id <MTLDevice> device,
     PrimitiveDeinterleavedDescriptor* descriptor)
 {
-    assert(descriptor->positions && !descriptor->positions->empty());
+    bool quantizedPositions = !descriptor->quantizedPositions.empty();
+    assert(descriptor->positions.empty() != descriptor->quantizedPositions.empty() && "either positions or quantized positions should be set");
 
     PrimitiveDeinterleaved mesh{};
-    mesh.vertexCount = descriptor->positions->size();
+    mesh.vertexCount = quantizedPositions ? descriptor->quantizedPositions.size() : descriptor->positions.size();
     std::vector<VertexAttribute>* attributes = &mesh.attributes;
     mesh.primitiveType = descriptor->primitiveType;
 
     // positions
     attributes->emplace_back(VertexAttribute{
         .type = VertexAttributeType::Position,
-        .componentCount = 3
+        .componentCount = 3,
+        .componentType = quantizedPositions ? VertexComponentType::Int16 : VertexComponentType::Float32,
+        .normalized = quantizedPositions
     });
 
-    if (descriptor->normals)
+    if (!descriptor->normals.empty())
     {
-        assert(descriptor->normals->size() == mesh.vertexCount); // should be same amount of vertices
+        assert(descriptor->normals.size() == mesh.vertexCount); // should be same amount of vertices
         attributes->emplace_back(VertexAttribute{
             .type = VertexAttributeType::Normal,
             .componentCount = 3
         });
     }
+    else if (!descriptor->octahedralNormals.empty())
+    {
+        assert(descriptor->octahedralNormals.size() == mesh.vertexCount); // should be same amount of vertices
+        attributes->emplace_back(VertexAttribute{
+            .type = VertexAttributeType::Normal,
+            .componentCount = 2,
+            .componentType = VertexComponentType::Int16,
+            .normalized = true
+        });
+    }
 
-    if (descriptor->colors)
+    if (!descriptor->colors.empty())
     {
-        assert(descriptor->colors->size() == mesh.vertexCount); // should be same amount of vertices
+        assert(descriptor->colors.size() == mesh.vertexCount); // should be same amount of vertices
         attributes->emplace_back(VertexAttribute{
             .type = VertexAttributeType::Color,
             .componentCount = 4
         });
     }
 
-    if (descriptor->uv0s)
+    if (!descriptor->uv0s.empty())
     {
-        assert(descriptor->uv0s->size() == mesh.vertexCount); // should be same amount of vertices
+        assert(descriptor->uv0s.size() == mesh.vertexCount); // should be same amount of vertices
         attributes->emplace_back(VertexAttribute{
             .type = VertexAttributeType::TextureCoordinate,
             .componentCount = 2
@@ -50,53 +136,190 @@
     size_t totalSize = 0;
     for (VertexAttribute& attribute: *attributes)
     {
-        attribute.size = attribute.componentCount * sizeof(float) * mesh.vertexCount;
+        attribute.stride = vertexAttributeStride(attribute.componentType, attribute.componentCount);
+        attribute.size = attribute.stride * mesh.vertexCount;
 
         totalSize += attribute.size;
     }
 
     // create vertex buffer
     {
-        MTLResourceOptions options = MTLResourceCPUCacheModeDefaultCache | MTLResourceStorageModeShared;
-        mesh.vertexBuffer = [device newBufferWithLength:totalSize options:options];
-        auto* data = (unsigned char*)[mesh.vertexBuffer contents]; // unsigned char is 1 byte
+        BufferArenaAllocation allocation = allocatePrimitiveData(device, descriptor->vertexArena, totalSize, vertexDataAlignment);
+        mesh.vertexBuffer = allocation.buffer;
+        mesh.vertexBufferOffset = allocation.offset;
+        unsigned char* data = allocation.data; // unsigned char is 1 byte
 
         // copy data
         size_t offset = 0;
         for (VertexAttribute& attribute: *attributes)
         {
-            void* source = nullptr;
+            void const* source = nullptr;
             switch (attribute.type)
             {
                 //@formatter:off
-                case VertexAttributeType::Position: source = descriptor->positions->data(); break;
-                case VertexAttributeType::Normal: source = descriptor->normals->data(); break;
-                case VertexAttributeType::Color: source = descriptor->colors->data(); break;
-                case VertexAttributeType::TextureCoordinate: source = descriptor->uv0s->data(); break;
+                case VertexAttributeType::Position: source = quantizedPositions ? (void const*)descriptor->quantizedPositions.data() : descriptor->positions.data(); break;
+                case VertexAttributeType::Normal: source = descriptor->normals.empty() ? (void const*)descriptor->octahedralNormals.data() : descriptor->normals.data(); break;
+                case VertexAttributeType::Color: source = descriptor->colors.data(); break;
+                case VertexAttributeType::TextureCoordinate: source = descriptor->uv0s.data(); break;
                 default: continue;
                 //@formatter:on
             }
             memcpy(data + offset, source, attribute.size);
             offset += attribute.size;
         }
-
-        NSRange range = NSMakeRange(0, totalSize);
-        [mesh.vertexBuffer didModifyRange:range];
     }
 
     // indexed mesh
-    if (descriptor->indices)
+    if (!descriptor->indices.empty())
     {
-        assert(!descriptor->indices->empty());
-
         mesh.indexed = true;
-        mesh.indexType = MTLIndexTypeUInt32;
-        mesh.indexCount = descriptor->indices->size();
+        mesh.indexCount = descriptor->indices.size();
 
         // create index buffer
-        MTLResourceOptions options = MTLResourceCPUCacheModeDefaultCache | MTLResourceStorageModeShared;
-        mesh.indexBuffer = [device newBufferWithBytes:descriptor->indices->data() length:descriptor->indices->size() * sizeof(uint32_t) options:options];
+        // 16-bit indices halve index memory and fetch bandwidth
+        bool narrow = mesh.vertexCount <= maxUInt16IndexedVertexCount;
+        mesh.indexType = narrow ? MTLIndexTypeUInt16 : MTLIndexTypeUInt32;
+        size_t indexSize = narrow ? sizeof(uint16_t) : sizeof(uint32_t);
+        BufferArenaAllocation allocation = allocatePrimitiveData(device, descriptor->indexArena, mesh.indexCount * indexSize, indexDataAlignment);
+        mesh.indexBuffer = allocation.buffer;
+        mesh.indexBufferOffset = allocation.offset;
+        if (narrow)
+        {
+            // the 32-bit primitive restart index (invalidMeshIndex) of strip topologies maps to the 16-bit one
+            auto* indices = reinterpret_cast<uint16_t*>(allocation.data);
+            for (size_t i = 0; i < mesh.indexCount; i++)
+            {
+                uint32_t index = descriptor->indices[i];
+                if (index == invalidMeshIndex)
+                {
+                    indices[i] = 0xFFFF;
+                    continue;
+                }
+                assert(index < mesh.vertexCount);
+                indices[i] = static_cast<uint16_t>(index);
+            }
+        }
+        else
+        {
+            memcpy(allocation.data, descriptor->indices.data(), mesh.indexCount * sizeof(uint32_t));
+        }
     }
 
     return mesh;
+}
+
+// creates a primitive with the given vertices of the source primitive and 16-bit indices
+[[nodiscard]] static PrimitiveDeinterleaved createPrimitiveChunk(
+    id <MTLDevice> device,
+    BufferArena* vertexArena,
+    BufferArena* indexArena,
+    PrimitiveDeinterleaved const* source,
+    std::vector<uint32_t> const& vertices,
+    std::vector<uint16_t> const& indices)
+{
+    PrimitiveDeinterleaved chunk{};
+    chunk.primitiveType = source->primitiveType;
+    chunk.vertexCount = vertices.size();
+    chunk.attributes = source->attributes;
+
+    size_t totalSize = 0;
+    for (VertexAttribute& attribute: chunk.attributes)
+    {
+        attribute.size = attribute.stride * chunk.vertexCount;
+        totalSize += attribute.size;
+    }
+
+    // gather vertices, attributes are stored one after another (deinterleaved)
+    BufferArenaAllocation vertexAllocation = allocatePrimitiveData(device, vertexArena, totalSize, vertexDataAlignment);
+    chunk.vertexBuffer = vertexAllocation.buffer;
+    chunk.vertexBufferOffset = vertexAllocation.offset;
+    auto const* sourceData = (unsigned char const*)[source->vertexBuffer contents] + source->vertexBufferOffset;
+    unsigned char* data = vertexAllocation.data;
+    size_t sourceOffset = 0;
+    size_t offset = 0;
+    for (size_t i = 0; i < chunk.attributes.size(); i++)
+    {
+        size_t stride = chunk.attributes[i].stride;
+        for (size_t j = 0; j < vertices.size(); j++)
+        {
+            memcpy(data + offset + j * stride, sourceData + sourceOffset + vertices[j] * stride, stride);
+        }
+        sourceOffset += source->attributes[i].size;
+        offset += chunk.attributes[i].size;
+    }
+
+    chunk.indexed = true;
+    chunk.indexType = MTLIndexTypeUInt16;
+    chunk.indexCount = indices.size();
+    BufferArenaAllocation indexAllocation = allocatePrimitiveData(device, indexArena, indices.size() * sizeof(uint16_t), indexDataAlignment);
+    chunk.indexBuffer = indexAllocation.buffer;
+    chunk.indexBufferOffset = indexAllocation.offset;
+    memcpy(indexAllocation.data, indices.data(), indices.size() * sizeof(uint16_t));
+    return chunk;
+}
+
+bool splitPrimitiveForUInt16Indices(
+    id <MTLDevice> device,
+    BufferArena* vertexArena,
+    BufferArena* indexArena,
+    PrimitiveDeinterleaved const* primitive,
+    std::vector<PrimitiveDeinterleaved>* outPrimitives)
+{
+    if (!primitive->indexed ||
+        primitive->indexType != MTLIndexTypeUInt32 ||
+        primitive->primitiveType != MTLPrimitiveTypeTriangle ||
+        primitive->vertexCount <= maxUInt16IndexedVertexCount)
+    {
+        return false;
+    }
+
+    auto const* indices = (uint32_t const*)((unsigned char const*)[primitive->indexBuffer contents] + primitive->indexBufferOffset);
+    constexpr uint32_t unassigned = std::numeric_limits<uint32_t>::max();
+
+    // maps a vertex of the source primitive to the vertex in the current chunk
+    std::vector<uint32_t> remap(primitive->vertexCount, unassigned);
+    std::vector<uint32_t> chunkVertices; // source vertex of each vertex in the current chunk
+    std::vector<uint16_t> chunkIndices;
+
+    auto flush = [&]() {
+        outPrimitives->emplace_back(createPrimitiveChunk(device, vertexArena, indexArena, primitive, chunkVertices, chunkIndices));
+        for (uint32_t vertex: chunkVertices)
+        {
+            remap[vertex] = unassigned;
+        }
+        chunkVertices.clear();
+        chunkIndices.clear();
+    };
+
+    // triangles are added to the current chunk in order, until its vertices no longer fit
+    for (size_t i = 0; i + 2 < primitive->indexCount; i += 3)
+    {
+        uint32_t a = indices[i];
+        uint32_t b = indices[i + 1];
+        uint32_t c = indices[i + 2];
+        size_t newVertexCount = (remap[a] == unassigned) +
+                                (remap[b] == unassigned && b != a) +
+                                (remap[c] == unassigned && c != a && c != b);
+        if (chunkVertices.size() + newVertexCount > maxUInt16IndexedVertexCount)
+        {
+            flush();
+        }
+
+        for (uint32_t vertex: {a, b, c})
+        {
+            assert(vertex < primitive->vertexCount);
+            if (remap[vertex] == unassigned)
+            {
+                remap[vertex] = static_cast<uint32_t>(chunkVertices.size());
+                chunkVertices.emplace_back(vertex);
+            }
+            chunkIndices.emplace_back(static_cast<uint16_t>(remap[vertex]));
+        }
+    }
+
+    if (!chunkIndices.empty())
+    {
+        flush();
+    }
+    return true;
 }
\ No newline at end of file
@@ -0,0 +1,71 @@
+#ifndef METAL_EXPERIMENT_MESH_OPTIMIZATION_H
+#define METAL_EXPERIMENT_MESH_OPTIMIZATION_H
+
+#include "mesh.h"
+#include "scratch_arena.h"
+
+#include <span>
+#include <string>
+
+// post-transform vertex cache statistics, summed over all optimized primitives
+// ACMR (average cache miss ratio) = transformed vertices / triangles, lower is better, 0.5 is optimal for regular grids
+// ATVR (average transformed vertex ratio) = transformed vertices / vertices, lower is better, 1.0 is optimal
+struct MeshOptimizationStatistics
+{
+    size_t primitiveCount = 0;
+    size_t triangleCount = 0;
+    size_t vertexCountBefore = 0;
+    size_t vertexCountAfter = 0; // unreferenced vertices are removed
+    size_t transformedVerticesBefore = 0;
+    size_t transformedVerticesAfter = 0;
+};
+
+[[nodiscard]] float getAcmrBefore(MeshOptimizationStatistics const* statistics);
+
+[[nodiscard]] float getAcmrAfter(MeshOptimizationStatistics const* statistics);
+
+[[nodiscard]] float getAtvrBefore(MeshOptimizationStatistics const* statistics);
+
+[[nodiscard]] float getAtvrAfter(MeshOptimizationStatistics const* statistics);
+
+// e.g. "12 primitives, ACMR 1.52 -> 0.71, ATVR 2.10 -> 1.01"
+[[nodiscard]] std::string meshOptimizationStatisticsToString(MeshOptimizationStatistics const* statistics);
+
+// optimizes an indexed triangle list in place (using meshoptimizer), in this order:
+// 1. reorders triangles for post-transform vertex cache locality
+// 2. reorders triangles to reduce overdraw (only with float32 or normalized int16 positions), without degrading the vertex cache much
+// 3. reorders vertices in the order they are first referenced by the indices, for vertex fetch locality
+// the vertex and index buffers should be CPU accessible (shared storage)
+// other primitive types are left unchanged, and the statistics are then not updated
+// temporary index and remap arrays are allocated from scratch, which the caller can reset afterwards
+void optimizePrimitive(PrimitiveDeinterleaved* primitive, ScratchArena* scratch, MeshOptimizationStatistics* outStatistics);
+
+// same as optimizePrimitive, but triangles are only reordered within each index range, so that ranges that are drawn
+// separately (e.g. one per material, sharing the vertex buffer) keep their offset and count
+// the vertex fetch optimization is done over all ranges together, as they share the vertices
+void optimizePrimitiveRanges(
+    PrimitiveDeinterleaved* primitive, std::span<IndexRange const> ranges, ScratchArena* scratch, MeshOptimizationStatistics* outStatistics);
+
+struct LodSettings
+{
+    size_t levelCount = 4; // including the full detail level, 1 = no simplification
+    float indexRatio = 0.5f; // target index count of each level relative to the previous level
+    float maxError = 0.05f; // relative to the size of the mesh, a level stops simplifying at this error
+    float normalWeight = 0.5f; // weight of the normals in the error metric, so that hard edges and curvature are kept
+};
+
+// generates levels of detail of an indexed triangle list with meshoptimizer's simplifier (quadric error metric, with the
+// normals as attributes), each level is simplified from the previous one. vertices on the border of the mesh are locked,
+// so that meshes that touch each other don't get gaps. triangles are only simplified within each range (e.g. a material)
+// normals can be empty.
+// outIndices receives the indices of all levels after each other, starting with a copy of indices (the full detail level).
+// outRanges receives the range in outIndices of each level and input range (level-major), outErrors the error of each level
+// (accumulated over the levels, relative to the size of the mesh, see meshopt_simplifyScale).
+// the outputs should fit settings.levelCount levels. returns the amount of levels, which is lower than settings.levelCount
+// when a level would not reduce the index count enough.
+[[nodiscard]] size_t generateLods(
+    std::span<float3 const> positions, std::span<float3 const> normals, std::span<uint32_t const> indices,
+    std::span<IndexRange const> ranges, LodSettings settings,
+    std::span<uint32_t> outIndices, std::span<IndexRange> outRanges, std::span<float> outErrors);
+
+#endif //METAL_EXPERIMENT_MESH_OPTIMIZATION_H
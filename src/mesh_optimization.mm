@@ -0,0 +1,258 @@
+#include "mesh_optimization.h"
+
+#include "meshoptimizer.h"
+#include "fmt/format.h"
+
+#include <algorithm>
+#include <cassert>
+
+// cache size of the fifo cache model used for analysis
+constexpr unsigned int analysisCacheSize = 16;
+
+// overdraw optimization is allowed to make the vertex cache efficiency at most 5% worse
+constexpr float overdrawThreshold = 1.05f;
+
+// a level of detail is only added when it has at most 85% of the indices of the previous level
+constexpr float lodMaxIndexRatio = 0.85f;
+
+[[nodiscard]] static float ratio(size_t numerator, size_t denominator)
+{
+    return denominator == 0 ? 0.0f : static_cast<float>(numerator) / static_cast<float>(denominator);
+}
+
+float getAcmrBefore(MeshOptimizationStatistics const* statistics)
+{
+    return ratio(statistics->transformedVerticesBefore, statistics->triangleCount);
+}
+
+float getAcmrAfter(MeshOptimizationStatistics const* statistics)
+{
+    return ratio(statistics->transformedVerticesAfter, statistics->triangleCount);
+}
+
+float getAtvrBefore(MeshOptimizationStatistics const* statistics)
+{
+    return ratio(statistics->transformedVerticesBefore, statistics->vertexCountBefore);
+}
+
+float getAtvrAfter(MeshOptimizationStatistics const* statistics)
+{
+    return ratio(statistics->transformedVerticesAfter, statistics->vertexCountAfter);
+}
+
+std::string meshOptimizationStatisticsToString(MeshOptimizationStatistics const* statistics)
+{
+    return fmt::format(
+        "{} primitives, ACMR {:.2f} -> {:.2f}, ATVR {:.2f} -> {:.2f}",
+        statistics->primitiveCount,
+        getAcmrBefore(statistics), getAcmrAfter(statistics),
+        getAtvrBefore(statistics), getAtvrAfter(statistics));
+}
+
+void optimizePrimitive(PrimitiveDeinterleaved* primitive, ScratchArena* scratch, MeshOptimizationStatistics* outStatistics)
+{
+    IndexRange range{.offset = 0, .count = primitive->indexCount};
+    optimizePrimitiveRanges(primitive, {&range, 1}, scratch, outStatistics);
+}
+
+void optimizePrimitiveRanges(
+    PrimitiveDeinterleaved* primitive, std::span<IndexRange const> ranges, ScratchArena* scratch, MeshOptimizationStatistics* outStatistics)
+{
+    assert(outStatistics != nullptr);
+    if (!primitive->indexed || primitive->primitiveType != MTLPrimitiveTypeTriangle || primitive->indexCount < 3)
+    {
+        return;
+    }
+
+    size_t indexCount = primitive->indexCount;
+    size_t vertexCount = primitive->vertexCount;
+
+    // meshoptimizer operates on 32-bit indices
+    std::span<unsigned int> indices = allocateScratchArray<unsigned int>(scratch, indexCount);
+    void* indexData = (unsigned char*)[primitive->indexBuffer contents] + primitive->indexBufferOffset;
+    if (primitive->indexType == MTLIndexTypeUInt16)
+    {
+        auto const* source = static_cast<uint16_t const*>(indexData);
+        for (size_t i = 0; i < indexCount; i++)
+        {
+            indices[i] = source[i];
+        }
+    }
+    else
+    {
+        memcpy(indices.data(), indexData, indexCount * sizeof(uint32_t));
+    }
+
+    meshopt_VertexCacheStatistics before = meshopt_analyzeVertexCache(indices.data(), indexCount, vertexCount, analysisCacheSize, 0, 0);
+
+    // find float positions (or decode quantized positions), needed for the overdraw optimization to determine the triangle clusters that face the same direction
+    auto* vertexData = (unsigned char*)[primitive->vertexBuffer contents] + primitive->vertexBufferOffset;
+    float const* positions = nullptr;
+    size_t positionStride = 0;
+    {
+        size_t offset = 0;
+        for (VertexAttribute const& attribute: primitive->attributes)
+        {
+            if (attribute.type == VertexAttributeType::Position &&
+                attribute.componentType == VertexComponentType::Float32 &&
+                attribute.componentCount >= 3)
+            {
+                positions = reinterpret_cast<float const*>(vertexData + offset);
+                positionStride = attribute.stride;
+                break;
+            }
+            if (attribute.type == VertexAttributeType::Position &&
+                attribute.componentType == VertexComponentType::Int16 &&
+                attribute.normalized &&
+                attribute.componentCount >= 3)
+            {
+                // quantized positions (see short4), the clusters that face the same direction are found well enough
+                // without the dequantization scale and offset
+                auto const* quantized = reinterpret_cast<short4 const*>(vertexData + offset);
+                std::span<float3> decoded = allocateScratchArray<float3>(scratch, vertexCount);
+                for (size_t i = 0; i < vertexCount; i++)
+                {
+                    decoded[i] = float3{
+                        dequantizeSnorm16(quantized[i].x),
+                        dequantizeSnorm16(quantized[i].y),
+                        dequantizeSnorm16(quantized[i].z)
+                    };
+                }
+                positions = &decoded[0].x;
+                positionStride = sizeof(float3);
+                break;
+            }
+            offset += attribute.size;
+        }
+    }
+
+    // triangles are only reordered within their range
+    for (IndexRange const& range: ranges)
+    {
+        assert(range.offset + range.count <= indexCount && range.count % 3 == 0);
+        unsigned int* rangeIndices = indices.data() + range.offset;
+
+        // 1. vertex cache
+        meshopt_optimizeVertexCache(rangeIndices, rangeIndices, range.count, vertexCount);
+
+        // 2. overdraw
+        if (positions != nullptr)
+        {
+            meshopt_optimizeOverdraw(rangeIndices, rangeIndices, range.count, positions, vertexCount, positionStride, overdrawThreshold);
+        }
+    }
+
+    // 3. vertex fetch
+    std::span<unsigned int> remap = allocateScratchArray<unsigned int>(scratch, vertexCount);
+    size_t newVertexCount = meshopt_optimizeVertexFetchRemap(remap.data(), indices.data(), indexCount, vertexCount);
+    meshopt_remapIndexBuffer(indices.data(), indices.data(), indexCount, remap.data());
+
+    // remap each attribute in place. unreferenced vertices are removed, so the attributes are moved down to stay contiguous
+    {
+        size_t sourceOffset = 0;
+        size_t destinationOffset = 0;
+        for (VertexAttribute& attribute: primitive->attributes)
+        {
+            unsigned char* source = vertexData + sourceOffset;
+            sourceOffset += attribute.size;
+
+            meshopt_remapVertexBuffer(source, source, vertexCount, attribute.stride, remap.data());
+            attribute.size = attribute.stride * newVertexCount;
+            memmove(vertexData + destinationOffset, source, attribute.size);
+            destinationOffset += attribute.size;
+        }
+        primitive->vertexCount = newVertexCount;
+    }
+
+    // write back the indices, the index type stays valid as the vertex count can only decrease
+    if (primitive->indexType == MTLIndexTypeUInt16)
+    {
+        auto* destination = static_cast<uint16_t*>(indexData);
+        for (size_t i = 0; i < indexCount; i++)
+        {
+            destination[i] = static_cast<uint16_t>(indices[i]);
+        }
+    }
+    else
+    {
+        memcpy(indexData, indices.data(), indexCount * sizeof(uint32_t));
+    }
+
+    meshopt_VertexCacheStatistics after = meshopt_analyzeVertexCache(indices.data(), indexCount, newVertexCount, analysisCacheSize, 0, 0);
+
+    outStatistics->primitiveCount++;
+    outStatistics->triangleCount += indexCount / 3;
+    outStatistics->vertexCountBefore += vertexCount;
+    outStatistics->vertexCountAfter += newVertexCount;
+    outStatistics->transformedVerticesBefore += before.vertices_transformed;
+    outStatistics->transformedVerticesAfter += after.vertices_transformed;
+}
+
+size_t generateLods(
+    std::span<float3 const> positions, std::span<float3 const> normals, std::span<uint32_t const> indices,
+    std::span<IndexRange const> ranges, LodSettings settings,
+    std::span<uint32_t> outIndices, std::span<IndexRange> outRanges, std::span<float> outErrors)
+{
+    assert(settings.levelCount >= 1);
+    assert(normals.empty() || normals.size() == positions.size());
+    assert(outIndices.size() >= indices.size() * settings.levelCount);
+    assert(outRanges.size() >= ranges.size() * settings.levelCount);
+    assert(outErrors.size() >= settings.levelCount);
+
+    // full detail
+    std::copy(indices.begin(), indices.end(), outIndices.begin());
+    std::copy(ranges.begin(), ranges.end(), outRanges.begin());
+    outErrors[0] = 0.0f;
+    size_t indexCount = indices.size();
+    size_t previousLevelIndexCount = indices.size();
+
+    float const normalWeights[3] = {settings.normalWeight, settings.normalWeight, settings.normalWeight};
+    size_t levelCount = 1;
+    for (; levelCount < settings.levelCount; levelCount++)
+    {
+        std::span<IndexRange const> previousRanges = outRanges.subspan((levelCount - 1) * ranges.size(), ranges.size());
+        std::span<IndexRange> levelRanges = outRanges.subspan(levelCount * ranges.size(), ranges.size());
+        size_t levelIndexCount = 0;
+        float levelError = 0.0f;
+        for (size_t i = 0; i < ranges.size(); i++)
+        {
+            IndexRange source = previousRanges[i];
+            if (source.count == 0)
+            {
+                levelRanges[i] = IndexRange{.offset = indexCount + levelIndexCount, .count = 0};
+                continue;
+            }
+            size_t targetIndexCount = static_cast<size_t>((float)source.count * settings.indexRatio) / 3 * 3;
+            float error = 0.0f;
+            size_t count;
+            if (normals.empty())
+            {
+                count = meshopt_simplify(
+                    &outIndices[indexCount + levelIndexCount], &outIndices[source.offset], source.count,
+                    &positions[0].x, positions.size(), sizeof(float3),
+                    targetIndexCount, settings.maxError, meshopt_SimplifyLockBorder, &error);
+            }
+            else
+            {
+                count = meshopt_simplifyWithAttributes(
+                    &outIndices[indexCount + levelIndexCount], &outIndices[source.offset], source.count,
+                    &positions[0].x, positions.size(), sizeof(float3),
+                    &normals[0].x, sizeof(float3), normalWeights, 3, nullptr,
+                    targetIndexCount, settings.maxError, meshopt_SimplifyLockBorder, &error);
+            }
+            levelRanges[i] = IndexRange{.offset = indexCount + levelIndexCount, .count = count};
+            levelIndexCount += count;
+            levelError = std::max(levelError, error);
+        }
+
+        if (levelIndexCount == 0 || (float)levelIndexCount > (float)previousLevelIndexCount * lodMaxIndexRatio)
+        {
+            break;
+        }
+        // the error of a level is relative to the previous level, so it is accumulated
+        outErrors[levelCount] = outErrors[levelCount - 1] + levelError;
+        indexCount += levelIndexCount;
+        previousLevelIndexCount = levelIndexCount;
+    }
+    return levelCount;
+}
@@ -11,6 +11,7 @@
 #include <filesystem>
 
 #include "glm/detail/type_mat4x4.hpp"
+#include "glm/detail/type_vec3.hpp"
 
 namespace model
 {
@@ -32,9 +33,28 @@ namespace model
         size_t materialIndex = invalidIndex;
     };
 
+    // level of detail of a mesh, the indices of all levels are stored in the same index buffer as the full detail indices
+    struct MeshLod
+    {
+        float error; // simplification error relative to the size of the mesh (see meshopt_simplifyScale), 0 for full detail
+        std::vector<IndexRange> primitiveRanges; // per primitive, the offset is relative to the indexBufferOffset of the primitive
+    };
+
     struct Mesh
     {
         std::vector<Primitive> primitives;
+
+        // from full detail to coarsest, empty if the mesh only has the full detail
+        std::vector<MeshLod> lods;
+
+        // bounds of the vertex positions (before the node transform), used for selecting the level of detail
+        glm::vec3 boundsMin{0};
+        glm::vec3 boundsMax{0};
+
+        // closed, simplified meshes that are entirely inside the mesh (see generateBoxOccluders), in the same space as
+        // the vertex positions. rasterized on the CPU to cull meshes behind them, empty if the mesh is not an occluder
+        std::vector<glm::vec3> occluderPositions;
+        std::vector<uint32_t> occluderIndices;
     };
 
     struct Node
@@ -53,6 +73,11 @@ namespace model
     // used for both ifc and gltf
     struct Model
     {
+        // vertex and index data of all primitives, sub-allocated from a few large buffers
+        // so that primitives share buffer bindings, and we avoid creating thousands of small MTLBuffers
+        BufferArena vertexArena;
+        BufferArena indexArena;
+
         // data
         std::vector<Mesh> meshes;
         std::vector<id <MTLTexture>> textures;
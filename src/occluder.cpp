@@ -0,0 +1,255 @@
+#include "occluder.h"
+
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+#include <limits>
+
+#include "glm/common.hpp"
+
+// first solid interval along the thickness axis of the ray through a sample, enter > exit when the ray misses the mesh
+struct OccluderInterval
+{
+    float enter;
+    float exit;
+};
+
+[[nodiscard]] static OccluderInterval intersectIntervals(OccluderInterval a, OccluderInterval b)
+{
+    return {std::max(a.enter, b.enter), std::min(a.exit, b.exit)};
+}
+
+void generateBoxOccluders(
+    std::span<glm::vec3 const> positions, std::span<uint32_t const> indices, OccluderSettings settings,
+    ScratchArena* scratch, std::vector<OccluderBox>* outBoxes)
+{
+    assert(indices.size() % 3 == 0);
+    assert(settings.gridResolution > 0);
+    if (indices.empty())
+    {
+        return;
+    }
+
+    glm::vec3 min(std::numeric_limits<float>::max());
+    glm::vec3 max(std::numeric_limits<float>::lowest());
+    for (uint32_t index: indices)
+    {
+        min = glm::min(min, positions[index]);
+        max = glm::max(max, positions[index]);
+    }
+    glm::vec3 size = max - min;
+
+    // the rays are cast along axis t (the thickness), the grid spans axes u and v
+    int t = 0;
+    t = size[1] < size[t] ? 1 : t;
+    t = size[2] < size[t] ? 2 : t;
+    int u = (t + 1) % 3;
+    int v = (t + 2) % 3;
+    if (size[t] <= 0.0f)
+    {
+        return;
+    }
+    float cellSize = std::max(size[u], size[v]) / (float)settings.gridResolution;
+    size_t cellsU = std::max((size_t)1, (size_t)std::lround(size[u] / cellSize));
+    size_t cellsV = std::max((size_t)1, (size_t)std::lround(size[v] / cellSize));
+    size_t samplesU = cellsU + 1;
+    size_t samplesV = cellsV + 1;
+    size_t sampleCount = samplesU * samplesV;
+
+    // samples are inset from the bounds, so that rays don't graze the sides of the mesh
+    float startU = min[u] + size[u] * 1e-3f;
+    float startV = min[v] + size[v] * 1e-3f;
+    float stepU = size[u] * (1.0f - 2e-3f) / (float)cellsU;
+    float stepV = size[v] * (1.0f - 2e-3f) / (float)cellsV;
+
+    // hits per sample, counted in the first pass and stored in the second pass
+    std::span<uint32_t> hitOffsets = allocateScratchArray<uint32_t>(scratch, sampleCount + 1);
+    std::span<uint32_t> hitCounts = allocateScratchArray<uint32_t>(scratch, sampleCount);
+    std::fill(hitCounts.begin(), hitCounts.end(), 0);
+    std::span<float> hits;
+    for (int pass = 0; pass < 2; pass++)
+    {
+        for (size_t i = 0; i < indices.size(); i += 3)
+        {
+            glm::vec3 a = positions[indices[i]];
+            glm::vec3 b = positions[indices[i + 1]];
+            glm::vec3 c = positions[indices[i + 2]];
+            float area = (b[u] - a[u]) * (c[v] - a[v]) - (b[v] - a[v]) * (c[u] - a[u]);
+            if (std::abs(area) <= std::numeric_limits<float>::epsilon() * size[u] * size[v])
+            {
+                continue; // parallel to the rays
+            }
+
+            // samples inside the bounds of the triangle
+            float minU = std::min({a[u], b[u], c[u]});
+            float maxU = std::max({a[u], b[u], c[u]});
+            float minV = std::min({a[v], b[v], c[v]});
+            float maxV = std::max({a[v], b[v], c[v]});
+            auto firstU = (size_t)std::clamp(std::ceil((minU - startU) / stepU), 0.0f, (float)samplesU);
+            auto endU = (size_t)std::clamp(std::floor((maxU - startU) / stepU) + 1.0f, 0.0f, (float)samplesU);
+            auto firstV = (size_t)std::clamp(std::ceil((minV - startV) / stepV), 0.0f, (float)samplesV);
+            auto endV = (size_t)std::clamp(std::floor((maxV - startV) / stepV) + 1.0f, 0.0f, (float)samplesV);
+
+            for (size_t sampleV = firstV; sampleV < endV; sampleV++)
+            {
+                for (size_t sampleU = firstU; sampleU < endU; sampleU++)
+                {
+                    float pu = startU + stepU * (float)sampleU;
+                    float pv = startV + stepV * (float)sampleV;
+                    float wa = ((b[u] - pu) * (c[v] - pv) - (b[v] - pv) * (c[u] - pu)) / area;
+                    float wb = ((c[u] - pu) * (a[v] - pv) - (c[v] - pv) * (a[u] - pu)) / area;
+                    float wc = 1.0f - wa - wb;
+                    if (wa < 0.0f || wb < 0.0f || wc < 0.0f)
+                    {
+                        continue;
+                    }
+                    size_t sample = sampleV * samplesU + sampleU;
+                    if (pass == 0)
+                    {
+                        hitCounts[sample]++;
+                    }
+                    else
+                    {
+                        hits[hitOffsets[sample] + hitCounts[sample]++] = wa * a[t] + wb * b[t] + wc * c[t];
+                    }
+                }
+            }
+        }
+
+        if (pass == 0)
+        {
+            hitOffsets[0] = 0;
+            for (size_t i = 0; i < sampleCount; i++)
+            {
+                hitOffsets[i + 1] = hitOffsets[i] + hitCounts[i];
+            }
+            hits = allocateScratchArray<float>(scratch, hitOffsets[sampleCount]);
+            std::fill(hitCounts.begin(), hitCounts.end(), 0);
+        }
+    }
+
+    // the mesh is closed, so the hits alternate between entering and exiting the mesh
+    // a ray that passes exactly through an edge or vertex hits multiple triangles at the same point, which are merged
+    float mergeDistance = size[t] * 1e-4f;
+    std::span<OccluderInterval> sampleIntervals = allocateScratchArray<OccluderInterval>(scratch, sampleCount);
+    for (size_t i = 0; i < sampleCount; i++)
+    {
+        std::span<float> sampleHits = hits.subspan(hitOffsets[i], hitOffsets[i + 1] - hitOffsets[i]);
+        std::sort(sampleHits.begin(), sampleHits.end());
+        auto end = std::unique(sampleHits.begin(), sampleHits.end(), [mergeDistance](float lhs, float rhs) {
+            return rhs - lhs <= mergeDistance;
+        });
+        bool hasInterval = end - sampleHits.begin() >= 2;
+        sampleIntervals[i] = hasInterval ? OccluderInterval{sampleHits[0], sampleHits[1]} : OccluderInterval{1.0f, 0.0f};
+    }
+
+    // a cell is solid when the rays through its corners pass through the same part of the mesh
+    float minThickness = size[t] * settings.minThicknessRatio;
+    auto isThick = [minThickness](OccluderInterval interval) { return interval.exit - interval.enter >= minThickness; };
+    size_t cellCount = cellsU * cellsV;
+    std::span<OccluderInterval> cellIntervals = allocateScratchArray<OccluderInterval>(scratch, cellCount);
+    std::span<bool> cellsUsed = allocateScratchArray<bool>(scratch, cellCount);
+    for (size_t cellV = 0; cellV < cellsV; cellV++)
+    {
+        for (size_t cellU = 0; cellU < cellsU; cellU++)
+        {
+            size_t sample = cellV * samplesU + cellU;
+            OccluderInterval interval = intersectIntervals(
+                intersectIntervals(sampleIntervals[sample], sampleIntervals[sample + 1]),
+                intersectIntervals(sampleIntervals[sample + samplesU], sampleIntervals[sample + samplesU + 1]));
+            cellIntervals[cellV * cellsU + cellU] = interval;
+            cellsUsed[cellV * cellsU + cellU] = !isThick(interval); // cells that are not solid are never used
+        }
+    }
+
+    // greedily merge the solid cells into rectangles, first along u, then along v
+    std::vector<OccluderBox> boxes;
+    for (size_t cellV = 0; cellV < cellsV; cellV++)
+    {
+        for (size_t cellU = 0; cellU < cellsU; cellU++)
+        {
+            if (cellsUsed[cellV * cellsU + cellU])
+            {
+                continue;
+            }
+            OccluderInterval interval = cellIntervals[cellV * cellsU + cellU];
+            size_t endU = cellU + 1;
+            while (endU < cellsU && !cellsUsed[cellV * cellsU + endU] &&
+                   isThick(intersectIntervals(interval, cellIntervals[cellV * cellsU + endU])))
+            {
+                interval = intersectIntervals(interval, cellIntervals[cellV * cellsU + endU]);
+                endU++;
+            }
+            size_t endV = cellV + 1;
+            while (endV < cellsV)
+            {
+                OccluderInterval rowInterval = interval;
+                bool solid = true;
+                for (size_t i = cellU; i < endU && solid; i++)
+                {
+                    rowInterval = intersectIntervals(rowInterval, cellIntervals[endV * cellsU + i]);
+                    solid = !cellsUsed[endV * cellsU + i] && isThick(rowInterval);
+                }
+                if (!solid)
+                {
+                    break;
+                }
+                interval = rowInterval;
+                endV++;
+            }
+            for (size_t j = cellV; j < endV; j++)
+            {
+                std::fill_n(cellsUsed.begin() + (ptrdiff_t)(j * cellsU + cellU), endU - cellU, true);
+            }
+
+            OccluderBox* box = &boxes.emplace_back();
+            box->min[u] = startU + stepU * (float)cellU;
+            box->max[u] = startU + stepU * (float)endU;
+            box->min[v] = startV + stepV * (float)cellV;
+            box->max[v] = startV + stepV * (float)endV;
+            box->min[t] = interval.enter;
+            box->max[t] = interval.exit;
+        }
+    }
+
+    auto getArea = [u, v](OccluderBox const& box) { return (box.max[u] - box.min[u]) * (box.max[v] - box.min[v]); };
+    std::stable_sort(boxes.begin(), boxes.end(), [&getArea](OccluderBox const& lhs, OccluderBox const& rhs) {
+        return getArea(lhs) > getArea(rhs);
+    });
+    float minArea = size[u] * size[v] * settings.minBoxAreaRatio;
+    for (size_t i = 0; i < boxes.size() && i < settings.maxBoxCount && getArea(boxes[i]) >= minArea; i++)
+    {
+        outBoxes->emplace_back(boxes[i]);
+    }
+}
+
+void appendOccluderBox(OccluderBox const& box, std::vector<glm::vec3>* outPositions, std::vector<uint32_t>* outIndices)
+{
+    // corner i uses the max of axis x, y and z when bit 0, 1 and 2 of i are set
+    auto firstVertex = (uint32_t)outPositions->size();
+    for (uint32_t i = 0; i < 8; i++)
+    {
+        outPositions->emplace_back(
+            (i & 1) ? box.max.x : box.min.x,
+            (i & 2) ? box.max.y : box.min.y,
+            (i & 4) ? box.max.z : box.min.z);
+    }
+
+    //@formatter:off
+    constexpr uint32_t quads[6][4] = {
+        {0, 4, 6, 2}, // -x
+        {1, 3, 7, 5}, // +x
+        {0, 1, 5, 4}, // -y
+        {2, 6, 7, 3}, // +y
+        {0, 2, 3, 1}, // -z
+        {4, 5, 7, 6}  // +z
+    };
+    //@formatter:on
+    for (uint32_t const* quad: quads)
+    {
+        for (uint32_t corner: {quad[0], quad[1], quad[2], quad[0], quad[2], quad[3]})
+        {
+            outIndices->emplace_back(firstVertex + corner);
+        }
+    }
+}
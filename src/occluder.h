@@ -0,0 +1,41 @@
+#ifndef METAL_EXPERIMENT_OCCLUDER_H
+#define METAL_EXPERIMENT_OCCLUDER_H
+
+#include "scratch_arena.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <span>
+#include <vector>
+
+#include "glm/vec3.hpp"
+
+struct OccluderSettings
+{
+    size_t gridResolution = 16; // amount of grid cells along the longest side of the mesh
+    float minThicknessRatio = 0.5f; // a cell is only solid if it is at least this thick, relative to the thickness of the mesh
+    size_t maxBoxCount = 8; // per mesh, the largest boxes are kept
+    float minBoxAreaRatio = 1.0f / 64.0f; // boxes smaller than this, relative to the area of the mesh, are discarded
+};
+
+struct OccluderBox
+{
+    glm::vec3 min;
+    glm::vec3 max;
+};
+
+// generates boxes that are inside a closed mesh, to be used as occluders instead of the mesh (e.g. a wall or a slab)
+// the mesh is assumed to be a flat solid (e.g. a wall, slab or roof): rays are cast along the shortest axis of its
+// bounds on a grid over the two other axes. a cell of the grid is solid when the rays through its corners all pass
+// through the mesh, and the cells are merged into as few boxes as possible, each spanning the thickness all its cells
+// have in common. openings (e.g. windows) that are larger than a cell are kept open, smaller openings between the
+// rays can be missed. meshes that are not axis aligned in their local space result in few or no boxes.
+// the boxes are appended to outBoxes, largest first. temporaries are allocated from scratch
+void generateBoxOccluders(
+    std::span<glm::vec3 const> positions, std::span<uint32_t const> indices, OccluderSettings settings,
+    ScratchArena* scratch, std::vector<OccluderBox>* outBoxes);
+
+// appends the 8 corners and 12 triangles of the box, with outward facing (counter-clockwise) triangles
+void appendOccluderBox(OccluderBox const& box, std::vector<glm::vec3>* outPositions, std::vector<uint32_t>* outIndices);
+
+#endif //METAL_EXPERIMENT_OCCLUDER_H
@@ -0,0 +1,202 @@
+#include "occlusion_culling.h"
+
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+#include <limits>
+
+#include "glm/vec4.hpp"
+
+// position in pixels, with 1 / w as depth
+struct OcclusionVertex
+{
+    float x;
+    float y;
+    float inverseW;
+};
+
+[[nodiscard]] static OcclusionVertex projectToScreen(OcclusionBuffer const* buffer, glm::vec4 clip)
+{
+    float inverseW = 1.0f / clip.w;
+    return {
+        .x = (clip.x * inverseW * 0.5f + 0.5f) * (float)buffer->width,
+        .y = (clip.y * inverseW * 0.5f + 0.5f) * (float)buffer->height,
+        .inverseW = inverseW
+    };
+}
+
+void clearOcclusionBuffer(uint32_t width, uint32_t height, glm::mat4 const& viewProjection, float near, OcclusionBuffer* outBuffer)
+{
+    assert(near > 0.0f);
+    outBuffer->width = width;
+    outBuffer->height = height;
+    outBuffer->depth.assign((size_t)width * height, 0.0f);
+    outBuffer->viewProjection = viewProjection;
+    outBuffer->near = near;
+    outBuffer->triangleCount = 0;
+}
+
+static void rasterizeTriangle(OcclusionBuffer* buffer, OcclusionVertex a, OcclusionVertex b, OcclusionVertex c)
+{
+    float area = (b.x - a.x) * (c.y - a.y) - (b.y - a.y) * (c.x - a.x);
+    if (area == 0.0f)
+    {
+        return;
+    }
+
+    // pixel centers inside the bounds of the triangle
+    auto minX = (int)std::max(std::ceil(std::min({a.x, b.x, c.x}) - 0.5f), 0.0f);
+    auto maxX = (int)std::min(std::floor(std::max({a.x, b.x, c.x}) - 0.5f), (float)buffer->width - 1.0f);
+    auto minY = (int)std::max(std::ceil(std::min({a.y, b.y, c.y}) - 0.5f), 0.0f);
+    auto maxY = (int)std::min(std::floor(std::max({a.y, b.y, c.y}) - 0.5f), (float)buffer->height - 1.0f);
+
+    for (int y = minY; y <= maxY; y++)
+    {
+        for (int x = minX; x <= maxX; x++)
+        {
+            float px = (float)x + 0.5f;
+            float py = (float)y + 0.5f;
+            float wa = ((b.x - px) * (c.y - py) - (b.y - py) * (c.x - px)) / area;
+            float wb = ((c.x - px) * (a.y - py) - (c.y - py) * (a.x - px)) / area;
+            float wc = 1.0f - wa - wb;
+            if (wa < 0.0f || wb < 0.0f || wc < 0.0f)
+            {
+                continue;
+            }
+            float* depth = &buffer->depth[(size_t)y * buffer->width + x];
+            *depth = std::max(*depth, wa * a.inverseW + wb * b.inverseW + wc * c.inverseW);
+        }
+    }
+}
+
+void rasterizeOccluder(
+    OcclusionBuffer* buffer, std::span<glm::vec3 const> positions, std::span<uint32_t const> indices,
+    glm::mat4 const& localToWorld)
+{
+    assert(indices.size() % 3 == 0);
+    glm::mat4 localToClip = buffer->viewProjection * localToWorld;
+    for (size_t i = 0; i < indices.size(); i += 3)
+    {
+        glm::vec4 triangle[3];
+        for (size_t j = 0; j < 3; j++)
+        {
+            triangle[j] = localToClip * glm::vec4(positions[indices[i + j]], 1.0f);
+        }
+
+        // clip against w >= near (Sutherland-Hodgman with a single plane), which results in at most 4 vertices
+        glm::vec4 polygon[4];
+        size_t vertexCount = 0;
+        for (size_t j = 0; j < 3; j++)
+        {
+            glm::vec4 current = triangle[j];
+            glm::vec4 next = triangle[(j + 1) % 3];
+            float currentDistance = current.w - buffer->near;
+            float nextDistance = next.w - buffer->near;
+            if (currentDistance >= 0.0f)
+            {
+                polygon[vertexCount++] = current;
+            }
+            if ((currentDistance >= 0.0f) != (nextDistance >= 0.0f))
+            {
+                float t = currentDistance / (currentDistance - nextDistance);
+                polygon[vertexCount++] = current + (next - current) * t;
+            }
+        }
+        if (vertexCount < 3)
+        {
+            continue;
+        }
+
+        OcclusionVertex first = projectToScreen(buffer, polygon[0]);
+        for (size_t j = 1; j + 1 < vertexCount; j++)
+        {
+            rasterizeTriangle(buffer, first, projectToScreen(buffer, polygon[j]), projectToScreen(buffer, polygon[j + 1]));
+        }
+        buffer->triangleCount++;
+    }
+}
+
+void finalizeOcclusionBuffer(OcclusionBuffer* buffer)
+{
+    if (buffer->depth.empty())
+    {
+        return;
+    }
+
+    // separable minimum filter, first horizontal, then vertical. pixels outside the buffer are not occluded
+    auto width = (size_t)buffer->width;
+    auto height = (size_t)buffer->height;
+    std::vector<float> horizontal(buffer->depth.size());
+    for (size_t y = 0; y < height; y++)
+    {
+        float const* row = &buffer->depth[y * width];
+        for (size_t x = 0; x < width; x++)
+        {
+            float left = x > 0 ? row[x - 1] : 0.0f;
+            float right = x + 1 < width ? row[x + 1] : 0.0f;
+            horizontal[y * width + x] = std::min({left, row[x], right});
+        }
+    }
+    for (size_t y = 0; y < height; y++)
+    {
+        for (size_t x = 0; x < width; x++)
+        {
+            float top = y > 0 ? horizontal[(y - 1) * width + x] : 0.0f;
+            float bottom = y + 1 < height ? horizontal[(y + 1) * width + x] : 0.0f;
+            buffer->depth[y * width + x] = std::min({top, horizontal[y * width + x], bottom});
+        }
+    }
+}
+
+bool isBoxOccluded(OcclusionBuffer const* buffer, glm::vec3 min, glm::vec3 max, glm::mat4 const& localToWorld)
+{
+    if (buffer->depth.empty())
+    {
+        return false;
+    }
+
+    // screen space bounds of the corners, w is linear in the position, so the closest point of the box is a corner
+    glm::mat4 localToClip = buffer->viewProjection * localToWorld;
+    float minX = std::numeric_limits<float>::max();
+    float maxX = std::numeric_limits<float>::lowest();
+    float minY = std::numeric_limits<float>::max();
+    float maxY = std::numeric_limits<float>::lowest();
+    float closest = 0.0f;
+    for (int i = 0; i < 8; i++)
+    {
+        glm::vec3 corner((i & 1) ? max.x : min.x, (i & 2) ? max.y : min.y, (i & 4) ? max.z : min.z);
+        glm::vec4 clip = localToClip * glm::vec4(corner, 1.0f);
+        if (clip.w <= buffer->near)
+        {
+            return false;
+        }
+        OcclusionVertex vertex = projectToScreen(buffer, clip);
+        minX = std::min(minX, vertex.x);
+        maxX = std::max(maxX, vertex.x);
+        minY = std::min(minY, vertex.y);
+        maxY = std::max(maxY, vertex.y);
+        closest = std::max(closest, vertex.inverseW);
+    }
+
+    // all pixels the bounds touch
+    auto firstX = (int)std::max(std::floor(minX), 0.0f);
+    auto lastX = (int)std::min(std::ceil(maxX) - 1.0f, (float)buffer->width - 1.0f);
+    auto firstY = (int)std::max(std::floor(minY), 0.0f);
+    auto lastY = (int)std::min(std::ceil(maxY) - 1.0f, (float)buffer->height - 1.0f);
+    if (firstX > lastX || firstY > lastY)
+    {
+        return false;
+    }
+
+    for (int y = firstY; y <= lastY; y++)
+    {
+        for (int x = firstX; x <= lastX; x++)
+        {
+            if (buffer->depth[(size_t)y * buffer->width + x] <= closest)
+            {
+                return false;
+            }
+        }
+    }
+    return true;
+}
@@ -0,0 +1,44 @@
+#ifndef METAL_EXPERIMENT_OCCLUSION_CULLING_H
+#define METAL_EXPERIMENT_OCCLUSION_CULLING_H
+
+#include <cstddef>
+#include <cstdint>
+#include <span>
+#include <vector>
+
+#include "glm/mat4x4.hpp"
+#include "glm/vec3.hpp"
+
+// low resolution depth buffer that occluders are rasterized into on the CPU, to test the bounds of other meshes against
+// before drawing them. depth is stored as 1 / w (w is the distance along the view direction for a perspective
+// projection), so that it can be interpolated linearly in screen space and is independent of the depth range of the
+// projection. larger values are closer to the camera
+struct OcclusionBuffer
+{
+    uint32_t width = 0;
+    uint32_t height = 0;
+    std::vector<float> depth; // 1 / w of the closest occluder per pixel, 0 where no occluder has been rasterized
+    glm::mat4 viewProjection{1};
+    float near = 0.0f; // geometry closer than this is clipped
+    size_t triangleCount = 0; // amount of occluder triangles rasterized since the last clear
+};
+
+// resizes the buffer if needed and removes all occluders
+void clearOcclusionBuffer(uint32_t width, uint32_t height, glm::mat4 const& viewProjection, float near, OcclusionBuffer* outBuffer);
+
+// rasterizes the triangles of a closed occluder mesh, both front and back faces, clipped to the near plane
+// a pixel is covered when its center is inside a triangle
+void rasterizeOccluder(
+    OcclusionBuffer* buffer, std::span<glm::vec3 const> positions, std::span<uint32_t const> indices,
+    glm::mat4 const& localToWorld);
+
+// should be called after all occluders have been rasterized. as the occluders are only sampled at the pixel centers,
+// each pixel is set to the farthest depth of itself and its neighbours, so that an occluder only covers the pixels it
+// covers entirely, and a mesh that is visible next to the edge of an occluder is not culled
+void finalizeOcclusionBuffer(OcclusionBuffer* buffer);
+
+// returns true when the box (transformed by localToWorld) is behind the occluders for every pixel it covers
+// returns false when the box intersects the near plane or is outside the buffer
+[[nodiscard]] bool isBoxOccluded(OcclusionBuffer const* buffer, glm::vec3 min, glm::vec3 max, glm::mat4 const& localToWorld);
+
+#endif //METAL_EXPERIMENT_OCCLUSION_CULLING_H
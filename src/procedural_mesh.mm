@@ -275,9 +275,9 @@ PrimitiveDeinterleaved createRoundedCube(id <MTLDevice> device, simd_float3 size
     }
 
     PrimitiveDeinterleavedDescriptor descriptor{
-        .positions = &data.positions,
-        .normals = &data.normals,
-        .indices = &data.indices,
+        .positions = data.positions,
+        .normals = data.normals,
+        .indices = data.indices,
         .primitiveType = MTLPrimitiveTypeTriangle
     };
     return createPrimitiveDeinterleaved(device, &descriptor);
@@ -334,9 +334,9 @@ PrimitiveDeinterleaved createUVSphere(id <MTLDevice> device, int horizontalDivis
     }
 
     PrimitiveDeinterleavedDescriptor descriptor{
-        .positions = &positions,
-        .uv0s = &uv0s,
-        .indices = &indices,
+        .positions = positions,
+        .uv0s = uv0s,
+        .indices = indices,
         .primitiveType = MTLPrimitiveTypeTriangle
     };
     return createPrimitiveDeinterleaved(device, &descriptor);
@@ -367,8 +367,8 @@ PrimitiveDeinterleaved createCubeWithoutUV(id <MTLDevice> device)
     };
 
     PrimitiveDeinterleavedDescriptor descriptor{
-        .positions = &positions,
-        .indices = &indices,
+        .positions = positions,
+        .indices = indices,
         .primitiveType = MTLPrimitiveTypeTriangleStrip
     };
     return createPrimitiveDeinterleaved(device, &descriptor);
@@ -454,9 +454,9 @@ PrimitiveDeinterleaved createCube(id <MTLDevice> device)
     };
 
     PrimitiveDeinterleavedDescriptor descriptor{
-        .positions = &positions,
-        .uv0s = &uv0s,
-        .indices = &indices,
+        .positions = positions,
+        .uv0s = uv0s,
+        .indices = indices,
         .primitiveType = MTLPrimitiveTypeTriangle
     };
     return createPrimitiveDeinterleaved(device, &descriptor);
@@ -481,8 +481,8 @@ PrimitiveDeinterleaved createPlane(id <MTLDevice> device, RectMinMaxf extents)
         {1, 0}
     };
     PrimitiveDeinterleavedDescriptor descriptor{
-        .positions = &positions,
-        .uv0s = &uv0s,
+        .positions = positions,
+        .uv0s = uv0s,
         .primitiveType = MTLPrimitiveTypeTriangleStrip
     };
     return createPrimitiveDeinterleaved(device, &descriptor);
@@ -518,9 +518,9 @@ PrimitiveDeinterleaved createTree(id <MTLDevice> device, float width, float heig
         0, 1, 2, 3, invalidMeshIndex, 4, 5, 6, 7
     };
     PrimitiveDeinterleavedDescriptor descriptor{
-        .positions = &positions,
-        .uv0s = &uv0s,
-        .indices = &indices,
+        .positions = positions,
+        .uv0s = uv0s,
+        .indices = indices,
         .primitiveType = MTLPrimitiveTypeTriangleStrip
     };
     return createPrimitiveDeinterleaved(device, &descriptor);
@@ -627,9 +627,9 @@ PrimitiveDeinterleaved createAxes(id <MTLDevice> device)
     }
 
     PrimitiveDeinterleavedDescriptor descriptor{
-        .positions = &positions,
-        .colors = &colors,
-        .indices = &indices,
+        .positions = positions,
+        .colors = colors,
+        .indices = indices,
         .primitiveType = MTLPrimitiveTypeTriangle
     };
     return createPrimitiveDeinterleaved(device, &descriptor);
@@ -0,0 +1,87 @@
+#include "scratch_arena.h"
+
+#include <algorithm>
+#include <cassert>
+#include <cstdint>
+
+void createScratchArena(size_t blockSize, ScratchArena* outArena)
+{
+    assert(outArena->blocks.empty());
+    outArena->blockSize = blockSize;
+    outArena->blockIndex = 0;
+    outArena->blockOffset = 0;
+    outArena->usedSize = 0;
+}
+
+static void addBlock(ScratchArena* arena, size_t size)
+{
+    size = std::max(size, arena->blockSize);
+    arena->blocks.emplace_back(ScratchBlock{
+        .data = std::make_unique_for_overwrite<unsigned char[]>(size),
+        .size = size
+    });
+    arena->blockAllocationCount++;
+}
+
+// returns the offset in the block at which an allocation with the given alignment can start
+[[nodiscard]] static size_t getAlignedOffset(ScratchBlock const* block, size_t offset, size_t alignment)
+{
+    assert((alignment & (alignment - 1)) == 0 && "alignment should be a power of two");
+    auto address = reinterpret_cast<uintptr_t>(block->data.get()) + offset;
+    return offset + ((alignment - (address & (alignment - 1))) & (alignment - 1));
+}
+
+void* allocateFromScratchArena(ScratchArena* arena, size_t size, size_t alignment)
+{
+    // find the first block from the current block onwards that fits the allocation, or add one
+    size_t offset = 0;
+    while (true)
+    {
+        if (arena->blockIndex == arena->blocks.size())
+        {
+            addBlock(arena, size + alignment - 1);
+        }
+        ScratchBlock* block = &arena->blocks[arena->blockIndex];
+        offset = getAlignedOffset(block, arena->blockOffset, alignment);
+        if (offset + size <= block->size)
+        {
+            break;
+        }
+        // the remainder of the current block is left unused
+        arena->usedSize += block->size - arena->blockOffset;
+        arena->blockIndex++;
+        arena->blockOffset = 0;
+    }
+
+    arena->usedSize += offset - arena->blockOffset + size;
+    arena->blockOffset = offset + size;
+    arena->allocationCount++;
+    arena->peakUsedSize = std::max(arena->peakUsedSize, arena->usedSize);
+    return arena->blocks[arena->blockIndex].data.get() + offset;
+}
+
+void resetScratchArena(ScratchArena* arena)
+{
+    if (arena->blockIndex > 0)
+    {
+        // more than one block was used, replace all blocks with one that fits everything
+        size_t totalSize = 0;
+        for (ScratchBlock const& block: arena->blocks)
+        {
+            totalSize += block.size;
+        }
+        arena->blocks.clear();
+        addBlock(arena, totalSize);
+    }
+    arena->blockIndex = 0;
+    arena->blockOffset = 0;
+    arena->usedSize = 0;
+}
+
+void destroyScratchArena(ScratchArena* arena)
+{
+    arena->blocks.clear();
+    arena->blockIndex = 0;
+    arena->blockOffset = 0;
+    arena->usedSize = 0;
+}
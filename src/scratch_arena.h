@@ -0,0 +1,55 @@
+#ifndef METAL_EXPERIMENT_SCRATCH_ARENA_H
+#define METAL_EXPERIMENT_SCRATCH_ARENA_H
+
+#include <cstddef>
+#include <memory>
+#include <span>
+#include <type_traits>
+#include <vector>
+
+struct ScratchBlock
+{
+    std::unique_ptr<unsigned char[]> data;
+    size_t size = 0;
+};
+
+// resettable linear (bump) allocator for temporary CPU memory, e.g. the per-element arrays of an importer.
+// all allocations are freed at once by resetScratchArena, after which the blocks are reused,
+// so that a loop that allocates the same amount each iteration only allocates heap memory in the first iteration.
+// not thread safe, each thread should use its own arena.
+struct ScratchArena
+{
+    size_t blockSize = 0; // minimum size of a block, larger allocations get their own block
+    std::vector<ScratchBlock> blocks;
+    size_t blockIndex = 0; // block that is currently allocated from
+    size_t blockOffset = 0; // amount of bytes used in the current block
+    size_t usedSize = 0; // sum of all allocations since the last reset, including alignment padding
+
+    // statistics, not cleared by resetScratchArena
+    size_t allocationCount = 0; // amount of allocations served by the arena
+    size_t blockAllocationCount = 0; // amount of heap allocations made by the arena
+    size_t peakUsedSize = 0; // highest usedSize
+};
+
+void createScratchArena(size_t blockSize, ScratchArena* outArena);
+
+// returns uninitialized memory that stays valid until the next reset
+// alignment should be a power of two
+[[nodiscard]] void* allocateFromScratchArena(ScratchArena* arena, size_t size, size_t alignment);
+
+// returns an uninitialized array of count elements, only for types that don't need to be constructed or destroyed
+template<typename Type>
+[[nodiscard]] std::span<Type> allocateScratchArray(ScratchArena* arena, size_t count)
+{
+    static_assert(std::is_trivially_copyable_v<Type> && std::is_trivially_destructible_v<Type>);
+    return {static_cast<Type*>(allocateFromScratchArena(arena, count * sizeof(Type), alignof(Type))), count};
+}
+
+// frees all allocations. when the allocations didn't fit in a single block, the blocks are replaced by
+// one block that is large enough, so that the next iteration fits in one block
+void resetScratchArena(ScratchArena* arena);
+
+// frees all blocks, invalidating all allocations
+void destroyScratchArena(ScratchArena* arena);
+
+#endif //METAL_EXPERIMENT_SCRATCH_ARENA_H
@@ -0,0 +1,64 @@
+#ifndef METAL_EXPERIMENT_SPSC_QUEUE_H
+#define METAL_EXPERIMENT_SPSC_QUEUE_H
+
+#include <atomic>
+#include <bit>
+#include <cassert>
+#include <cstddef>
+#include <memory>
+#include <utility>
+
+// bounded lock free queue for a single producer thread and a single consumer thread (ring buffer)
+// head and tail only increase, and are on separate cache lines so that the two threads don't invalidate each other's
+// cache line on every push and pop
+template<typename Type>
+struct SpscQueue
+{
+    std::unique_ptr<Type[]> slots;
+    size_t capacity = 0; // power of two
+    alignas(64) std::atomic<size_t> head = 0; // next slot to pop, only written by the consumer
+    alignas(64) std::atomic<size_t> tail = 0; // next slot to push, only written by the producer
+};
+
+// capacity is rounded up to a power of two. should not be called while the queue is in use
+template<typename Type>
+void createSpscQueue(size_t capacity, SpscQueue<Type>* outQueue)
+{
+    assert(capacity > 0);
+    outQueue->capacity = std::bit_ceil(capacity);
+    outQueue->slots = std::make_unique<Type[]>(outQueue->capacity);
+    outQueue->head = 0;
+    outQueue->tail = 0;
+}
+
+// producer thread only
+// returns false if the queue is full, value is only moved from when successful
+template<typename Type>
+[[nodiscard]] bool tryPushSpscQueue(SpscQueue<Type>* queue, Type* value)
+{
+    size_t tail = queue->tail.load(std::memory_order_relaxed);
+    if (tail - queue->head.load(std::memory_order_acquire) == queue->capacity)
+    {
+        return false;
+    }
+    queue->slots[tail & (queue->capacity - 1)] = std::move(*value);
+    queue->tail.store(tail + 1, std::memory_order_release);
+    return true;
+}
+
+// consumer thread only
+// returns false if the queue is empty
+template<typename Type>
+[[nodiscard]] bool tryPopSpscQueue(SpscQueue<Type>* queue, Type* outValue)
+{
+    size_t head = queue->head.load(std::memory_order_relaxed);
+    if (head == queue->tail.load(std::memory_order_acquire))
+    {
+        return false;
+    }
+    *outValue = std::move(queue->slots[head & (queue->capacity - 1)]);
+    queue->head.store(head + 1, std::memory_order_release);
+    return true;
+}
+
+#endif //METAL_EXPERIMENT_SPSC_QUEUE_H
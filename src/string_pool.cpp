@@ -0,0 +1,67 @@
+#include "string_pool.h"
+
+#include "hash.h"
+
+#include <algorithm>
+#include <cassert>
+
+constexpr size_t minSlotCount = 16;
+
+// returns the slot that contains the string, or the empty slot where it should be inserted
+[[nodiscard]] static size_t findSlot(StringPool const* pool, std::string_view string)
+{
+    size_t mask = pool->slots.size() - 1;
+    size_t slot = hashString(string) & mask;
+    while (pool->slots[slot] != invalidStringId && getString(pool, pool->slots[slot]) != string)
+    {
+        slot = (slot + 1) & mask; // linear probing
+    }
+    return slot;
+}
+
+StringId internString(StringPool* pool, std::string_view string)
+{
+    size_t stringCount = getStringCount(pool);
+    if (pool->slots.size() < std::max((stringCount + 1) * 2, minSlotCount))
+    {
+        // rehash into twice as many slots
+        pool->slots.assign(std::max(pool->slots.size() * 2, minSlotCount), invalidStringId);
+        for (StringId id = 0; id < stringCount; id++)
+        {
+            pool->slots[findSlot(pool, getString(pool, id))] = id;
+        }
+    }
+
+    size_t slot = findSlot(pool, string);
+    if (pool->slots[slot] != invalidStringId)
+    {
+        return pool->slots[slot];
+    }
+
+    assert(pool->characters.size() + string.size() <= std::numeric_limits<uint32_t>::max());
+    assert(stringCount < invalidStringId);
+    pool->characters.insert(pool->characters.end(), string.begin(), string.end());
+    pool->offsets.emplace_back((uint32_t)pool->characters.size());
+    pool->slots[slot] = (StringId)stringCount;
+    return (StringId)stringCount;
+}
+
+StringId findString(StringPool const* pool, std::string_view string)
+{
+    if (pool->slots.empty())
+    {
+        return invalidStringId;
+    }
+    return pool->slots[findSlot(pool, string)];
+}
+
+std::string_view getString(StringPool const* pool, StringId id)
+{
+    assert(id < getStringCount(pool));
+    return {pool->characters.data() + pool->offsets[id], pool->offsets[id + 1] - pool->offsets[id]};
+}
+
+size_t getStringCount(StringPool const* pool)
+{
+    return pool->offsets.size() - 1;
+}
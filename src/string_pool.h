@@ -0,0 +1,34 @@
+#ifndef METAL_EXPERIMENT_STRING_POOL_H
+#define METAL_EXPERIMENT_STRING_POOL_H
+
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <string_view>
+#include <vector>
+
+using StringId = uint32_t;
+constexpr StringId invalidStringId = std::numeric_limits<StringId>::max();
+
+// interned strings, each unique string is stored once, and all characters are stored in a single array
+// strings are referred to by id, which can be compared instead of the strings themselves
+// strings can't be removed. not thread safe.
+struct StringPool
+{
+    std::vector<char> characters;
+    std::vector<uint32_t> offsets{0}; // per string its start in characters, the last element is the end of the last string
+    std::vector<StringId> slots; // open addressing hash table, at most half of the slots are used
+};
+
+// returns the id of the string, which is added if it doesn't exist yet
+[[nodiscard]] StringId internString(StringPool* pool, std::string_view string);
+
+// returns invalidStringId if the string doesn't exist
+[[nodiscard]] StringId findString(StringPool const* pool, std::string_view string);
+
+// the view is invalidated when a string is added
+[[nodiscard]] std::string_view getString(StringPool const* pool, StringId id);
+
+[[nodiscard]] size_t getStringCount(StringPool const* pool);
+
+#endif //METAL_EXPERIMENT_STRING_POOL_H
@@ -0,0 +1,87 @@
+#include "thread_pool.h"
+
+#include <algorithm>
+#include <cassert>
+
+size_t defaultThreadCount()
+{
+    // hardware_concurrency is allowed to return 0 if it is not computable
+    return std::max<size_t>(std::thread::hardware_concurrency(), 1);
+}
+
+static void workerLoop(ThreadPool* pool)
+{
+    while (true)
+    {
+        std::function<void()> job;
+        {
+            std::unique_lock<std::mutex> lock(pool->mutex);
+            pool->jobAvailable.wait(lock, [pool] { return pool->stopping || !pool->jobs.empty(); });
+            if (pool->jobs.empty())
+            {
+                // stopping and no work left
+                return;
+            }
+            job = std::move(pool->jobs.front());
+            pool->jobs.pop_front();
+            pool->activeJobCount++;
+        }
+
+        job();
+
+        {
+            std::unique_lock<std::mutex> lock(pool->mutex);
+            pool->activeJobCount--;
+            if (pool->jobs.empty() && pool->activeJobCount == 0)
+            {
+                pool->jobsDone.notify_all();
+            }
+        }
+    }
+}
+
+void startThreadPool(ThreadPool* pool, size_t threadCount)
+{
+    assert(pool->threads.empty() && "thread pool already started");
+    if (threadCount == 0)
+    {
+        threadCount = defaultThreadCount();
+    }
+
+    pool->stopping = false;
+    pool->threads.reserve(threadCount);
+    for (size_t i = 0; i < threadCount; i++)
+    {
+        pool->threads.emplace_back(workerLoop, pool);
+    }
+}
+
+void submitJob(ThreadPool* pool, std::function<void()> job)
+{
+    assert(!pool->threads.empty() && "thread pool not started");
+    {
+        std::unique_lock<std::mutex> lock(pool->mutex);
+        pool->jobs.emplace_back(std::move(job));
+    }
+    pool->jobAvailable.notify_one();
+}
+
+void waitForJobs(ThreadPool* pool)
+{
+    std::unique_lock<std::mutex> lock(pool->mutex);
+    pool->jobsDone.wait(lock, [pool] { return pool->jobs.empty() && pool->activeJobCount == 0; });
+}
+
+void stopThreadPool(ThreadPool* pool)
+{
+    {
+        std::unique_lock<std::mutex> lock(pool->mutex);
+        pool->stopping = true;
+    }
+    pool->jobAvailable.notify_all();
+    for (std::thread& thread: pool->threads)
+    {
+        thread.join();
+    }
+    pool->threads.clear();
+}
@@ -0,0 +1,39 @@
+#ifndef METAL_EXPERIMENT_THREAD_POOL_H
+#define METAL_EXPERIMENT_THREAD_POOL_H
+
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// simple fixed size pool of worker threads
+// jobs are started in the order they are submitted, but can complete in any order
+struct ThreadPool
+{
+    std::vector<std::thread> threads;
+    std::deque<std::function<void()>> jobs;
+    std::mutex mutex;
+    std::condition_variable jobAvailable;
+    std::condition_variable jobsDone;
+    size_t activeJobCount = 0;
+    bool stopping = false;
+};
+
+// returns the amount of threads to use when a thread count of 0 (= automatic) is requested
+[[nodiscard]] size_t defaultThreadCount();
+
+// threadCount of 0 uses defaultThreadCount()
+void startThreadPool(ThreadPool* pool, size_t threadCount);
+
+void submitJob(ThreadPool* pool, std::function<void()> job);
+
+// blocks until all submitted jobs have completed
+void waitForJobs(ThreadPool* pool);
+
+// waits for all submitted jobs and joins the worker threads
+void stopThreadPool(ThreadPool* pool);
+
+#endif //METAL_EXPERIMENT_THREAD_POOL_H
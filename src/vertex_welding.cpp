@@ -0,0 +1,72 @@
+#include "vertex_welding.h"
+
+#include "hash.h"
+
+#include <algorithm>
+#include <bit>
+#include <cassert>
+#include <cmath>
+#include <cstring>
+#include <limits>
+
+// grid cell of the position and normal of a vertex
+struct WeldKey
+{
+    int64_t position[3];
+    int64_t normal[3];
+};
+
+constexpr uint32_t emptySlot = std::numeric_limits<uint32_t>::max();
+
+size_t weldVertices(
+    std::span<double const> positions, std::span<double const> normals, VertexWeldTolerance tolerance,
+    ScratchArena* scratch, std::span<uint32_t> outRemap, std::span<uint32_t> outUniqueVertices)
+{
+    assert(positions.size() % 3 == 0);
+    assert(normals.empty() || normals.size() == positions.size());
+    assert(tolerance.position > 0.0 && tolerance.normal > 0.0);
+    size_t vertexCount = positions.size() / 3;
+    assert(outRemap.size() == vertexCount && outUniqueVertices.size() == vertexCount);
+    assert(vertexCount < emptySlot);
+
+    std::span<WeldKey> keys = allocateScratchArray<WeldKey>(scratch, vertexCount);
+    for (size_t i = 0; i < vertexCount; i++)
+    {
+        for (size_t j = 0; j < 3; j++)
+        {
+            keys[i].position[j] = std::llround(positions[i * 3 + j] / tolerance.position);
+            keys[i].normal[j] = normals.empty() ? 0 : std::llround(normals[i * 3 + j] / tolerance.normal);
+        }
+    }
+
+    // slots contain the index of a unique vertex, at most half of the slots are used so that probe sequences stay short
+    size_t slotCount = std::bit_ceil(std::max(vertexCount * 2, (size_t)16));
+    std::span<uint32_t> slots = allocateScratchArray<uint32_t>(scratch, slotCount);
+    std::fill(slots.begin(), slots.end(), emptySlot);
+
+    size_t uniqueVertexCount = 0;
+    for (size_t i = 0; i < vertexCount; i++)
+    {
+        // linear probing
+        size_t slot = hashBytes(&keys[i], sizeof(WeldKey)) & (slotCount - 1);
+        while (true)
+        {
+            uint32_t uniqueVertex = slots[slot];
+            if (uniqueVertex == emptySlot)
+            {
+                slots[slot] = (uint32_t)uniqueVertexCount;
+                outUniqueVertices[uniqueVertexCount] = (uint32_t)i;
+                outRemap[i] = (uint32_t)uniqueVertexCount;
+                uniqueVertexCount++;
+                break;
+            }
+            if (memcmp(&keys[outUniqueVertices[uniqueVertex]], &keys[i], sizeof(WeldKey)) == 0)
+            {
+                outRemap[i] = uniqueVertex;
+                break;
+            }
+            slot = (slot + 1) & (slotCount - 1);
+        }
+    }
+    return uniqueVertexCount;
+}
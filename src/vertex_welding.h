@@ -0,0 +1,27 @@
+#ifndef METAL_EXPERIMENT_VERTEX_WELDING_H
+#define METAL_EXPERIMENT_VERTEX_WELDING_H
+
+#include "scratch_arena.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <span>
+
+// vertices are welded when their positions and normals fall in the same cell of a grid with these cell sizes
+// vertices closer together than the tolerance can still end up in neighbouring cells, in which case they are not welded
+struct VertexWeldTolerance
+{
+    double position = 1e-5; // in model units (e.g. meters)
+    double normal = 1e-3; // per normal component, vertices on both sides of a hard edge stay separate
+};
+
+// welds duplicate vertices of a single mesh with an open addressing hash table of the quantized position and normal.
+// positions and normals contain 3 doubles per vertex (e.g. the output of IfcOpenShell), normals can be empty.
+// outRemap (one per vertex) receives the new index of each vertex, and the first n entries of outUniqueVertices
+// the original index of each new vertex, in the order they first occur. returns n, the amount of unique vertices.
+// no state is shared between calls, so meshes can be welded on multiple threads, each with its own scratch arena
+[[nodiscard]] size_t weldVertices(
+    std::span<double const> positions, std::span<double const> normals, VertexWeldTolerance tolerance,
+    ScratchArena* scratch, std::span<uint32_t> outRemap, std::span<uint32_t> outUniqueVertices);
+
+#endif //METAL_EXPERIMENT_VERTEX_WELDING_H
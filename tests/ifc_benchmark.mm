@@ -0,0 +1,339 @@
+// benchmark of the ifc import pipeline (parsing, tessellation, welding, simplification, occluders, optimization) over all files
+// in <assets path>/ifc, at several tessellation thread counts, to catch regressions between IfcOpenShell versions.
+// the amount of process threads is the default of half the tessellation threads (see IfcImportSettings::processThreadCount)
+//
+// the vertex and index data is written to shared storage buffers of the default device, which is plain memory on the
+// CPU side. no GPU work is submitted and no window is created.
+//
+// usage: ifc_benchmark <assets path> [--threads=1,2,4] [--file=<part of file name>] [--output=<json path>]
+// a summary of each run is logged, the results are written as json to the output path (default ifc_benchmark.json)
+//
+// each run is a separate process (the benchmark spawns itself with --run=<ifc path>), so that the peak resident memory
+// of a run is its own and not that of the largest run before it
+
+#import <Metal/Metal.h>
+
+#include <crt_externs.h>
+#include <mach/mach.h>
+#include <mach-o/dyld.h>
+#include <spawn.h>
+#include <sys/resource.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <climits>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include <ifcparse/IfcFile.h>
+
+#include "import/ifc.h"
+#include "import/import_statistics.h"
+#include "thread_pool.h"
+
+#include "fmt/format.h"
+
+struct BenchmarkOptions
+{
+    std::filesystem::path assetsPath;
+    std::vector<size_t> threadCounts; // empty = 1, 2, 4 and defaultThreadCount()
+    std::string fileFilter; // only files whose name contains this
+    std::filesystem::path outputPath = "ifc_benchmark.json";
+    std::filesystem::path runPath; // if set, only this file is imported in this process, at the first thread count
+};
+
+struct BenchmarkRun
+{
+    std::string file;
+    size_t threadCount = 0;
+    bool succeeded = false;
+    size_t elementCount = 0;
+    size_t triangleCount = 0; // of the meshes, instanced elements only count once (full detail only)
+    size_t peakResidentBytes = 0; // of the process of this run, so it includes the process itself (e.g. the device)
+    size_t residentBytes = 0; // after the import, while the model is still in memory
+    ImportStatistics statistics;
+};
+
+[[nodiscard]] static size_t getPeakResidentBytes()
+{
+    rusage usage{};
+    getrusage(RUSAGE_SELF, &usage);
+    return (size_t)usage.ru_maxrss; // in bytes on macOS
+}
+
+[[nodiscard]] static size_t getResidentBytes()
+{
+    mach_task_basic_info info{};
+    mach_msg_type_number_t count = MACH_TASK_BASIC_INFO_COUNT;
+    if (task_info(mach_task_self(), MACH_TASK_BASIC_INFO, (task_info_t)&info, &count) != KERN_SUCCESS)
+    {
+        return 0;
+    }
+    return info.resident_size;
+}
+
+// returns false if the arguments are invalid
+[[nodiscard]] static bool parseBenchmarkOptions(int argc, char** argv, BenchmarkOptions* outOptions)
+{
+    if (argc < 2)
+    {
+        return false;
+    }
+    outOptions->assetsPath = argv[1];
+    for (int i = 2; i < argc; i++)
+    {
+        std::string_view argument = argv[i];
+        if (argument.starts_with("--threads="))
+        {
+            std::string list(argument.substr(std::string_view("--threads=").size()));
+            size_t start = 0;
+            while (start < list.size())
+            {
+                size_t end = std::min(list.find(',', start), list.size());
+                outOptions->threadCounts.emplace_back(std::stoul(list.substr(start, end - start)));
+                start = end + 1;
+            }
+        }
+        else if (argument.starts_with("--file="))
+        {
+            outOptions->fileFilter = argument.substr(std::string_view("--file=").size());
+        }
+        else if (argument.starts_with("--output="))
+        {
+            outOptions->outputPath = argument.substr(std::string_view("--output=").size());
+        }
+        else if (argument.starts_with("--run="))
+        {
+            outOptions->runPath = argument.substr(std::string_view("--run=").size());
+        }
+        else if (!argument.starts_with("--"))
+        {
+            continue; // e.g. the private assets path that is passed to all test executables
+        }
+        else
+        {
+            return false;
+        }
+    }
+    // a single run is imported at exactly one thread count
+    return outOptions->runPath.empty() || outOptions->threadCounts.size() == 1;
+}
+
+[[nodiscard]] static BenchmarkRun runBenchmark(id <MTLDevice> device, std::filesystem::path const& path, size_t threadCount)
+{
+    // same settings as the app, but without the cache
+    IfcImportSettings settings{
+        .flipYAndZAxes = true,
+        .tessellationThreadCount = threadCount,
+        .quantizeVertices = true,
+        .generateOccluders = true
+    };
+
+    BenchmarkRun run{
+        .file = path.filename().string(),
+        .threadCount = threadCount
+    };
+    model::Model model{};
+    @autoreleasepool
+    {
+        run.succeeded = importIfc(device, path, &model, settings, &run.statistics);
+    }
+
+    for (model::Node const& node: model.nodes)
+    {
+        run.elementCount += node.meshIndex != invalidIndex ? 1 : 0;
+    }
+    for (model::Mesh const& mesh: model.meshes)
+    {
+        for (model::Primitive const& primitive: mesh.primitives)
+        {
+            run.triangleCount += primitive.primitive.indexCount / 3;
+        }
+    }
+    run.peakResidentBytes = getPeakResidentBytes();
+    run.residentBytes = getResidentBytes();
+
+    destroyBufferArena(&model.vertexArena);
+    destroyBufferArena(&model.indexArena);
+    return run;
+}
+
+[[nodiscard]] static std::string benchmarkRunToJson(BenchmarkRun const* run)
+{
+    double seconds = std::max(run->statistics.totalSeconds, 1e-9);
+    return fmt::format(
+        "{{\"file\":\"{}\",\"threads\":{},\"succeeded\":{},\"elements\":{},\"triangles\":{},"
+        "\"elements_per_second\":{:.1f},\"triangles_per_second\":{:.1f},\"peak_rss_bytes\":{},\"rss_bytes\":{},"
+        "\"statistics\":{}}}",
+        escapeJson(run->file), run->threadCount, run->succeeded, run->elementCount, run->triangleCount,
+        (double)run->elementCount / seconds, (double)run->triangleCount / seconds,
+        run->peakResidentBytes, run->residentBytes, importStatisticsToJson(&run->statistics));
+}
+
+[[nodiscard]] static std::string formatBenchmarkRun(BenchmarkRun const* run)
+{
+    double seconds = std::max(run->statistics.totalSeconds, 1e-9);
+    return fmt::format(
+        "benchmark: {} threads={}: {}{} elements, {} triangles in {:.3f} s ({:.0f} elements/s, {:.0f} triangles/s), peak rss {:.1f} MiB",
+        run->file, run->threadCount, run->succeeded ? "" : "FAILED, ", run->elementCount, run->triangleCount, seconds,
+        (double)run->elementCount / seconds, (double)run->triangleCount / seconds,
+        (double)run->peakResidentBytes / (1024.0 * 1024.0));
+}
+
+// imports options->runPath in this process and writes the json of the run to the output path
+// returns the exit code of the process
+[[nodiscard]] static int runBenchmarkProcess(BenchmarkOptions const* options)
+{
+    id <MTLDevice> device = MTLCreateSystemDefaultDevice();
+    if (device == nil)
+    {
+        std::cerr << "benchmark: no Metal device available, the buffers of the import are allocated on the default device" << std::endl;
+        return 1;
+    }
+    BenchmarkRun run = runBenchmark(device, options->runPath, options->threadCounts[0]);
+    [device release];
+    std::cout << formatBenchmarkRun(&run) << std::endl;
+
+    std::string json = benchmarkRunToJson(&run);
+    std::ofstream output(options->outputPath, std::ios::trunc);
+    if (!output || !output.write(json.data(), (std::streamsize)json.size()))
+    {
+        std::cerr << "failed to write " << options->outputPath << std::endl;
+        return 1;
+    }
+    return run.succeeded ? 0 : 1;
+}
+
+// runs the benchmark of a single file in a child process, see runBenchmarkProcess
+// returns the json of the run, or an empty string if the process failed before writing it
+[[nodiscard]] static std::string spawnBenchmarkRun(BenchmarkOptions const* options, std::filesystem::path const& path, size_t threadCount, bool* outSucceeded)
+{
+    char executablePath[PATH_MAX];
+    uint32_t executablePathSize = sizeof(executablePath);
+    if (_NSGetExecutablePath(executablePath, &executablePathSize) != 0)
+    {
+        *outSucceeded = false;
+        return {};
+    }
+    std::filesystem::path outputPath = std::filesystem::temp_directory_path() / fmt::format("ifc_benchmark_{}.json", getpid());
+    std::vector<std::string> arguments{
+        executablePath,
+        options->assetsPath.string(),
+        "--run=" + path.string(),
+        fmt::format("--threads={}", threadCount),
+        "--output=" + outputPath.string()
+    };
+    std::vector<char*> argv;
+    for (std::string& argument: arguments)
+    {
+        argv.emplace_back(argument.data());
+    }
+    argv.emplace_back(nullptr);
+
+    pid_t pid = 0;
+    int status = 0;
+    if (posix_spawn(&pid, executablePath, nullptr, nullptr, argv.data(), *_NSGetEnviron()) != 0 || waitpid(pid, &status, 0) != pid)
+    {
+        *outSucceeded = false;
+        return {};
+    }
+    *outSucceeded = WIFEXITED(status) && WEXITSTATUS(status) == 0;
+
+    std::stringstream json;
+    {
+        std::ifstream input(outputPath);
+        json << input.rdbuf();
+    }
+    std::filesystem::remove(outputPath);
+    return json.str();
+}
+
+int main(int argc, char** argv)
+{
+    BenchmarkOptions options{};
+    if (!parseBenchmarkOptions(argc, argv, &options))
+    {
+        std::cerr << "usage: ifc_benchmark <assets path> [--threads=1,2,4] [--file=<part of file name>] [--output=<json path>]" << std::endl;
+        return 1;
+    }
+    if (!options.runPath.empty())
+    {
+        return runBenchmarkProcess(&options);
+    }
+    if (options.threadCounts.empty())
+    {
+        options.threadCounts = {1, 2, 4, defaultThreadCount()};
+    }
+    std::sort(options.threadCounts.begin(), options.threadCounts.end());
+    options.threadCounts.erase(std::unique(options.threadCounts.begin(), options.threadCounts.end()), options.threadCounts.end());
+
+    std::vector<std::filesystem::path> files;
+    for (std::filesystem::directory_entry const& entry: std::filesystem::directory_iterator(options.assetsPath / "ifc"))
+    {
+        std::string name = entry.path().filename().string();
+        if (entry.is_regular_file() && entry.path().extension() == ".ifc" && name.find(options.fileFilter) != std::string::npos)
+        {
+            files.emplace_back(entry.path());
+        }
+    }
+    std::sort(files.begin(), files.end(), [](std::filesystem::path const& lhs, std::filesystem::path const& rhs) {
+        return file_size(lhs) < file_size(rhs);
+    });
+    if (files.empty())
+    {
+        std::cerr << "no ifc files found in " << options.assetsPath / "ifc" << std::endl;
+        return 1;
+    }
+
+    bool succeeded = true;
+    std::vector<std::string> runs;
+    for (std::filesystem::path const& file: files)
+    {
+        for (size_t threadCount: options.threadCounts)
+        {
+            bool runSucceeded = false;
+            std::string json = spawnBenchmarkRun(&options, file, threadCount, &runSucceeded);
+            if (json.empty())
+            {
+                // the process crashed or could not be started, record the run as failed
+                BenchmarkRun run{
+                    .file = file.filename().string(),
+                    .threadCount = threadCount
+                };
+                std::cout << formatBenchmarkRun(&run) << std::endl;
+                json = benchmarkRunToJson(&run);
+            }
+            succeeded = succeeded && runSucceeded;
+            runs.emplace_back(std::move(json));
+        }
+    }
+
+#ifdef IFCOPENSHELL_VERSION
+    std::string ifcOpenShellVersion = IFCOPENSHELL_VERSION;
+#else
+    std::string ifcOpenShellVersion = "unknown";
+#endif
+    std::string json = fmt::format("{{\"ifcopenshell_version\":\"{}\",\"hardware_threads\":{},\"runs\":[",
+                                   escapeJson(ifcOpenShellVersion), defaultThreadCount());
+    for (size_t i = 0; i < runs.size(); i++)
+    {
+        json += (i > 0 ? "," : "") + runs[i];
+    }
+    json += "]}\n";
+
+    std::ofstream output(options.outputPath, std::ios::trunc);
+    if (!output || !output.write(json.data(), (std::streamsize)json.size()))
+    {
+        std::cerr << "failed to write " << options.outputPath << std::endl;
+        return 1;
+    }
+    std::cout << "benchmark: wrote " << runs.size() << " runs to " << options.outputPath << std::endl;
+
+    return succeeded ? 0 : 1;
+}
@@ -0,0 +1,40 @@
+#include "gtest/gtest.h"
+
+#include "constants.h"
+#include "mesh.h"
+
+namespace mesh_test
+{
+    // the primitive restart index of a 32-bit strip should become the 16-bit restart index when the indices are narrowed
+    TEST(Mesh, NarrowStripWithRestartIndex)
+    {
+        id <MTLDevice> device = MTLCreateSystemDefaultDevice();
+        if (device == nil)
+        {
+            GTEST_SKIP() << "no Metal device";
+        }
+
+        std::vector<float3> positions(8, float3{0, 0, 0});
+        std::vector<uint32_t> indices{0, 1, 2, 3, invalidMeshIndex, 4, 5, 6, 7};
+        PrimitiveDeinterleavedDescriptor descriptor{
+            .positions = positions,
+            .indices = indices,
+            .primitiveType = MTLPrimitiveTypeTriangleStrip
+        };
+        PrimitiveDeinterleaved primitive = createPrimitiveDeinterleaved(device, &descriptor);
+        ASSERT_EQ(primitive.indexType, MTLIndexTypeUInt16);
+        ASSERT_EQ(primitive.indexCount, indices.size());
+
+        auto const* narrowed = reinterpret_cast<uint16_t const*>(
+            static_cast<unsigned char const*>([primitive.indexBuffer contents]) + primitive.indexBufferOffset);
+        for (size_t i = 0; i < indices.size(); i++)
+        {
+            uint16_t expected = indices[i] == invalidMeshIndex ? 0xFFFF : static_cast<uint16_t>(indices[i]);
+            EXPECT_EQ(narrowed[i], expected);
+        }
+
+        [primitive.vertexBuffer release];
+        [primitive.indexBuffer release];
+        [device release];
+    }
+}
@@ -1,8 +1,25 @@
 #include <gtest/gtest.h>
 
+#include <cstdint>
+#include <string>
+#include <thread>
 #include <vector>
 #include <unordered_set>
 
+#include "base64.h"
+#include "hash.h"
+#include "occluder.h"
+#include "occlusion_culling.h"
+#include "scratch_arena.h"
+#include "spsc_queue.h"
+#include "string_pool.h"
+#include "vertex_welding.h"
+#include "import/ifc_index.h"
+
+#include "glm/geometric.hpp"
+#include "glm/vector_relational.hpp"
+#include "glm/gtc/matrix_transform.hpp"
+
 namespace tests
 {
     [[nodiscard]] bool grouped(std::vector<size_t>* indices)
@@ -42,4 +59,291 @@ namespace tests
         std::vector<size_t> indicesGrouped2 = {9, 8, 5, 5, 5, 5, 5, 3, 2, 1, 0, 10, 10, 10};
         ASSERT_TRUE(grouped(&indicesGrouped2));
     }
-}
\ No newline at end of file
+
+    [[nodiscard]] std::string decodeBase64String(std::string const& encoded, bool* outSuccess)
+    {
+        std::vector<unsigned char> decoded(base64DecodedSizeUpperBound(encoded.size()));
+        size_t decodedSize = 0;
+        *outSuccess = decodeBase64(encoded.data(), encoded.size(), decoded.data(), &decodedSize);
+        return {decoded.begin(), decoded.begin() + (*outSuccess ? decodedSize : 0)};
+    }
+
+    TEST(Tests, Base64)
+    {
+        bool success;
+        ASSERT_EQ(decodeBase64String("", &success), "");
+        ASSERT_TRUE(success);
+        ASSERT_EQ(decodeBase64String("Zg==", &success), "f");
+        ASSERT_EQ(decodeBase64String("Zm8=", &success), "fo");
+        ASSERT_EQ(decodeBase64String("Zm9vYg", &success), "foob");
+        ASSERT_EQ(decodeBase64String("Zm9vYmFy", &success), "foobar");
+        ASSERT_TRUE(success);
+
+        // longer than one simd block
+        std::string text = "The quick brown fox jumps over the lazy dog. The quick brown fox jumps over the lazy dog.";
+        std::string encoded = "VGhlIHF1aWNrIGJyb3duIGZveCBqdW1wcyBvdmVyIHRoZSBsYXp5IGRvZy4gVGhlIHF1aWNrIGJyb3duIGZveCBqdW1wcyBvdmVyIHRoZSBsYXp5IGRvZy4=";
+        ASSERT_EQ(decodeBase64String(encoded, &success), text);
+        ASSERT_TRUE(success);
+
+        // invalid character in the simd block and in the tail
+        encoded[10] = '$';
+        (void)decodeBase64String(encoded, &success);
+        ASSERT_FALSE(success);
+        (void)decodeBase64String("Zm9$", &success);
+        ASSERT_FALSE(success);
+    }
+
+    TEST(Tests, ScratchArena)
+    {
+        ScratchArena arena{};
+        createScratchArena(64, &arena);
+
+        std::span<uint32_t> a = allocateScratchArray<uint32_t>(&arena, 4);
+        std::span<double> b = allocateScratchArray<double>(&arena, 2);
+        ASSERT_EQ(reinterpret_cast<uintptr_t>(b.data()) % alignof(double), 0);
+        ASSERT_GE(reinterpret_cast<unsigned char*>(b.data()), reinterpret_cast<unsigned char*>(a.data() + a.size()));
+        ASSERT_EQ(arena.blockAllocationCount, 1);
+
+        // doesn't fit in the first block
+        (void)allocateScratchArray<unsigned char>(&arena, 100);
+        ASSERT_EQ(arena.blockAllocationCount, 2);
+        ASSERT_EQ(arena.allocationCount, 3);
+        size_t usedSize = arena.usedSize;
+        ASSERT_GE(usedSize, 132);
+
+        // the two blocks are replaced by a single block, after which the same allocations don't allocate heap memory
+        resetScratchArena(&arena);
+        ASSERT_EQ(arena.usedSize, 0);
+        ASSERT_EQ(arena.blocks.size(), 1);
+        ASSERT_EQ(arena.blockAllocationCount, 3);
+        for (int i = 0; i < 3; i++)
+        {
+            (void)allocateScratchArray<uint32_t>(&arena, 4);
+            (void)allocateScratchArray<double>(&arena, 2);
+            (void)allocateScratchArray<unsigned char>(&arena, 100);
+            resetScratchArena(&arena);
+        }
+        ASSERT_EQ(arena.blockAllocationCount, 3);
+        ASSERT_EQ(arena.allocationCount, 12);
+        ASSERT_EQ(arena.peakUsedSize, usedSize);
+
+        destroyScratchArena(&arena);
+        ASSERT_TRUE(arena.blocks.empty());
+    }
+
+    TEST(Tests, Hash)
+    {
+        std::string text = "the quick brown fox jumps over the lazy dog";
+        ASSERT_EQ(hashString(text), hashString(text));
+        ASSERT_EQ(hashString(text), hashBytes(text.data(), text.size()));
+        ASSERT_NE(hashString(text), hashString(text, 1));
+
+        // each prefix (which covers all tail lengths) has a different hash
+        std::unordered_set<uint64_t> hashes;
+        for (size_t i = 0; i <= text.size(); i++)
+        {
+            hashes.insert(hashBytes(text.data(), i));
+        }
+        ASSERT_EQ(hashes.size(), text.size() + 1);
+    }
+
+    TEST(Tests, SpscQueue)
+    {
+        SpscQueue<size_t> queue{};
+        createSpscQueue(3, &queue);
+        ASSERT_EQ(queue.capacity, 4);
+
+        // full and empty
+        for (size_t i = 0; i < 4; i++)
+        {
+            ASSERT_TRUE(tryPushSpscQueue(&queue, &i));
+        }
+        size_t value = 4;
+        ASSERT_FALSE(tryPushSpscQueue(&queue, &value));
+        for (size_t i = 0; i < 4; i++)
+        {
+            ASSERT_TRUE(tryPopSpscQueue(&queue, &value));
+            ASSERT_EQ(value, i);
+        }
+        ASSERT_FALSE(tryPopSpscQueue(&queue, &value));
+
+        // values arrive in order when pushed from another thread
+        constexpr size_t count = 100000;
+        std::thread producer([&queue]() {
+            for (size_t i = 0; i < count; i++)
+            {
+                while (!tryPushSpscQueue(&queue, &i))
+                {
+                    std::this_thread::yield();
+                }
+            }
+        });
+        for (size_t i = 0; i < count; i++)
+        {
+            while (!tryPopSpscQueue(&queue, &value))
+            {
+                std::this_thread::yield();
+            }
+            ASSERT_EQ(value, i);
+        }
+        producer.join();
+    }
+
+    TEST(Tests, WeldVertices)
+    {
+        // two triangles of a quad, sharing an edge, and a third triangle at a right angle (hard edge) sharing the same edge
+        std::vector<double> positions{
+            0, 0, 0, 1, 0, 0, 1, 1, 0,
+            0, 0, 0, 1, 1, 0, 0.000001, 1, 0,
+            0, 0, 0, 0, 1, 0, 0, 1, 1
+        };
+        std::vector<double> normals{
+            0, 0, 1, 0, 0, 1, 0, 0, 1,
+            0, 0, 1, 0, 0, 1, 0, 0, 1,
+            1, 0, 0, 1, 0, 0, 1, 0, 0
+        };
+        ScratchArena scratch{};
+        createScratchArena(1024, &scratch);
+        std::vector<uint32_t> remap(9);
+        std::vector<uint32_t> uniqueVertices(9);
+        size_t count = weldVertices(positions, normals, VertexWeldTolerance{}, &scratch, remap, uniqueVertices);
+        ASSERT_EQ(count, 7);
+        ASSERT_EQ(remap, (std::vector<uint32_t>{0, 1, 2, 0, 2, 3, 4, 5, 6}));
+        ASSERT_EQ(uniqueVertices[3], 5);
+
+        // without normals, the hard edge is welded as well
+        resetScratchArena(&scratch);
+        count = weldVertices(positions, {}, VertexWeldTolerance{}, &scratch, remap, uniqueVertices);
+        ASSERT_EQ(count, 5);
+        ASSERT_EQ(remap, (std::vector<uint32_t>{0, 1, 2, 0, 2, 3, 0, 3, 4}));
+        destroyScratchArena(&scratch);
+    }
+
+    TEST(Tests, StringPool)
+    {
+        StringPool pool{};
+        ASSERT_EQ(findString(&pool, "IfcWall"), invalidStringId);
+        StringId wall = internString(&pool, "IfcWall");
+        StringId empty = internString(&pool, "");
+        ASSERT_EQ(internString(&pool, "IfcWall"), wall);
+        ASSERT_NE(empty, wall);
+
+        // enough strings to rehash a few times
+        std::vector<StringId> ids;
+        for (size_t i = 0; i < 1000; i++)
+        {
+            ids.emplace_back(internString(&pool, std::to_string(i)));
+        }
+        for (size_t i = 0; i < 1000; i++)
+        {
+            ASSERT_EQ(findString(&pool, std::to_string(i)), ids[i]);
+            ASSERT_EQ(getString(&pool, ids[i]), std::to_string(i));
+        }
+        ASSERT_EQ(getString(&pool, wall), "IfcWall");
+        ASSERT_EQ(getString(&pool, empty), "");
+        ASSERT_EQ(getStringCount(&pool), 1002);
+    }
+
+    TEST(Tests, IfcElementIndex)
+    {
+        IfcElementIndex index{};
+        addIfcElementInfo(&index, 1, "2O2Fr$t4X7Zf8NOew3FLOH", "IfcWall", "Wall");
+        addIfcElementInfo(&index, 3, "1hOSvn6df7F8_7GcBWlR72", "IfcWall", "Wall");
+
+        ASSERT_EQ(findIfcElementNode(&index, "1hOSvn6df7F8_7GcBWlR72"), 3);
+        ASSERT_EQ(findIfcElementNode(&index, "2O2Fr$t4X7Zf8NOew3FLOH"), 1);
+        ASSERT_EQ(findIfcElementNode(&index, "IfcWall"), invalidIndex); // a string that is not a GlobalId
+        ASSERT_EQ(getIfcElementInfo(&index, 0), nullptr);
+        ASSERT_EQ(getIfcElementInfo(&index, 2), nullptr);
+
+        IfcElementInfo const* info = getIfcElementInfo(&index, 3);
+        ASSERT_NE(info, nullptr);
+        ASSERT_EQ(getString(&index.strings, info->type), "IfcWall");
+        ASSERT_EQ(info->type, getIfcElementInfo(&index, 1)->type); // interned
+        ASSERT_EQ(getStringCount(&index.strings), 4);
+    }
+
+    [[nodiscard]] bool overlaps(OccluderBox const& lhs, OccluderBox const& rhs)
+    {
+        return glm::all(glm::lessThan(lhs.min, rhs.max)) && glm::all(glm::lessThan(rhs.min, lhs.max));
+    }
+
+    TEST(Tests, Occluder)
+    {
+        // the triangles of the box face outwards
+        std::vector<glm::vec3> positions;
+        std::vector<uint32_t> indices;
+        appendOccluderBox(OccluderBox{glm::vec3(0), glm::vec3(1, 2, 3)}, &positions, &indices);
+        ASSERT_EQ(positions.size(), 8);
+        ASSERT_EQ(indices.size(), 36);
+        for (size_t i = 0; i < indices.size(); i += 3)
+        {
+            glm::vec3 a = positions[indices[i]];
+            glm::vec3 b = positions[indices[i + 1]];
+            glm::vec3 c = positions[indices[i + 2]];
+            glm::vec3 outwards = (a + b + c) / 3.0f - glm::vec3(0.5f, 1.0f, 1.5f);
+            ASSERT_GT(glm::dot(glm::cross(b - a, c - a), outwards), 0.0f);
+        }
+
+        // wall of 4 x 2 x 0.2 with an opening of 1 x 1 in the middle, made from 4 closed boxes
+        OccluderBox opening{glm::vec3(1.5f, 0.5f, 0.0f), glm::vec3(2.5f, 1.5f, 0.2f)};
+        positions.clear();
+        indices.clear();
+        appendOccluderBox(OccluderBox{glm::vec3(0, 0, 0), glm::vec3(1.5f, 2, 0.2f)}, &positions, &indices);
+        appendOccluderBox(OccluderBox{glm::vec3(2.5f, 0, 0), glm::vec3(4, 2, 0.2f)}, &positions, &indices);
+        appendOccluderBox(OccluderBox{glm::vec3(1.5f, 0, 0), glm::vec3(2.5f, 0.5f, 0.2f)}, &positions, &indices);
+        appendOccluderBox(OccluderBox{glm::vec3(1.5f, 1.5f, 0), glm::vec3(2.5f, 2, 0.2f)}, &positions, &indices);
+
+        ScratchArena scratch{};
+        createScratchArena(1024, &scratch);
+        std::vector<OccluderBox> boxes;
+        generateBoxOccluders(positions, indices, OccluderSettings{}, &scratch, &boxes);
+        ASSERT_FALSE(boxes.empty());
+        float area = 0.0f;
+        for (OccluderBox const& box: boxes)
+        {
+            // conservative: inside the wall, and not in front of the opening
+            ASSERT_TRUE(glm::all(glm::greaterThanEqual(box.min, glm::vec3(0))));
+            ASSERT_TRUE(glm::all(glm::lessThanEqual(box.max, glm::vec3(4, 2, 0.2f))));
+            ASSERT_FALSE(overlaps(box, opening));
+            area += (box.max.x - box.min.x) * (box.max.y - box.min.y);
+        }
+        ASSERT_GT(area, 0.75f * (8.0f - 1.0f)); // most of the wall is covered
+
+        // a mesh without volume has no occluders
+        boxes.clear();
+        resetScratchArena(&scratch);
+        std::vector<glm::vec3> quad{glm::vec3(0, 0, 0), glm::vec3(1, 0, 0), glm::vec3(1, 1, 0), glm::vec3(0, 1, 0)};
+        std::vector<uint32_t> quadIndices{0, 1, 2, 0, 2, 3};
+        generateBoxOccluders(quad, quadIndices, OccluderSettings{}, &scratch, &boxes);
+        ASSERT_TRUE(boxes.empty());
+        destroyScratchArena(&scratch);
+    }
+
+    TEST(Tests, OcclusionCulling)
+    {
+        // camera at the origin looking along -z, with a wall of 4 x 4 at a distance of 5
+        glm::mat4 viewProjection = glm::perspective(glm::radians(90.0f), 1.0f, 0.1f, 100.0f);
+        std::vector<glm::vec3> positions;
+        std::vector<uint32_t> indices;
+        appendOccluderBox(OccluderBox{glm::vec3(-2, -2, -5.2f), glm::vec3(2, 2, -5)}, &positions, &indices);
+
+        OcclusionBuffer buffer{};
+        clearOcclusionBuffer(64, 64, viewProjection, 0.1f, &buffer);
+        ASSERT_FALSE(isBoxOccluded(&buffer, glm::vec3(-0.5f), glm::vec3(0.5f), glm::translate(glm::mat4(1), glm::vec3(0, 0, -10))));
+        rasterizeOccluder(&buffer, positions, indices, glm::mat4(1));
+        finalizeOcclusionBuffer(&buffer);
+        ASSERT_EQ(buffer.triangleCount, 12);
+
+        // behind, in front of, and next to the wall
+        ASSERT_TRUE(isBoxOccluded(&buffer, glm::vec3(-0.5f), glm::vec3(0.5f), glm::translate(glm::mat4(1), glm::vec3(0, 0, -10))));
+        ASSERT_FALSE(isBoxOccluded(&buffer, glm::vec3(-0.5f), glm::vec3(0.5f), glm::translate(glm::mat4(1), glm::vec3(0, 0, -3))));
+        ASSERT_FALSE(isBoxOccluded(&buffer, glm::vec3(-0.5f), glm::vec3(0.5f), glm::translate(glm::mat4(1), glm::vec3(6, 0, -10))));
+
+        // partially visible past the edge of the wall
+        ASSERT_FALSE(isBoxOccluded(&buffer, glm::vec3(-0.5f), glm::vec3(0.5f), glm::translate(glm::mat4(1), glm::vec3(4, 0, -10))));
+
+        // intersecting the near plane, so never occluded
+        ASSERT_FALSE(isBoxOccluded(&buffer, glm::vec3(-20, -20, -20), glm::vec3(20, 20, 0), glm::mat4(1)));
+    }
+}